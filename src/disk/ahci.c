@@ -0,0 +1,385 @@
+#include "header/ahci.h"
+#include "header/pci.h"
+#include "header/memory/paging.h"
+#include "header/stdlib/string.h"
+
+/**
+ * AHCI driver state, single port with ATA disk
+ *
+ * @param hba          HBA registers (identity mapped ABAR)
+ * @param port         Registers of used port, NULL if no AHCI disk
+ * @param port_index   Index of used port
+ * @param ncq          Commands are issued with READ/WRITE FPDMA QUEUED, tag is slot number
+ * @param lba48        Device support 48-bit LBA
+ * @param write_cache  Device has volatile write cache, flush request issue FLUSH CACHE (EXT)
+ * @param flushing     FLUSH CACHE is outstanding, nothing else is issued until it is done
+ * @param slot_mask    Usable slots, limited by HBA slot count and device queue depth
+ * @param issued       Slots with outstanding command
+ * @param slot_request Request served by slot
+ * @param slot_blocks  Block count of outstanding command in slot
+ * @param bounce_slot  Slot using bounce buffer, -1 if bounce buffer is free
+ * @param head         First request waiting for free slot
+ * @param tail         Last request waiting for free slot
+ */
+static struct {
+    volatile struct AHCIHBARegisters  *hba;
+    volatile struct AHCIPortRegisters *port;
+    uint32_t            port_index;
+    bool                ncq;
+    bool                lba48;
+    bool                write_cache;
+    bool                flushing;
+    uint32_t            slot_mask;
+    uint32_t            issued;
+    struct DiskRequest *slot_request[AHCI_MAX_SLOTS];
+    uint32_t            slot_blocks[AHCI_MAX_SLOTS];
+    int32_t             bounce_slot;
+    struct DiskRequest *head;
+    struct DiskRequest *tail;
+} ahci;
+
+static struct AHCICommandHeader ahci_command_list[AHCI_MAX_SLOTS] __attribute__((aligned(1024)));
+static struct AHCIReceivedFIS   ahci_received_fis __attribute__((aligned(256)));
+static struct AHCICommandTable  ahci_command_table[AHCI_MAX_SLOTS] __attribute__((aligned(128)));
+static uint8_t ahci_bounce[AHCI_BOUNCE_SIZE] __attribute__((aligned(0x1000)));
+
+static uint32_t ahci_physical_address(const void *ptr) {
+    uint32_t physical_address = 0;
+    paging_virtual_to_physical(&_paging_kernel_page_directory, ptr, &physical_address);
+    return physical_address;
+}
+
+/* -- Port control -- */
+
+static void ahci_port_stop(void) {
+    ahci.port->command &= ~AHCI_PORT_CMD_ST;
+    ahci.port->command &= ~AHCI_PORT_CMD_FRE;
+    while (ahci.port->command & (AHCI_PORT_CMD_FR | AHCI_PORT_CMD_CR));
+}
+
+static void ahci_port_start(void) {
+    while (ahci.port->command & AHCI_PORT_CMD_CR);
+    ahci.port->sata_error       = 0xFFFFFFFF;
+    ahci.port->interrupt_status = 0xFFFFFFFF;
+    ahci.port->command |= AHCI_PORT_CMD_FRE;
+    ahci.port->command |= AHCI_PORT_CMD_ST;
+}
+
+/* -- Command building -- */
+
+// Fill PRDT for virtually contiguous buffer, entry is split at 4 MiB page frame boundary
+static bool ahci_build_prdt(struct AHCICommandTable *table, const void *ptr, uint32_t size, uint16_t *entry_count) {
+    uint32_t virtual_address = (uint32_t) ptr;
+    uint16_t entry = 0;
+    while (size > 0) {
+        uint32_t physical_address;
+        if (entry == AHCI_PRDT_ENTRY || (virtual_address & 1)
+                || !paging_virtual_to_physical(&_paging_kernel_page_directory, (void*) virtual_address, &physical_address))
+            return false;
+
+        uint32_t chunk = AHCI_PRD_MAX_BYTES - (virtual_address & (AHCI_PRD_MAX_BYTES - 1));
+        if (chunk > size)
+            chunk = size;
+        table->prdt[entry].data_base       = physical_address;
+        table->prdt[entry].data_base_upper = 0;
+        table->prdt[entry].reserved        = 0;
+        table->prdt[entry].byte_count      = chunk - 1;
+        virtual_address += chunk;
+        size            -= chunk;
+        entry++;
+    }
+    *entry_count = entry;
+    return true;
+}
+
+static void ahci_build_fis(struct AHCICommandTable *table, uint8_t command, uint32_t logical_block_address, uint32_t block_count, uint32_t slot) {
+    struct AHCIFISRegisterH2D *fis = (struct AHCIFISRegisterH2D*) table->command_fis;
+    memset(table->command_fis, 0, sizeof(table->command_fis));
+    fis->fis_type = AHCI_FIS_TYPE_REG_H2D;
+    fis->flags    = AHCI_FIS_H2D_COMMAND;
+    fis->command  = command;
+    fis->device   = AHCI_FIS_DEVICE_LBA;
+    fis->lba0     = (uint8_t) logical_block_address;
+    fis->lba1     = (uint8_t) (logical_block_address >> 8);
+    fis->lba2     = (uint8_t) (logical_block_address >> 16);
+    if (command == ATA_CMD_READ_DMA || command == ATA_CMD_WRITE_DMA)
+        fis->device |= (logical_block_address >> 24) & 0x0F;
+    else
+        fis->lba3 = (uint8_t) (logical_block_address >> 24);
+
+    if (command == ATA_CMD_READ_FPDMA_QUEUED || command == ATA_CMD_WRITE_FPDMA_QUEUED) {
+        // NCQ: block count in feature, tag in count bit 3-7
+        fis->feature_low  = (uint8_t) block_count;
+        fis->feature_high = (uint8_t) (block_count >> 8);
+        fis->count_low    = (uint8_t) (slot << 3);
+    } else {
+        fis->count_low  = (uint8_t) block_count;
+        fis->count_high = (uint8_t) (block_count >> 8);
+    }
+}
+
+static uint8_t ahci_command_opcode(struct DiskRequest *request) {
+    if (request->is_flush)
+        return ahci.lba48 ? ATA_CMD_FLUSH_CACHE_EXT : ATA_CMD_FLUSH_CACHE;
+    if (ahci.ncq)
+        return request->is_write ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED;
+    if (ahci.lba48)
+        return request->is_write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+    return request->is_write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA;
+}
+
+// Issue next chunk of request in slot, false if request need bounce buffer that is currently used
+static bool ahci_start(uint32_t slot, struct DiskRequest *request) {
+    struct AHCICommandTable *table = &ahci_command_table[slot];
+    uint32_t logical_block_address = request->logical_block_address + request->transferred;
+    uint32_t block_count           = request->block_count - request->transferred;
+    uint8_t *ptr                   = (uint8_t*) request->buf + request->transferred * BLOCK_SIZE;
+
+    uint32_t max_blocks = ahci.lba48 ? AHCI_COMMAND_MAX_BLOCKS : ATA_LBA28_MAX_BLOCKS;
+    if (block_count > max_blocks)
+        block_count = max_blocks;
+
+    uint16_t prdt_length;
+    if (!ahci_build_prdt(table, ptr, block_count * BLOCK_SIZE, &prdt_length)) {
+        if (ahci.bounce_slot != -1)
+            return false;
+        if (block_count > AHCI_BOUNCE_SIZE / BLOCK_SIZE)
+            block_count = AHCI_BOUNCE_SIZE / BLOCK_SIZE;
+        if (request->is_write)
+            memcpy(ahci_bounce, ptr, block_count * BLOCK_SIZE);
+        ahci_build_prdt(table, ahci_bounce, block_count * BLOCK_SIZE, &prdt_length);
+        ahci.bounce_slot = slot;
+    }
+    ahci_build_fis(table, ahci_command_opcode(request), logical_block_address, block_count, slot);
+
+    struct AHCICommandHeader *header = &ahci_command_list[slot];
+    header->flags          = sizeof(struct AHCIFISRegisterH2D) / sizeof(uint32_t);
+    if (request->is_write)
+        header->flags     |= AHCI_CMD_HEADER_WRITE;
+    header->prdt_length    = prdt_length;
+    header->prd_byte_count = 0;
+
+    ahci.slot_request[slot] = request;
+    ahci.slot_blocks[slot]  = block_count;
+    ahci.issued            |= 1u << slot;
+    ahci.flushing           = request->is_flush;
+
+    // Command table & header must be in memory before HBA fetch it
+    __asm__ volatile("" : : : "memory");
+    if (ahci.ncq && !request->is_flush)
+        ahci.port->sata_active = 1u << slot;
+    ahci.port->command_issue = 1u << slot;
+    return true;
+}
+
+/* -- Queue -- */
+
+static void ahci_issue_waiting(void) {
+    while (ahci.head != NULL) {
+        uint32_t free_slots = ahci.slot_mask & ~ahci.issued;
+        if (free_slots == 0)
+            return;
+
+        // FLUSH CACHE is not queued command: it wait for every outstanding command, and the next wait for it
+        struct DiskRequest *request = ahci.head;
+        if (ahci.issued != 0 && (request->is_flush || ahci.flushing))
+            return;
+        if (!ahci_start(__builtin_ctz(free_slots), request))
+            return;
+        ahci.head = request->next;
+        if (ahci.head == NULL)
+            ahci.tail = NULL;
+        request->next = NULL;
+    }
+}
+
+static void ahci_queue_front(struct DiskRequest *request) {
+    request->next = ahci.head;
+    ahci.head     = request;
+    if (ahci.tail == NULL)
+        ahci.tail = request;
+}
+
+static void ahci_complete_slot(uint32_t slot, int8_t status) {
+    struct DiskRequest *request = ahci.slot_request[slot];
+    uint32_t block_count        = ahci.slot_blocks[slot];
+    ahci.issued                &= ~(1u << slot);
+    ahci.slot_request[slot]     = NULL;
+    if (request->is_flush)
+        ahci.flushing = false;
+
+    if (ahci.bounce_slot == (int32_t) slot) {
+        if (status == 0 && !request->is_write)
+            memcpy((uint8_t*) request->buf + request->transferred * BLOCK_SIZE, ahci_bounce, block_count * BLOCK_SIZE);
+        ahci.bounce_slot = -1;
+    }
+
+    if (status == 0) {
+        request->transferred += block_count;
+        if (request->transferred < request->block_count) {
+            // Rest of split request go before other waiting request, keep submission order
+            ahci_queue_front(request);
+            return;
+        }
+    }
+    disk_request_complete(request, status);
+}
+
+// Device reported error: restart port and fail every outstanding command
+static void ahci_recover(void) {
+    uint32_t failed = ahci.issued;
+    ahci_port_stop();
+    ahci_port_start();
+    while (failed != 0) {
+        uint32_t slot = __builtin_ctz(failed);
+        failed &= failed - 1;
+        ahci_complete_slot(slot, -1);
+    }
+}
+
+void ahci_isr(void) {
+    if (ahci.port == NULL)
+        return;
+
+    uint32_t port_status = ahci.port->interrupt_status;
+    ahci.port->interrupt_status = port_status;
+    ahci.hba->interrupt_status  = 1u << ahci.port_index;
+
+    if (port_status & AHCI_PORT_IS_ERROR) {
+        ahci_recover();
+    } else {
+        // NCQ command is finished once its tag leave sata_active, non NCQ once it leave command_issue
+        uint32_t finished = ahci.issued & ~(ahci.port->sata_active | ahci.port->command_issue);
+        while (finished != 0) {
+            uint32_t slot = __builtin_ctz(finished);
+            finished &= finished - 1;
+            ahci_complete_slot(slot, 0);
+        }
+    }
+    ahci_issue_waiting();
+}
+
+void ahci_submit(struct DiskRequest *request) {
+    if (request->is_flush && !ahci.write_cache) {
+        disk_request_complete(request, 0);
+        return;
+    }
+    request->next = NULL;
+    if (ahci.tail != NULL)
+        ahci.tail->next = request;
+    else
+        ahci.head = request;
+    ahci.tail = request;
+    ahci_issue_waiting();
+}
+
+/* -- Initialization -- */
+
+// IDENTIFY DEVICE through slot 0 with polling, port interrupt is not enabled yet
+static bool ahci_identify(uint16_t *identify) {
+    struct AHCICommandTable *table = &ahci_command_table[0];
+    uint16_t prdt_length;
+    ahci_build_prdt(table, ahci_bounce, BLOCK_SIZE, &prdt_length);
+    ahci_build_fis(table, ATA_CMD_IDENTIFY, 0, 0, 0);
+    ((struct AHCIFISRegisterH2D*) table->command_fis)->device = 0;
+
+    ahci_command_list[0].flags          = sizeof(struct AHCIFISRegisterH2D) / sizeof(uint32_t);
+    ahci_command_list[0].prdt_length    = prdt_length;
+    ahci_command_list[0].prd_byte_count = 0;
+    __asm__ volatile("" : : : "memory");
+    ahci.port->command_issue = 1;
+
+    while (ahci.port->command_issue & 1) {
+        if (ahci.port->interrupt_status & AHCI_PORT_IS_ERROR)
+            return false;
+    }
+    if (ahci.port->task_file_data & (ATA_STATUS_ERR | ATA_STATUS_DF))
+        return false;
+    ahci.port->interrupt_status = 0xFFFFFFFF;
+    memcpy(identify, ahci_bounce, BLOCK_SIZE);
+    return true;
+}
+
+static bool ahci_find_port(void) {
+    for (uint32_t i = 0; i < AHCI_MAX_PORTS; i++) {
+        if (!(ahci.hba->port_implemented & (1u << i)))
+            continue;
+        volatile struct AHCIPortRegisters *port = &ahci.hba->ports[i];
+        if ((port->sata_status & AHCI_PORT_SSTS_DET_MASK) == AHCI_PORT_SSTS_DET_PRESENT
+                && port->signature == AHCI_PORT_SIG_ATA) {
+            ahci.port_index = i;
+            ahci.port       = port;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ahci_init(uint8_t *irq, uint32_t *capacity) {
+    struct PCIDevice controller;
+    if (!pci_find_class(PCI_CLASS_MASS_STORAGE, PCI_SUBCLASS_SATA, &controller))
+        return false;
+    if (controller.prog_if != PCI_PROG_IF_AHCI)
+        return false;
+    uint32_t abar = pci_read_bar(&controller, AHCI_ABAR_INDEX);
+    if (abar & PCI_BAR_IO)
+        return false;
+
+    ahci.hba = paging_map_mmio(abar & PCI_BAR_MEMORY_MASK);
+    if (ahci.hba == NULL)
+        return false;
+    pci_enable_bus_master(&controller);
+    ahci.hba->global_control |= AHCI_GHC_AE;
+    if (!ahci_find_port()) {
+        ahci.port = NULL;
+        return false;
+    }
+
+    ahci_port_stop();
+    memset(ahci_command_list, 0, sizeof(ahci_command_list));
+    memset(&ahci_received_fis, 0, sizeof(ahci_received_fis));
+    memset(ahci_command_table, 0, sizeof(ahci_command_table));
+    ahci.port->command_list_base       = ahci_physical_address(ahci_command_list);
+    ahci.port->command_list_base_upper = 0;
+    ahci.port->fis_base                = ahci_physical_address(&ahci_received_fis);
+    ahci.port->fis_base_upper          = 0;
+    for (uint32_t i = 0; i < AHCI_MAX_SLOTS; i++) {
+        ahci_command_list[i].command_table_base       = ahci_physical_address(&ahci_command_table[i]);
+        ahci_command_list[i].command_table_base_upper = 0;
+    }
+    ahci.port->interrupt_enable = 0;
+    ahci_port_start();
+
+    uint16_t identify[HALF_BLOCK_SIZE];
+    if (!ahci_identify(identify)) {
+        ahci_port_stop();
+        ahci.port = NULL;
+        return false;
+    }
+
+    uint32_t slot_count = ((ahci.hba->capability >> AHCI_CAP_NCS_SHIFT) & AHCI_CAP_NCS_MASK) + 1;
+    ahci.lba48       = (identify[ATA_IDENTIFY_COMMAND_SET] & ATA_IDENTIFY_CMD_LBA48) != 0;
+    ahci.write_cache = (identify[ATA_IDENTIFY_FEATURE_SET] & ATA_IDENTIFY_CMD_WCACHE) != 0;
+    ahci.ncq         = ahci.lba48
+                    && (ahci.hba->capability & AHCI_CAP_SNCQ)
+                    && (identify[ATA_IDENTIFY_SATA_CAP] & ATA_IDENTIFY_SATA_CAP_NCQ);
+    if (ahci.ncq) {
+        uint32_t queue_depth = (identify[ATA_IDENTIFY_QUEUE_DEPTH] & 0x1F) + 1;
+        if (queue_depth < slot_count)
+            slot_count = queue_depth;
+    }
+    ahci.slot_mask   = slot_count == AHCI_MAX_SLOTS ? 0xFFFFFFFF : (1u << slot_count) - 1;
+    ahci.issued      = 0;
+    ahci.flushing    = false;
+    ahci.bounce_slot = -1;
+    ahci.head        = NULL;
+    ahci.tail        = NULL;
+
+    ahci.port->interrupt_enable = AHCI_PORT_IS_DHRS | AHCI_PORT_IS_PSS | AHCI_PORT_IS_DSS
+                                | AHCI_PORT_IS_SDBS | AHCI_PORT_IS_ERROR;
+    ahci.hba->interrupt_status  = 0xFFFFFFFF;
+    ahci.hba->global_control   |= AHCI_GHC_IE;
+    *irq      = controller.interrupt_line;
+    *capacity = ata_identify_capacity(identify);
+    return true;
+}
@@ -0,0 +1,295 @@
+#include "header/bcache.h"
+#include "header/stdlib/string.h"
+
+static uint32_t bcache_clamp_size(uint32_t block_size, uint32_t size) {
+    if (size < BCACHE_MIN_BUFFERS)
+        size = BCACHE_MIN_BUFFERS;
+    if (size > BCACHE_MAX_BUFFERS)
+        size = BCACHE_MAX_BUFFERS;
+    if (size > BCACHE_POOL_SIZE / block_size)
+        size = BCACHE_POOL_SIZE / block_size;
+    return size;
+}
+
+void bcache_init(struct BufferCache *cache, struct BlockDevice *device, uint32_t block_size, uint32_t size) {
+    cache->device            = device;
+    cache->block_size        = block_size;
+    cache->sectors_per_block = block_size / BLOCK_SIZE;
+    cache->size              = bcache_clamp_size(block_size, size);
+    cache->pinned            = 0;
+    cache->hits        = 0;
+    cache->misses      = 0;
+    cache->writebacks  = 0;
+    cache->read_errors = 0;
+    for (uint32_t i = 0; i < BCACHE_HASH_BUCKETS; i++)
+        cache->hash[i] = NULL;
+
+    // Every buffer start in LRU list, front to back in pool order
+    for (uint32_t i = 0; i < cache->size; i++) {
+        struct BufferHead *buffer = &cache->buffers[i];
+        buffer->block     = 0;
+        buffer->refcount  = 0;
+        buffer->valid     = false;
+        buffer->dirty     = false;
+        buffer->journaled = false;
+        buffer->status    = 0;
+        buffer->hash_next = NULL;
+        buffer->data      = &cache->pool[i * block_size];
+        buffer->lru_prev  = i > 0 ? &cache->buffers[i - 1] : NULL;
+        buffer->lru_next  = i + 1 < cache->size ? &cache->buffers[i + 1] : NULL;
+    }
+    cache->lru_head = &cache->buffers[0];
+    cache->lru_tail = &cache->buffers[cache->size - 1];
+}
+
+bool bcache_set_size(struct BufferCache *cache, uint32_t size) {
+    for (uint32_t i = 0; i < cache->size; i++) {
+        if (cache->buffers[i].refcount > 0)
+            return false;
+    }
+    bcache_sync(cache);
+
+    uint32_t hits       = cache->hits;
+    uint32_t misses     = cache->misses;
+    uint32_t writebacks  = cache->writebacks;
+    uint32_t read_errors = cache->read_errors;
+    bcache_init(cache, cache->device, cache->block_size, size);
+    cache->hits        = hits;
+    cache->misses      = misses;
+    cache->writebacks  = writebacks;
+    cache->read_errors = read_errors;
+    return true;
+}
+
+/* -- Hash & LRU -- */
+
+static struct BufferHead **bcache_bucket(struct BufferCache *cache, uint32_t block) {
+    return &cache->hash[block & (BCACHE_HASH_BUCKETS - 1)];
+}
+
+static struct BufferHead *bcache_lookup(struct BufferCache *cache, uint32_t block) {
+    for (struct BufferHead *buffer = *bcache_bucket(cache, block); buffer != NULL; buffer = buffer->hash_next) {
+        if (buffer->block == block)
+            return buffer;
+    }
+    return NULL;
+}
+
+static void bcache_unhash(struct BufferCache *cache, struct BufferHead *buffer) {
+    struct BufferHead **link = bcache_bucket(cache, buffer->block);
+    while (*link != buffer)
+        link = &(*link)->hash_next;
+    *link             = buffer->hash_next;
+    buffer->hash_next = NULL;
+    buffer->valid     = false;
+}
+
+static void bcache_lru_unlink(struct BufferCache *cache, struct BufferHead *buffer) {
+    if (buffer->lru_prev != NULL)
+        buffer->lru_prev->lru_next = buffer->lru_next;
+    else
+        cache->lru_head = buffer->lru_next;
+    if (buffer->lru_next != NULL)
+        buffer->lru_next->lru_prev = buffer->lru_prev;
+    else
+        cache->lru_tail = buffer->lru_prev;
+}
+
+static void bcache_lru_push_front(struct BufferCache *cache, struct BufferHead *buffer) {
+    bcache_lru_unlink(cache, buffer);
+    buffer->lru_prev = NULL;
+    buffer->lru_next = cache->lru_head;
+    if (cache->lru_head != NULL)
+        cache->lru_head->lru_prev = buffer;
+    cache->lru_head = buffer;
+    if (cache->lru_tail == NULL)
+        cache->lru_tail = buffer;
+}
+
+static void bcache_lru_push_back(struct BufferCache *cache, struct BufferHead *buffer) {
+    bcache_lru_unlink(cache, buffer);
+    buffer->lru_next = NULL;
+    buffer->lru_prev = cache->lru_tail;
+    if (cache->lru_tail != NULL)
+        cache->lru_tail->lru_next = buffer;
+    cache->lru_tail = buffer;
+    if (cache->lru_head == NULL)
+        cache->lru_head = buffer;
+}
+
+/* -- Buffer allocation -- */
+
+// Data is copied by I/O scheduler, buffer can be reused right after
+static void bcache_writeback(struct BufferCache *cache, struct BufferHead *buffer) {
+    blockdev_write(cache->device, buffer->data, buffer->block * cache->sectors_per_block, cache->sectors_per_block);
+    buffer->dirty     = false;
+    buffer->journaled = false;
+    cache->writebacks++;
+}
+
+// Least recently used unpinned buffer, written back first if dirty
+static struct BufferHead *bcache_evict(struct BufferCache *cache) {
+    struct BufferHead *buffer = cache->lru_tail;
+    while (buffer != NULL && buffer->refcount > 0)
+        buffer = buffer->lru_prev;
+    if (buffer == NULL)
+        return NULL; // More than size buffers pinned, caller bug
+
+    if (buffer->valid) {
+        if (buffer->dirty)
+            bcache_writeback(cache, buffer);
+        bcache_unhash(cache, buffer);
+    }
+    return buffer;
+}
+
+// Pin buffer of block, hit is false if buffer is newly assigned and data must be filled by caller
+static struct BufferHead *bcache_pin(struct BufferCache *cache, uint32_t block, bool *hit) {
+    struct BufferHead *buffer = bcache_lookup(cache, block);
+    *hit = buffer != NULL;
+    if (buffer != NULL) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+        buffer = bcache_evict(cache);
+        if (buffer == NULL)
+            return NULL;
+        struct BufferHead **bucket = bcache_bucket(cache, block);
+        buffer->block     = block;
+        buffer->valid     = true;
+        buffer->dirty     = false;
+        buffer->journaled = false;
+        buffer->status    = 0;
+        buffer->hash_next = *bucket;
+        *bucket           = buffer;
+    }
+    if (buffer->refcount++ == 0)
+        cache->pinned++;
+    bcache_lru_push_front(cache, buffer);
+    return buffer;
+}
+
+// Garbage from failed read must not be served nor written back: buffer leave hash chain with zeroed data
+static void bcache_drop_failed(struct BufferCache *cache, struct BufferHead *buffer) {
+    cache->read_errors++;
+    memset(buffer->data, 0, cache->block_size);
+    buffer->dirty     = false;
+    buffer->journaled = false;
+    bcache_unhash(cache, buffer);
+    if (buffer->refcount == 0)
+        bcache_lru_push_back(cache, buffer);
+}
+
+struct BufferHead *bcache_get(struct BufferCache *cache, uint32_t block) {
+    bool hit;
+    struct BufferHead *buffer = bcache_pin(cache, block, &hit);
+    if (buffer == NULL || (hit && buffer->status == 0))
+        return buffer;
+
+    // Miss, or queued read of bcache_get_async() failed
+    buffer->status = blockdev_read(cache->device, buffer->data, block * cache->sectors_per_block, cache->sectors_per_block);
+    if (buffer->status != 0)
+        bcache_drop_failed(cache, buffer);
+    return buffer;
+}
+
+struct BufferHead *bcache_get_async(struct BufferCache *cache, uint32_t block) {
+    bool hit;
+    struct BufferHead *buffer = bcache_pin(cache, block, &hit);
+    if (buffer != NULL && (!hit || buffer->status != 0))
+        blockdev_read_async(cache->device, buffer->data, block * cache->sectors_per_block, cache->sectors_per_block,
+                            &buffer->status);
+    return buffer;
+}
+
+struct BufferHead *bcache_get_new(struct BufferCache *cache, uint32_t block) {
+    bool hit;
+    struct BufferHead *buffer = bcache_pin(cache, block, &hit);
+    if (buffer != NULL && !hit)
+        memset(buffer->data, 0, cache->block_size);
+    return buffer;
+}
+
+uint32_t bcache_unpinned(struct BufferCache *cache) {
+    return cache->size - cache->pinned;
+}
+
+bool bcache_cached(struct BufferCache *cache, uint32_t block) {
+    struct BufferHead *buffer = bcache_lookup(cache, block);
+    return buffer != NULL && buffer->status == 0;
+}
+
+void bcache_mark_dirty(struct BufferCache *cache, struct BufferHead *buffer) {
+    (void) cache;
+    buffer->dirty     = true;
+    buffer->journaled = false;
+}
+
+void bcache_mark_clean(struct BufferCache *cache, struct BufferHead *buffer) {
+    (void) cache;
+    buffer->dirty     = false;
+    buffer->journaled = false;
+}
+
+void bcache_mark_journaled(struct BufferCache *cache, struct BufferHead *buffer) {
+    (void) cache;
+    buffer->dirty     = true;
+    buffer->journaled = true;
+}
+
+void bcache_release(struct BufferCache *cache, struct BufferHead *buffer) {
+    if (--buffer->refcount > 0)
+        return;
+    cache->pinned--;
+    if (buffer->valid && buffer->status != 0)
+        bcache_drop_failed(cache, buffer); // Queued read failed and nobody retried it
+}
+
+/* -- Copy interface -- */
+
+int8_t bcache_read(struct BufferCache *cache, void *ptr, uint32_t block) {
+    struct BufferHead *buffer = bcache_get(cache, block);
+    int8_t status = buffer->status;
+    memcpy(ptr, buffer->data, cache->block_size);
+    bcache_release(cache, buffer);
+    return status;
+}
+
+void bcache_write(struct BufferCache *cache, const void *ptr, uint32_t block) {
+    struct BufferHead *buffer = bcache_get_new(cache, block);
+    memcpy(buffer->data, ptr, cache->block_size);
+    bcache_mark_dirty(cache, buffer);
+    bcache_release(cache, buffer);
+}
+
+void bcache_invalidate(struct BufferCache *cache, uint32_t block) {
+    struct BufferHead *buffer = bcache_lookup(cache, block);
+    if (buffer == NULL)
+        return;
+    buffer->dirty     = false;
+    buffer->journaled = false;
+    if (buffer->refcount > 0)
+        return;
+    bcache_unhash(cache, buffer);
+    bcache_lru_push_back(cache, buffer);
+}
+
+void bcache_sync(struct BufferCache *cache) {
+    blockdev_plug(cache->device);
+    for (uint32_t i = 0; i < cache->size; i++) {
+        struct BufferHead *buffer = &cache->buffers[i];
+        if (buffer->valid && buffer->dirty)
+            bcache_writeback(cache, buffer);
+    }
+    blockdev_unplug(cache->device);
+}
+
+void bcache_sync_data(struct BufferCache *cache) {
+    blockdev_plug(cache->device);
+    for (uint32_t i = 0; i < cache->size; i++) {
+        struct BufferHead *buffer = &cache->buffers[i];
+        if (buffer->valid && buffer->dirty && !buffer->journaled)
+            bcache_writeback(cache, buffer);
+    }
+    blockdev_unplug(cache->device);
+}
@@ -0,0 +1,150 @@
+#include "header/blockdev.h"
+#include "header/iosched.h"
+#include "header/stdlib/string.h"
+
+static struct BlockDevice *blockdev_registry[BLOCKDEV_MAX_DEVICES];
+static uint32_t            blockdev_registry_count;
+
+void blockdev_register(struct BlockDevice *device) {
+    memset(&device->stats, 0, sizeof(device->stats));
+    for (uint32_t i = 0; i < blockdev_registry_count; i++) {
+        if (blockdev_registry[i] == device)
+            return;
+    }
+    if (blockdev_registry_count < BLOCKDEV_MAX_DEVICES)
+        blockdev_registry[blockdev_registry_count++] = device;
+}
+
+bool blockdev_info(uint32_t index, struct BlockDeviceInfo *info) {
+    if (index >= blockdev_registry_count)
+        return false;
+    struct BlockDevice *device = blockdev_registry[index];
+    memset(info->name, 0, BLOCKDEV_NAME_LENGTH);
+    for (uint32_t i = 0; i + 1 < BLOCKDEV_NAME_LENGTH && device->name[i] != '\0'; i++)
+        info->name[i] = device->name[i];
+    info->sector_size = device->sector_size;
+    info->capacity    = device->capacity;
+    info->stats       = device->stats;
+    return true;
+}
+
+/* -- Accounting -- */
+
+// Bucket = floor(log2(cycles)), 0 and 1 cycle share bucket 0
+static uint32_t blockdev_latency_bucket(uint64_t cycles) {
+    if (cycles < 2)
+        return 0;
+    uint32_t bucket = 63 - __builtin_clzll(cycles);
+    return bucket < BLOCKDEV_LATENCY_BUCKETS ? bucket : BLOCKDEV_LATENCY_BUCKETS - 1;
+}
+
+// Request may be waited more than once (ex: merged command), only first wait is counted
+static void blockdev_account_completion(struct BlockDevice *device, struct DiskRequest *request) {
+    if (request->submitted_at == 0)
+        return;
+
+    struct BlockDeviceStats *stats = &device->stats;
+    uint64_t cycles = request->completed_at - request->submitted_at;
+    if (request->completed_at < request->submitted_at)
+        cycles = 0;
+    request->submitted_at = 0;
+    stats->in_flight--;
+    if (request->status != 0)
+        stats->errors++;
+    if (request->is_write) {
+        stats->write_ops++;
+        stats->write_sectors += request->block_count;
+        stats->write_latency[blockdev_latency_bucket(cycles)]++;
+    } else {
+        stats->read_ops++;
+        stats->read_sectors += request->block_count;
+        stats->read_latency[blockdev_latency_bucket(cycles)]++;
+    }
+}
+
+void blockdev_account_merge(struct BlockDevice *device, bool is_write, uint32_t count) {
+    if (is_write)
+        device->stats.write_merges += count;
+    else
+        device->stats.read_merges += count;
+}
+
+/* -- Driver level -- */
+
+void blockdev_submit(struct BlockDevice *device, struct DiskRequest *request) {
+    struct BlockDeviceStats *stats = &device->stats;
+    request->submitted_at = disk_timestamp();
+    request->completed_at = request->submitted_at;
+    if (request->submitted_at == 0)
+        request->submitted_at = 1;
+    if (++stats->in_flight > stats->max_in_flight)
+        stats->max_in_flight = stats->in_flight;
+    device->ops->submit(device, request);
+}
+
+void blockdev_kick(struct BlockDevice *device) {
+    if (device->ops->kick != NULL)
+        device->ops->kick(device);
+}
+
+void blockdev_wait(struct BlockDevice *device, struct DiskRequest *request) {
+    device->ops->wait(device, request);
+    blockdev_account_completion(device, request);
+}
+
+/* -- Filesystem level -- */
+
+static int8_t blockdev_transfer(struct BlockDevice *device, void *ptr, uint32_t logical_block_address, uint32_t block_count, bool is_write) {
+    struct DiskRequest request = {
+        .buf                   = ptr,
+        .logical_block_address = logical_block_address,
+        .block_count           = block_count,
+        .is_write              = is_write,
+    };
+    blockdev_submit(device, &request);
+    blockdev_kick(device);
+    blockdev_wait(device, &request);
+    return request.status;
+}
+
+int8_t blockdev_read(struct BlockDevice *device, void *ptr, uint32_t logical_block_address, uint32_t block_count) {
+    if (device->queue != NULL)
+        return iosched_read(device->queue, ptr, logical_block_address, block_count);
+    return blockdev_transfer(device, ptr, logical_block_address, block_count, false);
+}
+
+int8_t blockdev_read_async(struct BlockDevice *device, void *ptr, uint32_t logical_block_address, uint32_t block_count, int8_t *status) {
+    if (device->queue != NULL)
+        return iosched_read_async(device->queue, ptr, logical_block_address, block_count, status);
+    int8_t result = blockdev_transfer(device, ptr, logical_block_address, block_count, false);
+    if (status != NULL)
+        *status = result;
+    return result;
+}
+
+int8_t blockdev_write(struct BlockDevice *device, const void *ptr, uint32_t logical_block_address, uint32_t block_count) {
+    if (device->queue != NULL)
+        return iosched_write(device->queue, ptr, logical_block_address, block_count);
+    return blockdev_transfer(device, (void*) ptr, logical_block_address, block_count, true);
+}
+
+void blockdev_plug(struct BlockDevice *device) {
+    if (device->queue != NULL)
+        iosched_plug(device->queue);
+}
+
+int8_t blockdev_unplug(struct BlockDevice *device) {
+    if (device->queue != NULL)
+        return iosched_unplug(device->queue);
+    return 0;
+}
+
+int8_t blockdev_flush(struct BlockDevice *device) {
+    int8_t status = 0;
+    if (device->queue != NULL)
+        status = iosched_flush(device->queue);
+    // Queue is drained, device cache hold every completed write
+    if (device->ops->flush != NULL && device->ops->flush(device) != 0)
+        status = -1;
+    return status;
+}
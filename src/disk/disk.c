@@ -1,46 +1,660 @@
 #include "header/disk.h"
+#include "header/blockdev.h"
+#include "header/iosched.h"
 #include "header/portio.h"
+#include "header/pci.h"
+#include "header/ahci.h"
+#include "header/virtio.h"
+#include "header/interrupt.h"
+#include "header/stdlib/string.h"
+#include "header/memory/paging.h"
+
+#define EFLAGS_INTERRUPT_ENABLE 0x200
+
+/**
+ * Primary master capabilities, read from IDENTIFY
+ *
+ * @param lba48       Device support 48-bit LBA commands
+ * @param multiple    Blocks per DRQ data block for READ/WRITE MULTIPLE, 0 if multiple mode is disabled
+ * @param write_cache Device has volatile write cache, flush request issue FLUSH CACHE
+ */
+static struct {
+    bool     lba48;
+    uint32_t multiple;
+    bool     write_cache;
+} ata_device;
+
+/**
+ * Primary channel bus master DMA state
+ *
+ * @param available  True if controller found & disk reported DMA capability
+ * @param bmide_base Bus master IDE I/O port base (BAR4)
+ */
+static struct {
+    bool     available;
+    uint16_t bmide_base;
+} ata_dma;
+
+/**
+ * Primary channel request queue, requests are served FIFO one at a time and completed from ata_isr().
+ * Large request is split into several ATA commands, one command in flight at a time.
+ *
+ * @param ready               True after disk_init(), IRQ_PRIMARY_ATA is expected to be delivered
+ * @param head                First pending request, not yet issued to device
+ * @param tail                Last pending request
+ * @param current             Request currently issued to device
+ * @param use_dma             Current request is transferred with bus master DMA
+ * @param lba48               In-flight command use 48-bit LBA
+ * @param command_blocks      Blocks covered by in-flight command
+ * @param command_transferred Blocks of in-flight command already moved (PIO)
+ * @param bounce              In-flight DMA command use bounce buffer
+ */
+static struct {
+    bool                ready;
+    struct DiskRequest *head;
+    struct DiskRequest *tail;
+    struct DiskRequest *volatile current;
+    bool                use_dma;
+    bool                lba48;
+    uint32_t            command_blocks;
+    uint32_t            command_transferred;
+    bool                bounce;
+} ata_queue;
+
+/**
+ * Controller serving disk_submit, chosen by disk_init()
+ *
+ * @param controller DISK_CONTROLLER_ATA, DISK_CONTROLLER_AHCI or DISK_CONTROLLER_VIRTIO
+ * @param irq        PIC IRQ line of PCI controller, DISK_IRQ_NONE if completion is polled in disk_wait()
+ */
+static struct {
+    uint8_t controller;
+    uint8_t irq;
+} disk_backend = {
+    .controller = DISK_CONTROLLER_ATA,
+    .irq        = DISK_IRQ_NONE,
+};
+
+static struct IOQueue disk_io_queue;
+
+static void disk_block_device_submit(struct BlockDevice *device, struct DiskRequest *request) {
+    (void) device;
+    disk_submit(request);
+}
+
+static void disk_block_device_kick(struct BlockDevice *device) {
+    (void) device;
+    disk_kick();
+}
+
+static void disk_block_device_wait(struct BlockDevice *device, struct DiskRequest *request) {
+    (void) device;
+    disk_wait(request);
+}
+
+static int8_t disk_block_device_flush(struct BlockDevice *device) {
+    (void) device;
+    return disk_flush();
+}
+
+static const struct BlockDeviceOps disk_block_device_ops = {
+    .submit = disk_block_device_submit,
+    .kick   = disk_block_device_kick,
+    .wait   = disk_block_device_wait,
+    .flush  = disk_block_device_flush,
+};
+
+struct BlockDevice disk_block_device = {
+    .name        = "disk",
+    .ops         = &disk_block_device_ops,
+    .sector_size = BLOCK_SIZE,
+    .capacity    = 0,
+    .queue       = &disk_io_queue,
+    .driver_data = NULL,
+};
+
+static struct ATAPRDEntry ata_prd_table[ATA_PRD_MAX_ENTRY] __attribute__((aligned(64)));
+static uint8_t ata_dma_bounce[ATA_DMA_BOUNCE_SIZE] __attribute__((aligned(0x1000)));
 
 static void ATA_busy_wait() {
-    while (in(0x1F7) & ATA_STATUS_BSY);
+    while (in(ATA_PRIMARY_STATUS) & ATA_STATUS_BSY);
 }
 
 static void ATA_DRQ_wait() {
-    while (!(in(0x1F7) & ATA_STATUS_RDY));
+    while (!(in(ATA_PRIMARY_STATUS) & ATA_STATUS_RDY));
 }
 
-void read_blocks(void *ptr, uint32_t logical_block_address, uint8_t block_count) {
+// 48-bit command take high order bytes first through the same registers, block_count 0 mean maximum
+static void ata_issue_command(uint32_t logical_block_address, uint32_t block_count, bool lba48, uint8_t command) {
+    if (lba48) {
+        out(ATA_PRIMARY_DRIVE, 0x40);
+        out(ATA_PRIMARY_SECCOUNT, (uint8_t) (block_count >> 8));
+        out(ATA_PRIMARY_LBA_LOW, (uint8_t) (logical_block_address >> 24));
+        out(ATA_PRIMARY_LBA_MID, 0);
+        out(ATA_PRIMARY_LBA_HIGH, 0);
+    } else {
+        out(ATA_PRIMARY_DRIVE, 0xE0 | ((logical_block_address >> 24) & 0xF));
+    }
+    out(ATA_PRIMARY_SECCOUNT, (uint8_t) block_count);
+    out(ATA_PRIMARY_LBA_LOW, (uint8_t) logical_block_address);
+    out(ATA_PRIMARY_LBA_MID, (uint8_t) (logical_block_address >> 8));
+    out(ATA_PRIMARY_LBA_HIGH, (uint8_t) (logical_block_address >> 16));
+    out(ATA_PRIMARY_COMMAND, command);
+}
+
+// FLUSH CACHE has no data, device raise INTRQ once cache is written back
+static void ata_issue_flush(void) {
     ATA_busy_wait();
-    out(0x1F6, 0xE0 | ((logical_block_address >> 24) & 0xF));
-    out(0x1F2, block_count);
-    out(0x1F3, (uint8_t) logical_block_address);
-    out(0x1F4, (uint8_t) (logical_block_address >> 8));
-    out(0x1F5, (uint8_t) (logical_block_address >> 16));
-    out(0x1F7, 0x20);
-
-    uint16_t *target = (uint16_t*) ptr;
-    for (uint32_t i = 0; i < block_count; i++) {
-        ATA_busy_wait();
-        ATA_DRQ_wait();
-        for (uint32_t j = 0; j < HALF_BLOCK_SIZE; j++)
-            target[j] = in16(0x1F0);
-        target += HALF_BLOCK_SIZE;
+    out(ATA_PRIMARY_DRIVE, 0xE0);
+    out(ATA_PRIMARY_COMMAND, ata_device.lba48 ? ATA_CMD_FLUSH_CACHE_EXT : ATA_CMD_FLUSH_CACHE);
+}
+
+static uint8_t ata_command_opcode(bool is_write, bool lba48, bool dma) {
+    if (dma)
+        return is_write ? (lba48 ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA)
+                        : (lba48 ? ATA_CMD_READ_DMA_EXT  : ATA_CMD_READ_DMA);
+    if (ata_device.multiple > 1)
+        return is_write ? (lba48 ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_MULTIPLE)
+                        : (lba48 ? ATA_CMD_READ_MULTIPLE_EXT  : ATA_CMD_READ_MULTIPLE);
+    return is_write ? (lba48 ? ATA_CMD_WRITE_PIO_EXT : ATA_CMD_WRITE_PIO)
+                    : (lba48 ? ATA_CMD_READ_PIO_EXT  : ATA_CMD_READ_PIO);
+}
+
+/**
+ * Decide size & addressing of next command for request. 28-bit LBA is used whenever it can
+ * address the whole command, 48-bit otherwise (up to 65536 blocks per command).
+ */
+static void ata_setup_command(struct DiskRequest *request, uint32_t max_blocks) {
+    uint32_t logical_block_address = request->logical_block_address + request->transferred;
+    uint32_t blocks                = request->block_count - request->transferred;
+    uint32_t limit                 = ata_device.lba48 ? ATA_LBA48_MAX_BLOCKS : ATA_LBA28_MAX_BLOCKS;
+    if (blocks > limit)
+        blocks = limit;
+    if (blocks > max_blocks)
+        blocks = max_blocks;
+
+    ata_queue.command_blocks      = blocks;
+    ata_queue.command_transferred = 0;
+    ata_queue.lba48               = ata_device.lba48
+        && (blocks > ATA_LBA28_MAX_BLOCKS || logical_block_address + blocks > ATA_LBA28_MAX_ADDRESS);
+}
+
+static uint32_t interrupt_save_disable(void) {
+    uint32_t eflags;
+    __asm__ volatile("pushf; pop %0; cli" : "=r"(eflags) : : "memory");
+    return eflags;
+}
+
+static void interrupt_restore(uint32_t eflags) {
+    if (eflags & EFLAGS_INTERRUPT_ENABLE)
+        __asm__ volatile("sti" : : : "memory");
+}
+
+/* -- Bus master DMA -- */
+
+// Kernel higher half is single 4 MiB frame mapped to physical 0, only that window is DMA-able
+static bool ata_dma_physical_address(const void *ptr, uint32_t size, uint32_t *physical_address) {
+    uint32_t virtual_address = (uint32_t) ptr;
+    if (virtual_address < KERNEL_VIRTUAL_BASE || (virtual_address & 1) || (size & 1))
+        return false;
+    if (virtual_address - KERNEL_VIRTUAL_BASE + size > PAGE_FRAME_SIZE)
+        return false;
+    *physical_address = virtual_address - KERNEL_VIRTUAL_BASE;
+    return true;
+}
+
+// Fill PRD table with region, splitting entry at every 64 KiB physical boundary
+static bool ata_dma_build_prd(const void *ptr, uint32_t size) {
+    uint32_t physical_address;
+    if (!ata_dma_physical_address(ptr, size, &physical_address))
+        return false;
+
+    uint32_t entry = 0;
+    while (size > 0) {
+        if (entry == ATA_PRD_MAX_ENTRY)
+            return false;
+        uint32_t chunk = ATA_PRD_BOUNDARY - (physical_address & (ATA_PRD_BOUNDARY - 1));
+        if (chunk > size)
+            chunk = size;
+        ata_prd_table[entry].physical_address = physical_address;
+        ata_prd_table[entry].byte_count       = (uint16_t) chunk; // 0x10000 truncated to 0, which mean 64 KiB
+        ata_prd_table[entry].flags            = 0;
+        physical_address += chunk;
+        size             -= chunk;
+        entry++;
+    }
+    ata_prd_table[entry - 1].flags = ATA_PRD_END_OF_TABLE;
+    return true;
+}
+
+/**
+ * Issue next DMA command of request. Kernel buffer is handed directly to controller,
+ * other memory is moved through bounce buffer one chunk per command.
+ * Return false if buffer cannot be described by PRD table.
+ */
+static bool ata_dma_start_chunk(struct DiskRequest *request) {
+    uint32_t remaining = request->block_count - request->transferred;
+    uint8_t *cursor    = (uint8_t*) request->buf + request->transferred * BLOCK_SIZE;
+    uint8_t *target    = cursor;
+    uint32_t physical_address;
+
+    ata_queue.bounce = !ata_dma_physical_address(cursor, remaining * BLOCK_SIZE, &physical_address);
+    ata_setup_command(request, ata_queue.bounce ? ATA_DMA_BOUNCE_SIZE / BLOCK_SIZE : ATA_DMA_MAX_BLOCKS);
+    if (ata_queue.bounce) {
+        target = ata_dma_bounce;
+        if (request->is_write)
+            memcpy(ata_dma_bounce, cursor, ata_queue.command_blocks * BLOCK_SIZE);
+    }
+    if (!ata_dma_build_prd(target, ata_queue.command_blocks * BLOCK_SIZE))
+        return false;
+
+    uint16_t bmide     = ata_dma.bmide_base;
+    uint8_t  direction = request->is_write ? 0 : ATA_BM_COMMAND_READ;
+    uint32_t prdt_physical_address;
+    ata_dma_physical_address(ata_prd_table, sizeof(ata_prd_table), &prdt_physical_address);
+
+    out(bmide + ATA_BM_COMMAND, direction);
+    out32(bmide + ATA_BM_PRDT, prdt_physical_address);
+    out(bmide + ATA_BM_STATUS, in(bmide + ATA_BM_STATUS) | ATA_BM_STATUS_ERR | ATA_BM_STATUS_IRQ);
+
+    ATA_busy_wait();
+    ata_issue_command(
+        request->logical_block_address + request->transferred,
+        ata_queue.command_blocks,
+        ata_queue.lba48,
+        ata_command_opcode(request->is_write, ata_queue.lba48, true)
+    );
+    out(bmide + ATA_BM_COMMAND, direction | ATA_BM_COMMAND_START);
+    return true;
+}
+
+/* -- PIO -- */
+
+// Move one DRQ data block (1 block, or up to multiple count in READ/WRITE MULTIPLE) with rep insw / outsw
+static void ata_pio_transfer_drq_block(struct DiskRequest *request) {
+    uint32_t blocks = 1;
+    if (ata_device.multiple > 1) {
+        blocks = ata_queue.command_blocks - ata_queue.command_transferred;
+        if (blocks > ata_device.multiple)
+            blocks = ata_device.multiple;
     }
+
+    void *cursor = (uint8_t*) request->buf + request->transferred * BLOCK_SIZE;
+    if (request->is_write)
+        out16_rep(ATA_PRIMARY_DATA, cursor, blocks * HALF_BLOCK_SIZE);
+    else
+        in16_rep(ATA_PRIMARY_DATA, cursor, blocks * HALF_BLOCK_SIZE);
+    request->transferred          += blocks;
+    ata_queue.command_transferred += blocks;
 }
 
-void write_blocks(const void *ptr, uint32_t logical_block_address, uint8_t block_count) {
+// PIO command interrupt once per DRQ data block, except first block of write which is sent without waiting IRQ
+static void ata_pio_start(struct DiskRequest *request) {
+    ata_setup_command(request, ATA_LBA48_MAX_BLOCKS);
     ATA_busy_wait();
-    out(0x1F6, 0xE0 | ((logical_block_address >> 24) & 0xF));
-    out(0x1F2, block_count);
-    out(0x1F3, (uint8_t) logical_block_address);
-    out(0x1F4, (uint8_t) (logical_block_address >> 8));
-    out(0x1F5, (uint8_t) (logical_block_address >> 16));
-    out(0x1F7, 0x30);
-
-    for (uint32_t i = 0; i < block_count; i++) {
+    ata_issue_command(
+        request->logical_block_address + request->transferred,
+        ata_queue.command_blocks,
+        ata_queue.lba48,
+        ata_command_opcode(request->is_write, ata_queue.lba48, false)
+    );
+    if (request->is_write) {
         ATA_busy_wait();
         ATA_DRQ_wait();
-        for (uint32_t j = 0; j < HALF_BLOCK_SIZE; j++)
-            out16(0x1F0, ((uint16_t*) ptr)[HALF_BLOCK_SIZE*i + j]);
+        ata_pio_transfer_drq_block(request);
+    }
+}
+
+// Polling PIO transfer, only used before disk_init() enable IRQ driven queue
+static void ata_pio_polling(struct DiskRequest *request) {
+    if (request->is_flush) {
+        ata_issue_flush();
+        ATA_busy_wait();
+        disk_request_complete(request, in(ATA_PRIMARY_STATUS) & (ATA_STATUS_ERR | ATA_STATUS_DF) ? -1 : 0);
+        return;
+    }
+    while (request->transferred < request->block_count) {
+        ata_setup_command(request, ATA_LBA28_MAX_BLOCKS);
+        ATA_busy_wait();
+        ata_issue_command(
+            request->logical_block_address + request->transferred,
+            ata_queue.command_blocks,
+            false,
+            request->is_write ? ATA_CMD_WRITE_PIO : ATA_CMD_READ_PIO
+        );
+        while (ata_queue.command_transferred < ata_queue.command_blocks) {
+            ATA_busy_wait();
+            ATA_DRQ_wait();
+            ata_pio_transfer_drq_block(request);
+        }
+    }
+    disk_request_complete(request, 0);
+}
+
+/* -- Request queue -- */
+
+static void ata_start(struct DiskRequest *request) {
+    ata_queue.current = request;
+    if (request->is_flush) {
+        ata_queue.use_dma = false;
+        ata_issue_flush();
+        return;
+    }
+    ata_queue.use_dma = ata_dma.available;
+    if (ata_queue.use_dma && ata_dma_start_chunk(request))
+        return;
+    ata_queue.use_dma = false;
+    ata_pio_start(request);
+}
+
+static void ata_complete(int8_t status) {
+    struct DiskRequest *request = ata_queue.current;
+    disk_request_complete(request, status);
+    ata_queue.current = NULL;
+
+    struct DiskRequest *next = ata_queue.head;
+    if (next != NULL) {
+        ata_queue.head = next->next;
+        if (ata_queue.head == NULL)
+            ata_queue.tail = NULL;
+        ata_start(next);
+    }
+}
+
+static void ata_dma_isr(struct DiskRequest *request, uint8_t ata_status) {
+    uint16_t bmide     = ata_dma.bmide_base;
+    uint8_t  bm_status = in(bmide + ATA_BM_STATUS);
+    if (!(bm_status & ATA_BM_STATUS_IRQ))
+        return; // Not raised by bus master transfer
+    out(bmide + ATA_BM_COMMAND, request->is_write ? 0 : ATA_BM_COMMAND_READ);
+    out(bmide + ATA_BM_STATUS, bm_status | ATA_BM_STATUS_ERR | ATA_BM_STATUS_IRQ);
+
+    if ((bm_status & ATA_BM_STATUS_ERR) || (ata_status & (ATA_STATUS_ERR | ATA_STATUS_DF))) {
+        // Controller misbehave, stay on PIO from now on and redo remaining blocks
+        ata_dma.available = false;
+        ata_queue.use_dma = false;
+        ata_pio_start(request);
+        return;
+    }
+
+    if (ata_queue.bounce && !request->is_write) {
+        uint8_t *cursor = (uint8_t*) request->buf + request->transferred * BLOCK_SIZE;
+        memcpy(cursor, ata_dma_bounce, ata_queue.command_blocks * BLOCK_SIZE);
     }
+    request->transferred += ata_queue.command_blocks;
+
+    if (request->transferred >= request->block_count) {
+        ata_complete(0);
+        return;
+    }
+    if (!ata_dma_start_chunk(request)) {
+        // Next chunk cannot be described by PRD table, finish request with PIO like ata_start()
+        ata_queue.use_dma = false;
+        ata_pio_start(request);
+    }
+}
+
+static void ata_pio_isr(struct DiskRequest *request, uint8_t ata_status) {
+    if (ata_status & (ATA_STATUS_ERR | ATA_STATUS_DF)) {
+        ata_complete(-1);
+        return;
+    }
+    if (request->is_flush) {
+        ata_complete(0);
+        return;
+    }
+
+    // Write: IRQ after each DRQ block written, last IRQ mark command completion. Read: IRQ when DRQ block is ready
+    if (request->is_write) {
+        if (ata_queue.command_transferred < ata_queue.command_blocks) {
+            ata_pio_transfer_drq_block(request);
+            return;
+        }
+    } else {
+        if (!(ata_status & ATA_STATUS_DRQ))
+            return;
+        ata_pio_transfer_drq_block(request);
+        if (ata_queue.command_transferred < ata_queue.command_blocks)
+            return;
+    }
+
+    if (request->transferred < request->block_count)
+        ata_pio_start(request);
+    else
+        ata_complete(0);
+}
+
+void ata_isr(void) {
+    // Reading status register acknowledge device interrupt
+    uint8_t ata_status = in(ATA_PRIMARY_STATUS);
+
+    struct DiskRequest *request = ata_queue.current;
+    if (request == NULL)
+        return;
+    if (ata_queue.use_dma)
+        ata_dma_isr(request, ata_status);
+    else
+        ata_pio_isr(request, ata_status);
+}
+
+// Completion handler of PCI controller
+static void disk_controller_isr(void) {
+    if (disk_backend.controller == DISK_CONTROLLER_AHCI)
+        ahci_isr();
+    else if (disk_backend.controller == DISK_CONTROLLER_VIRTIO)
+        virtio_blk_isr();
+}
+
+void disk_pci_isr(uint8_t irq) {
+    if (disk_backend.controller != DISK_CONTROLLER_ATA && irq == disk_backend.irq)
+        disk_controller_isr();
+}
+
+void disk_submit(struct DiskRequest *request) {
+    request->transferred = 0;
+    request->status      = 0;
+    request->done        = false;
+    request->next        = NULL;
+    if (request->block_count == 0 && !request->is_flush) {
+        disk_request_complete(request, 0);
+        return;
+    }
+    if (disk_backend.controller != DISK_CONTROLLER_ATA) {
+        uint32_t eflags = interrupt_save_disable();
+        if (disk_backend.controller == DISK_CONTROLLER_AHCI)
+            ahci_submit(request);
+        else
+            virtio_blk_submit(request);
+        interrupt_restore(eflags);
+        return;
+    }
+    if (request->is_flush && !ata_device.write_cache) {
+        disk_request_complete(request, 0);
+        return;
+    }
+    if (!ata_queue.ready) {
+        ata_pio_polling(request);
+        return;
+    }
+
+    uint32_t eflags = interrupt_save_disable();
+    if (ata_queue.current == NULL) {
+        ata_start(request);
+    } else {
+        if (ata_queue.tail != NULL)
+            ata_queue.tail->next = request;
+        else
+            ata_queue.head = request;
+        ata_queue.tail = request;
+    }
+    interrupt_restore(eflags);
+}
+
+void disk_kick(void) {
+    if (disk_backend.controller != DISK_CONTROLLER_VIRTIO)
+        return;
+    uint32_t eflags = interrupt_save_disable();
+    virtio_blk_kick();
+    interrupt_restore(eflags);
+}
+
+void disk_wait(struct DiskRequest *request) {
+    bool     polling = disk_backend.controller != DISK_CONTROLLER_ATA && disk_backend.irq == DISK_IRQ_NONE;
+    uint32_t eflags;
+    __asm__ volatile("pushf; pop %0" : "=r"(eflags));
+    disk_kick();
+    while (true) {
+        __asm__ volatile("cli" : : : "memory");
+        if (polling)
+            disk_controller_isr();
+        if (request->done)
+            break;
+        if (polling) {
+            // No interrupt will wake hlt, keep polling HBA
+            __asm__ volatile("sti; pause" : : : "memory");
+            continue;
+        }
+        // sti take effect after hlt, no interrupt can slip between check and sleep
+        __asm__ volatile("sti; hlt" : : : "memory");
+    }
+    interrupt_restore(eflags);
+}
+
+/* -- Initialization -- */
+
+static bool ata_identify(uint16_t *identify) {
+    out(ATA_PRIMARY_DRIVE, 0xA0);
+    out(ATA_PRIMARY_SECCOUNT, 0);
+    out(ATA_PRIMARY_LBA_LOW, 0);
+    out(ATA_PRIMARY_LBA_MID, 0);
+    out(ATA_PRIMARY_LBA_HIGH, 0);
+    out(ATA_PRIMARY_COMMAND, ATA_CMD_IDENTIFY);
+    uint8_t status = in(ATA_PRIMARY_STATUS);
+    if (status == 0 || status == 0xFF)
+        return false; // No device on primary master
+    ATA_busy_wait();
+    if (in(ATA_PRIMARY_LBA_MID) != 0 || in(ATA_PRIMARY_LBA_HIGH) != 0)
+        return false; // Not ATA device
+    while (!(in(ATA_PRIMARY_STATUS) & (ATA_STATUS_DRQ | ATA_STATUS_ERR)));
+    if (in(ATA_PRIMARY_STATUS) & ATA_STATUS_ERR)
+        return false;
+    in16_rep(ATA_PRIMARY_DATA, identify, HALF_BLOCK_SIZE);
+    return true;
+}
+
+// Enable READ/WRITE MULTIPLE with largest DRQ block device support, return 0 if not supported
+static uint32_t ata_set_multiple_mode(const uint16_t *identify) {
+    uint32_t multiple = identify[ATA_IDENTIFY_MAX_MULTIPLE] & 0xFF;
+    if (multiple <= 1)
+        return 0;
+
+    out(ATA_PRIMARY_DRIVE, 0xE0);
+    out(ATA_PRIMARY_SECCOUNT, (uint8_t) multiple);
+    out(ATA_PRIMARY_COMMAND, ATA_CMD_SET_MULTIPLE);
+    ATA_busy_wait();
+    if (in(ATA_PRIMARY_STATUS) & (ATA_STATUS_ERR | ATA_STATUS_DF))
+        return 0;
+    return multiple;
+}
+
+// PCI IDE controller with bus mastering, ex: PIIX3 in QEMU
+static bool ata_dma_probe(void) {
+    struct PCIDevice controller;
+    if (!pci_find_class(PCI_CLASS_MASS_STORAGE, PCI_SUBCLASS_IDE, &controller))
+        return false;
+    if (!(controller.prog_if & PCI_PROG_IF_IDE_BUS_MASTER))
+        return false;
+    uint32_t bar4 = pci_read_bar(&controller, 4);
+    if (!(bar4 & PCI_BAR_IO))
+        return false;
+
+    pci_enable_bus_master(&controller);
+    ata_dma.bmide_base = (uint16_t) (bar4 & PCI_BAR_IO_MASK);
+    out(ata_dma.bmide_base + ATA_BM_COMMAND, 0);
+    out(ata_dma.bmide_base + ATA_BM_STATUS, ATA_BM_STATUS_ERR | ATA_BM_STATUS_IRQ);
+    return true;
+}
+
+uint32_t ata_identify_capacity(const uint16_t *identify) {
+    const uint16_t *sectors = &identify[ATA_IDENTIFY_LBA28_SECTORS];
+    if (identify[ATA_IDENTIFY_COMMAND_SET] & ATA_IDENTIFY_CMD_LBA48) {
+        const uint16_t *sectors48 = &identify[ATA_IDENTIFY_LBA48_SECTORS];
+        if (sectors48[2] || sectors48[3])
+            return 0xFFFFFFFF; // Beyond 32-bit LBA of DiskRequest
+        if (sectors48[0] || sectors48[1])
+            sectors = sectors48;
+    }
+    return sectors[0] | ((uint32_t) sectors[1] << 16);
+}
+
+static void disk_use_pci_controller(uint8_t controller, uint8_t irq) {
+    disk_backend.controller = controller;
+    disk_backend.irq        = activate_pci_interrupt(irq) ? irq : DISK_IRQ_NONE;
+}
+
+void disk_init(uint8_t controller) {
+    uint8_t  irq;
+    uint32_t *capacity = &disk_block_device.capacity;
+    iosched_init(&disk_io_queue, &disk_block_device);
+    blockdev_register(&disk_block_device);
+    if ((controller == DISK_CONTROLLER_AUTO || controller == DISK_CONTROLLER_VIRTIO) && virtio_blk_init(&irq, capacity)) {
+        disk_use_pci_controller(DISK_CONTROLLER_VIRTIO, irq);
+        return;
+    }
+    if ((controller == DISK_CONTROLLER_AUTO || controller == DISK_CONTROLLER_AHCI) && ahci_init(&irq, capacity)) {
+        disk_use_pci_controller(DISK_CONTROLLER_AHCI, irq);
+        return;
+    }
+
+    uint16_t identify[HALF_BLOCK_SIZE];
+    ata_dma.available = false;
+    if (!ata_identify(identify))
+        return;
+
+    ata_device.lba48       = (identify[ATA_IDENTIFY_COMMAND_SET] & ATA_IDENTIFY_CMD_LBA48) != 0;
+    ata_device.write_cache = (identify[ATA_IDENTIFY_FEATURE_SET] & ATA_IDENTIFY_CMD_WCACHE) != 0;
+    *capacity              = ata_identify_capacity(identify);
+    ata_device.multiple    = ata_set_multiple_mode(identify);
+    if (identify[ATA_IDENTIFY_CAPABILITIES] & ATA_IDENTIFY_CAP_DMA)
+        ata_dma.available = ata_dma_probe();
+
+    out(ATA_PRIMARY_CONTROL, 0); // nIEN = 0, device may assert INTRQ
+    in(ATA_PRIMARY_STATUS);      // Drop interrupt pending from IDENTIFY
+    ata_queue.head    = NULL;
+    ata_queue.tail    = NULL;
+    ata_queue.current = NULL;
+    ata_queue.ready   = true;
+}
+
+/* -- Blocking interface -- */
+
+void read_blocks(void *ptr, uint32_t logical_block_address, uint32_t block_count) {
+    struct DiskRequest request = {
+        .buf                   = ptr,
+        .logical_block_address = logical_block_address,
+        .block_count           = block_count,
+        .is_write              = false,
+    };
+    disk_submit(&request);
+    disk_wait(&request);
+}
+
+void write_blocks(const void *ptr, uint32_t logical_block_address, uint32_t block_count) {
+    struct DiskRequest request = {
+        .buf                   = (void*) ptr,
+        .logical_block_address = logical_block_address,
+        .block_count           = block_count,
+        .is_write              = true,
+    };
+    disk_submit(&request);
+    disk_wait(&request);
+}
+
+int8_t disk_flush(void) {
+    struct DiskRequest request = {
+        .is_flush = true,
+    };
+    disk_submit(&request);
+    disk_wait(&request);
+    return request.status;
 }
@@ -0,0 +1,312 @@
+#include "header/iosched.h"
+#include "header/blockdev.h"
+#include "header/stdlib/string.h"
+
+static void iosched_drain(struct IOQueue *queue);
+
+void iosched_init(struct IOQueue *queue, struct BlockDevice *device) {
+    queue->device = device;
+    for (uint32_t i = 0; i < IOSCHED_MAX_PENDING; i++) {
+        queue->requests[i].in_use = false;
+        queue->requests[i].staged = false;
+    }
+    queue->tunables.merge_window = IOSCHED_DEFAULT_MERGE_WINDOW;
+    queue->tunables.read_expire  = IOSCHED_DEFAULT_READ_EXPIRE;
+    queue->tunables.write_expire = IOSCHED_DEFAULT_WRITE_EXPIRE;
+    queue->tunables.max_pending  = IOSCHED_DEFAULT_MAX_PENDING;
+    queue->pending        = 0;
+    queue->staged_command = NULL;
+    queue->inflight_count = 0;
+    queue->plug_depth     = 0;
+    queue->head_position  = 0;
+    queue->dispatch_clock = 0;
+    queue->write_error    = 0;
+}
+
+void iosched_set_tunables(struct IOQueue *queue, const struct IOQueueTunables *tunables) {
+    queue->tunables = *tunables;
+    if (queue->tunables.merge_window < 1)
+        queue->tunables.merge_window = 1;
+    if (queue->tunables.merge_window > IOSCHED_MAX_MERGE_BLOCKS)
+        queue->tunables.merge_window = IOSCHED_MAX_MERGE_BLOCKS;
+    if (queue->tunables.max_pending < 1)
+        queue->tunables.max_pending = 1;
+    if (queue->tunables.max_pending > IOSCHED_MAX_PENDING)
+        queue->tunables.max_pending = IOSCHED_MAX_PENDING;
+    if (queue->pending >= queue->tunables.max_pending)
+        iosched_drain(queue);
+}
+
+/* -- Dispatch -- */
+
+static int8_t iosched_submit_wait(struct IOQueue *queue, void *ptr, uint32_t logical_block_address, uint32_t block_count, bool is_write) {
+    struct DiskRequest request = {
+        .buf                   = ptr,
+        .logical_block_address = logical_block_address,
+        .block_count           = block_count,
+        .is_write              = is_write,
+    };
+    blockdev_submit(queue->device, &request);
+    blockdev_kick(queue->device);
+    blockdev_wait(queue->device, &request);
+    queue->head_position = logical_block_address + block_count;
+    queue->dispatch_clock++;
+    return request.status;
+}
+
+// Submit without waiting, completed at the end of iosched_drain()
+static struct DiskRequest *iosched_submit(struct IOQueue *queue, void *ptr, uint32_t logical_block_address, uint32_t block_count, bool is_write, int8_t *status) {
+    queue->read_status[queue->inflight_count] = status;
+    struct DiskRequest *request = &queue->inflight[queue->inflight_count++];
+    request->buf                   = ptr;
+    request->logical_block_address = logical_block_address;
+    request->block_count           = block_count;
+    request->is_write              = is_write;
+    request->is_flush              = false;
+    blockdev_submit(queue->device, request);
+    queue->head_position = logical_block_address + block_count;
+    queue->dispatch_clock++;
+    return request;
+}
+
+// Wait for dispatched command, failed write is remembered for iosched_flush() and read status is handed to its owner
+static void iosched_complete(struct IOQueue *queue, struct DiskRequest *command, int8_t *status) {
+    blockdev_wait(queue->device, command);
+    if (command->is_write && command->status != 0)
+        queue->write_error = -1;
+    if (status != NULL)
+        *status = command->status;
+}
+
+// Wait for merged command using staging buffer, then scatter read data back to its requests
+static void iosched_release_staging(struct IOQueue *queue) {
+    struct DiskRequest *command = queue->staged_command;
+    if (command == NULL)
+        return;
+
+    iosched_complete(queue, command, NULL);
+    for (uint32_t i = 0; i < IOSCHED_MAX_PENDING; i++) {
+        struct IORequest *request = &queue->requests[i];
+        if (!request->staged)
+            continue;
+        if (!command->is_write)
+            memcpy(request->buf, &queue->staging[request->logical_block_address - command->logical_block_address],
+                   request->block_count * BLOCK_SIZE);
+        if (request->status != NULL)
+            *request->status = command->status;
+        request->staged = false;
+    }
+    queue->staged_command = NULL;
+}
+
+// Earliest expired request first, otherwise C-LOOK: lowest LBA at or after head, wrapping to lowest LBA
+static int32_t iosched_pick(struct IOQueue *queue) {
+    int32_t expired = -1, ahead = -1, lowest = -1;
+    for (int32_t i = 0; i < IOSCHED_MAX_PENDING; i++) {
+        struct IORequest *request = &queue->requests[i];
+        if (!request->in_use)
+            continue;
+        if (request->deadline <= queue->dispatch_clock
+                && (expired == -1 || request->deadline < queue->requests[expired].deadline))
+            expired = i;
+        if (request->logical_block_address >= queue->head_position
+                && (ahead == -1 || request->logical_block_address < queue->requests[ahead].logical_block_address))
+            ahead = i;
+        if (lowest == -1 || request->logical_block_address < queue->requests[lowest].logical_block_address)
+            lowest = i;
+    }
+    if (expired != -1)
+        return expired;
+    return ahead != -1 ? ahead : lowest;
+}
+
+// Find pending request of given direction starting / ending exactly at block
+static int32_t iosched_find_adjacent(struct IOQueue *queue, bool is_write, uint32_t block, bool starting_at, uint32_t max_blocks) {
+    for (int32_t i = 0; i < IOSCHED_MAX_PENDING; i++) {
+        struct IORequest *request = &queue->requests[i];
+        if (!request->in_use || request->is_write != is_write || request->block_count > max_blocks)
+            continue;
+        if (starting_at ? request->logical_block_address == block
+                        : request->logical_block_address + request->block_count == block)
+            return i;
+    }
+    return -1;
+}
+
+// Dispatch one command: chosen request merged with every adjacent request of same direction that fit merge window
+static void iosched_dispatch_one(struct IOQueue *queue) {
+    int32_t  members[IOSCHED_MAX_PENDING];
+    uint32_t member_count = 0;
+
+    int32_t first = iosched_pick(queue);
+    bool     is_write = queue->requests[first].is_write;
+    uint32_t start    = queue->requests[first].logical_block_address;
+    uint32_t end      = start + queue->requests[first].block_count;
+    members[member_count++] = first;
+    queue->requests[first].in_use = false;
+
+    while (end - start < queue->tunables.merge_window) {
+        uint32_t room = queue->tunables.merge_window - (end - start);
+        int32_t  next = iosched_find_adjacent(queue, is_write, end, true, room);
+        if (next == -1)
+            next = iosched_find_adjacent(queue, is_write, start, false, room);
+        if (next == -1)
+            break;
+
+        struct IORequest *request = &queue->requests[next];
+        request->in_use = false;
+        if (request->logical_block_address == end)
+            end += request->block_count;
+        else
+            start = request->logical_block_address;
+        members[member_count++] = next;
+    }
+    queue->pending -= member_count;
+    blockdev_account_merge(queue->device, is_write, member_count - 1);
+
+    if (member_count == 1) {
+        struct IORequest *request = &queue->requests[first];
+        iosched_submit(queue, request->buf, start, end - start, is_write, request->status);
+        return;
+    }
+
+    // Merged command go through contiguous staging buffer, previous merged command must finish first
+    iosched_release_staging(queue);
+    for (uint32_t i = 0; i < member_count; i++) {
+        struct IORequest *request = &queue->requests[members[i]];
+        request->staged = true;
+        if (is_write)
+            memcpy(&queue->staging[request->logical_block_address - start], request->buf, request->block_count * BLOCK_SIZE);
+    }
+    queue->staged_command = iosched_submit(queue, queue->staging, start, end - start, is_write, NULL);
+}
+
+// Dispatch & complete every pending request, write error is kept for next iosched_flush()
+static void iosched_drain(struct IOQueue *queue) {
+    // Slot & write data of dispatched request stay untouched until every command is completed,
+    // nothing is queued during flush
+    while (queue->pending > 0)
+        iosched_dispatch_one(queue);
+    blockdev_kick(queue->device);
+
+    iosched_release_staging(queue);
+    for (uint32_t i = 0; i < queue->inflight_count; i++)
+        iosched_complete(queue, &queue->inflight[i], queue->read_status[i]);
+    queue->inflight_count = 0;
+}
+
+int8_t iosched_flush(struct IOQueue *queue) {
+    iosched_drain(queue);
+    int8_t status      = queue->write_error;
+    queue->write_error = 0;
+    return status;
+}
+
+void iosched_plug(struct IOQueue *queue) {
+    queue->plug_depth++;
+}
+
+int8_t iosched_unplug(struct IOQueue *queue) {
+    if (queue->plug_depth > 0)
+        queue->plug_depth--;
+    if (queue->plug_depth == 0)
+        return iosched_flush(queue);
+    return 0;
+}
+
+/* -- Queueing -- */
+
+static int32_t iosched_find_overlap(struct IOQueue *queue, bool is_write, uint32_t logical_block_address, uint32_t block_count) {
+    for (int32_t i = 0; i < IOSCHED_MAX_PENDING; i++) {
+        struct IORequest *request = &queue->requests[i];
+        if (!request->in_use || request->is_write != is_write)
+            continue;
+        if (request->logical_block_address < logical_block_address + block_count
+                && logical_block_address < request->logical_block_address + request->block_count)
+            return i;
+    }
+    return -1;
+}
+
+static struct IORequest *iosched_alloc(struct IOQueue *queue, int32_t *index) {
+    if (queue->pending >= queue->tunables.max_pending)
+        iosched_drain(queue);
+    for (int32_t i = 0; i < IOSCHED_MAX_PENDING; i++) {
+        if (!queue->requests[i].in_use) {
+            queue->requests[i].in_use = true;
+            queue->pending++;
+            *index = i;
+            return &queue->requests[i];
+        }
+    }
+    return NULL; // Unreachable, drain always free every slot
+}
+
+// Single block read satisfied from queued write, multi block read overlapping queued write flush the queue first
+static bool iosched_read_from_pending(struct IOQueue *queue, void *ptr, uint32_t logical_block_address, uint32_t block_count) {
+    int32_t overlap = iosched_find_overlap(queue, true, logical_block_address, block_count);
+    if (overlap == -1)
+        return false;
+    if (block_count == 1) {
+        memcpy(ptr, queue->requests[overlap].buf, BLOCK_SIZE);
+        return true;
+    }
+    iosched_drain(queue);
+    return false;
+}
+
+int8_t iosched_read(struct IOQueue *queue, void *ptr, uint32_t logical_block_address, uint32_t block_count) {
+    if (block_count == 0 || iosched_read_from_pending(queue, ptr, logical_block_address, block_count))
+        return 0;
+    return iosched_submit_wait(queue, ptr, logical_block_address, block_count, false);
+}
+
+int8_t iosched_read_async(struct IOQueue *queue, void *ptr, uint32_t logical_block_address, uint32_t block_count, int8_t *status) {
+    if (queue->plug_depth == 0) {
+        int8_t result = iosched_read(queue, ptr, logical_block_address, block_count);
+        if (status != NULL)
+            *status = result;
+        return result;
+    }
+    if (status != NULL)
+        *status = 0;
+    if (block_count == 0 || iosched_read_from_pending(queue, ptr, logical_block_address, block_count))
+        return 0;
+
+    int32_t index;
+    struct IORequest *request = iosched_alloc(queue, &index);
+    request->is_write              = false;
+    request->logical_block_address = logical_block_address;
+    request->block_count           = block_count;
+    request->buf                   = ptr;
+    request->deadline              = queue->dispatch_clock + queue->tunables.read_expire;
+    request->status                = status;
+    return 0;
+}
+
+int8_t iosched_write(struct IOQueue *queue, const void *ptr, uint32_t logical_block_address, uint32_t block_count) {
+    const struct BlockBuffer *data = (const struct BlockBuffer*) ptr;
+    for (uint32_t i = 0; i < block_count; i++) {
+        uint32_t block = logical_block_address + i;
+
+        // Queued read of this block must observe old data
+        if (iosched_find_overlap(queue, false, block, 1) != -1)
+            iosched_drain(queue);
+
+        int32_t index = iosched_find_overlap(queue, true, block, 1);
+        if (index == -1) {
+            struct IORequest *request = iosched_alloc(queue, &index);
+            request->is_write              = true;
+            request->logical_block_address = block;
+            request->block_count           = 1;
+            request->buf                   = &queue->write_data[index];
+            request->deadline              = queue->dispatch_clock + queue->tunables.write_expire;
+            request->status                = NULL;
+        }
+        memcpy(&queue->write_data[index], &data[i], BLOCK_SIZE);
+    }
+
+    if (queue->plug_depth == 0)
+        return iosched_flush(queue);
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "header/ramdisk.h"
+#include "header/stdlib/string.h"
+
+static void ramdisk_submit(struct BlockDevice *device, struct DiskRequest *request) {
+    uint8_t *storage = (uint8_t*) device->driver_data;
+    request->transferred = 0;
+    request->next        = NULL;
+    if (request->logical_block_address > device->capacity
+            || request->block_count > device->capacity - request->logical_block_address) {
+        disk_request_complete(request, -1);
+        return;
+    }
+
+    uint8_t *disk = storage + request->logical_block_address * BLOCK_SIZE;
+    uint32_t size = request->block_count * BLOCK_SIZE;
+    if (request->is_write)
+        memcpy(disk, request->buf, size);
+    else
+        memcpy(request->buf, disk, size);
+    request->transferred = request->block_count;
+    disk_request_complete(request, 0);
+}
+
+static void ramdisk_wait(struct BlockDevice *device, struct DiskRequest *request) {
+    (void) device;
+    (void) request; // Completed in submit
+}
+
+static int8_t ramdisk_flush(struct BlockDevice *device) {
+    (void) device;
+    return 0; // Memory is written directly, no cache
+}
+
+static const struct BlockDeviceOps ramdisk_ops = {
+    .submit = ramdisk_submit,
+    .kick   = NULL,
+    .wait   = ramdisk_wait,
+    .flush  = ramdisk_flush,
+};
+
+void ramdisk_init(struct BlockDevice *device, const char *name, void *storage, uint32_t size) {
+    device->name        = name;
+    device->ops         = &ramdisk_ops;
+    device->sector_size = BLOCK_SIZE;
+    device->capacity    = size / BLOCK_SIZE;
+    device->queue       = NULL;
+    device->driver_data = storage;
+    blockdev_register(device);
+}
@@ -0,0 +1,283 @@
+#include "header/virtio.h"
+#include "header/pci.h"
+#include "header/portio.h"
+#include "header/memory/paging.h"
+#include "header/stdlib/string.h"
+
+/**
+ * virtio-blk driver state, single request queue (queue 0)
+ *
+ * @param io_base      Legacy register I/O base (BAR0), 0 if no device
+ * @param queue_size   Queue size dictated by device
+ * @param flush        VIRTIO_BLK_F_FLUSH negotiated, flush request is sent as VIRTIO_BLK_T_FLUSH
+ * @param descriptors  Descriptor table
+ * @param available    Available ring
+ * @param used         Used ring
+ * @param free_head    First free descriptor, free descriptors are linked by next
+ * @param free_count   Number of free descriptor
+ * @param last_used    Used ring index already consumed by driver
+ * @param unkicked     Chains made available since last notify
+ * @param slot_request Request of chain, indexed by head descriptor
+ * @param slot_blocks  Block count of chain, indexed by head descriptor
+ * @param head         First request waiting for free descriptors
+ * @param tail         Last request waiting for free descriptors
+ */
+static struct {
+    uint16_t                         io_base;
+    uint16_t                         queue_size;
+    bool                             flush;
+    struct VirtqDescriptor          *descriptors;
+    struct VirtqAvailable           *available;
+    volatile struct VirtqUsed       *used;
+    uint16_t                         free_head;
+    uint16_t                         free_count;
+    uint16_t                         last_used;
+    uint16_t                         unkicked;
+    struct DiskRequest              *slot_request[VIRTQ_MAX_SIZE];
+    uint32_t                         slot_blocks[VIRTQ_MAX_SIZE];
+    struct DiskRequest              *head;
+    struct DiskRequest              *tail;
+} virtio_blk;
+
+static uint8_t virtio_blk_queue_memory[VIRTQ_MEMORY_SIZE(VIRTQ_MAX_SIZE)] __attribute__((aligned(VIRTQ_ALIGN)));
+// Request header & status byte of chain, indexed by head descriptor
+static struct VirtioBlkRequestHeader virtio_blk_headers[VIRTQ_MAX_SIZE];
+static volatile uint8_t              virtio_blk_status[VIRTQ_MAX_SIZE];
+
+static uint32_t virtio_blk_physical_address(const volatile void *ptr) {
+    uint32_t physical_address = 0;
+    paging_virtual_to_physical(&_paging_kernel_page_directory, (const void*) ptr, &physical_address);
+    return physical_address;
+}
+
+/* -- Descriptor allocation -- */
+
+static uint16_t virtio_blk_alloc_descriptor(void) {
+    uint16_t index = virtio_blk.free_head;
+    virtio_blk.free_head = virtio_blk.descriptors[index].next;
+    virtio_blk.free_count--;
+    return index;
+}
+
+static void virtio_blk_free_chain(uint16_t head) {
+    uint16_t index = head;
+    while (true) {
+        virtio_blk.free_count++;
+        if (!(virtio_blk.descriptors[index].flags & VIRTQ_DESC_F_NEXT))
+            break;
+        index = virtio_blk.descriptors[index].next;
+    }
+    virtio_blk.descriptors[index].next = virtio_blk.free_head;
+    virtio_blk.free_head = head;
+}
+
+/* -- Request chain -- */
+
+// Data descriptors needed for buffer, split at 4 MiB page frame boundary. 0 if part of buffer is not mapped
+static uint32_t virtio_blk_count_segments(const uint8_t *ptr, uint32_t size) {
+    uint32_t virtual_address = (uint32_t) ptr;
+    uint32_t segments        = 0;
+    while (size > 0) {
+        uint32_t physical_address;
+        if (!paging_virtual_to_physical(&_paging_kernel_page_directory, (void*) virtual_address, &physical_address))
+            return 0;
+        uint32_t chunk = VIRTIO_BLK_SEGMENT_MAX_BYTES - (virtual_address & (VIRTIO_BLK_SEGMENT_MAX_BYTES - 1));
+        if (chunk > size)
+            chunk = size;
+        virtual_address += chunk;
+        size            -= chunk;
+        segments++;
+    }
+    return segments;
+}
+
+static void virtio_blk_complete(struct DiskRequest *request, int8_t status) {
+    disk_request_complete(request, status);
+}
+
+// Make next chunk of request available: header, data segments, status. False if not enough free descriptor
+static bool virtio_blk_start(struct DiskRequest *request) {
+    uint32_t logical_block_address = request->logical_block_address + request->transferred;
+    uint32_t block_count           = request->block_count - request->transferred;
+    uint8_t *ptr                   = (uint8_t*) request->buf + request->transferred * BLOCK_SIZE;
+    if (block_count > VIRTIO_BLK_MAX_BLOCKS)
+        block_count = VIRTIO_BLK_MAX_BLOCKS;
+
+    // Flush chain is header & status only
+    uint32_t segments = request->is_flush ? 0 : virtio_blk_count_segments(ptr, block_count * BLOCK_SIZE);
+    if (segments == 0 && !request->is_flush) {
+        virtio_blk_complete(request, -1);
+        return true;
+    }
+    if (virtio_blk.free_count < segments + 2)
+        return false;
+
+    uint16_t head = virtio_blk_alloc_descriptor();
+    virtio_blk_headers[head].type     = request->is_flush ? VIRTIO_BLK_T_FLUSH
+                                      : request->is_write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    virtio_blk_headers[head].reserved = 0;
+    virtio_blk_headers[head].sector   = logical_block_address;
+    virtio_blk_status[head]           = 0xFF;
+
+    struct VirtqDescriptor *descriptor = &virtio_blk.descriptors[head];
+    descriptor->address = virtio_blk_physical_address(&virtio_blk_headers[head]);
+    descriptor->length  = sizeof(struct VirtioBlkRequestHeader);
+
+    uint32_t virtual_address = (uint32_t) ptr;
+    uint32_t size            = block_count * BLOCK_SIZE;
+    while (size > 0) {
+        uint32_t chunk = VIRTIO_BLK_SEGMENT_MAX_BYTES - (virtual_address & (VIRTIO_BLK_SEGMENT_MAX_BYTES - 1));
+        if (chunk > size)
+            chunk = size;
+
+        uint16_t index    = virtio_blk_alloc_descriptor();
+        descriptor->flags = VIRTQ_DESC_F_NEXT;
+        descriptor->next  = index;
+        descriptor        = &virtio_blk.descriptors[index];
+        descriptor->address = virtio_blk_physical_address((void*) virtual_address);
+        descriptor->length  = chunk;
+        descriptor->flags   = request->is_write ? 0 : VIRTQ_DESC_F_WRITE;
+        virtual_address += chunk;
+        size            -= chunk;
+    }
+
+    uint16_t status_index = virtio_blk_alloc_descriptor();
+    descriptor->flags    |= VIRTQ_DESC_F_NEXT;
+    descriptor->next      = status_index;
+    descriptor            = &virtio_blk.descriptors[status_index];
+    descriptor->address   = virtio_blk_physical_address(&virtio_blk_status[head]);
+    descriptor->length    = 1;
+    descriptor->flags     = VIRTQ_DESC_F_WRITE;
+
+    virtio_blk.slot_request[head] = request;
+    virtio_blk.slot_blocks[head]  = block_count;
+
+    // Chain must be visible before its ring entry, ring entry before index
+    virtio_blk.available->ring[virtio_blk.available->index % virtio_blk.queue_size] = head;
+    __asm__ volatile("" : : : "memory");
+    virtio_blk.available->index++;
+    virtio_blk.unkicked++;
+    return true;
+}
+
+/* -- Queue -- */
+
+static void virtio_blk_issue_waiting(void) {
+    while (virtio_blk.head != NULL) {
+        struct DiskRequest *request = virtio_blk.head;
+        if (!virtio_blk_start(request))
+            return;
+        virtio_blk.head = request->next;
+        if (virtio_blk.head == NULL)
+            virtio_blk.tail = NULL;
+        request->next = NULL;
+    }
+}
+
+void virtio_blk_kick(void) {
+    if (virtio_blk.unkicked == 0)
+        return;
+    virtio_blk.unkicked = 0;
+    __asm__ volatile("" : : : "memory");
+    if (!(virtio_blk.used->flags & VIRTQ_USED_F_NO_NOTIFY))
+        out16(virtio_blk.io_base + VIRTIO_PCI_QUEUE_NOTIFY, 0);
+}
+
+void virtio_blk_submit(struct DiskRequest *request) {
+    if (request->is_flush && !virtio_blk.flush) {
+        // Without VIRTIO_BLK_F_FLUSH device write through, completed write is already stable
+        virtio_blk_complete(request, 0);
+        return;
+    }
+    request->next = NULL;
+    if (virtio_blk.tail != NULL)
+        virtio_blk.tail->next = request;
+    else
+        virtio_blk.head = request;
+    virtio_blk.tail = request;
+    virtio_blk_issue_waiting();
+}
+
+void virtio_blk_isr(void) {
+    if (virtio_blk.io_base == 0)
+        return;
+
+    in(virtio_blk.io_base + VIRTIO_PCI_ISR_STATUS);
+    while (virtio_blk.last_used != virtio_blk.used->index) {
+        uint16_t head = (uint16_t) virtio_blk.used->ring[virtio_blk.last_used % virtio_blk.queue_size].id;
+        virtio_blk.last_used++;
+
+        struct DiskRequest *request = virtio_blk.slot_request[head];
+        uint8_t status              = virtio_blk_status[head];
+        virtio_blk.slot_request[head] = NULL;
+        virtio_blk_free_chain(head);
+
+        if (status != VIRTIO_BLK_S_OK) {
+            virtio_blk_complete(request, -1);
+            continue;
+        }
+        request->transferred += virtio_blk.slot_blocks[head];
+        if (request->transferred < request->block_count) {
+            // Rest of split request go before other waiting request, keep submission order
+            request->next   = virtio_blk.head;
+            virtio_blk.head = request;
+            if (virtio_blk.tail == NULL)
+                virtio_blk.tail = request;
+            continue;
+        }
+        virtio_blk_complete(request, 0);
+    }
+    virtio_blk_issue_waiting();
+    virtio_blk_kick();
+}
+
+/* -- Initialization -- */
+
+bool virtio_blk_init(uint8_t *irq, uint32_t *capacity) {
+    struct PCIDevice device;
+    if (!pci_find_device(VIRTIO_PCI_VENDOR_ID, VIRTIO_PCI_DEVICE_BLK_LEGACY, &device))
+        return false;
+    uint32_t bar0 = pci_read_bar(&device, 0);
+    if (!(bar0 & PCI_BAR_IO))
+        return false;
+    uint16_t io_base = (uint16_t) (bar0 & PCI_BAR_IO_MASK);
+    pci_enable_bus_master(&device);
+
+    // Reset, then driver handshake. Only cache flush is negotiated
+    out(io_base + VIRTIO_PCI_DEVICE_STATUS, 0);
+    out(io_base + VIRTIO_PCI_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    out(io_base + VIRTIO_PCI_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+    uint32_t features = in32(io_base + VIRTIO_PCI_DEVICE_FEATURES) & VIRTIO_BLK_F_FLUSH;
+    out32(io_base + VIRTIO_PCI_GUEST_FEATURES, features);
+    virtio_blk.flush = features != 0;
+
+    out16(io_base + VIRTIO_PCI_QUEUE_SELECT, 0);
+    uint16_t queue_size = in16(io_base + VIRTIO_PCI_QUEUE_SIZE);
+    if (queue_size < 3 || queue_size > VIRTQ_MAX_SIZE) {
+        out(io_base + VIRTIO_PCI_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+
+    memset(virtio_blk_queue_memory, 0, sizeof(virtio_blk_queue_memory));
+    virtio_blk.queue_size  = queue_size;
+    virtio_blk.descriptors = (struct VirtqDescriptor*) virtio_blk_queue_memory;
+    virtio_blk.available   = (struct VirtqAvailable*) (virtio_blk_queue_memory + 16 * queue_size);
+    virtio_blk.used        = (struct VirtqUsed*) (virtio_blk_queue_memory + VIRTQ_ALIGN_UP(16 * queue_size + 6 + 2 * queue_size));
+    for (uint16_t i = 0; i < queue_size; i++)
+        virtio_blk.descriptors[i].next = i + 1;
+    virtio_blk.free_head  = 0;
+    virtio_blk.free_count = queue_size;
+    virtio_blk.last_used  = 0;
+    virtio_blk.unkicked   = 0;
+    virtio_blk.head       = NULL;
+    virtio_blk.tail       = NULL;
+    out32(io_base + VIRTIO_PCI_QUEUE_ADDRESS, virtio_blk_physical_address(virtio_blk_queue_memory) / VIRTQ_ALIGN);
+
+    out(io_base + VIRTIO_PCI_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+    virtio_blk.io_base = io_base;
+    *irq = device.interrupt_line;
+    // Capacity above 32-bit LBA is not addressable by DiskRequest
+    uint32_t capacity_high = in32(io_base + VIRTIO_BLK_CONFIG_CAPACITY + 4);
+    *capacity = capacity_high != 0 ? 0xFFFFFFFF : in32(io_base + VIRTIO_BLK_CONFIG_CAPACITY);
+    return true;
+}
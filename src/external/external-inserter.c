@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include "header/ext2.h"
 #include "header/disk.h"
+#include "header/ramdisk.h"
 #include "header/stdlib/string.h"
 
 // Global variable
@@ -11,27 +12,9 @@ uint8_t *image_storage;
 uint8_t *file_buffer;
 uint8_t *read_buffer;
 
-void read_blocks(void *ptr, uint32_t logical_block_address, uint8_t block_count)
-{
-    for (int i = 0; i < block_count; i++)
-    {
-        memcpy(
-            (uint8_t *)ptr + BLOCK_SIZE * i,
-            image_storage + BLOCK_SIZE * (logical_block_address + i),
-            BLOCK_SIZE);
-    }
-}
-
-void write_blocks(const void *ptr, uint32_t logical_block_address, uint8_t block_count)
-{
-    for (int i = 0; i < block_count; i++)
-    {
-        memcpy(
-            image_storage + BLOCK_SIZE * (logical_block_address + i),
-            (uint8_t *)ptr + BLOCK_SIZE * i,
-            BLOCK_SIZE);
-    }
-}
+// Storage image is mounted as RAM disk, same ext2 driver as kernel
+struct BlockDevice image_device;
+struct EXT2FileTable image_files;
 
 int main(int argc, char *argv[])
 {
@@ -69,7 +52,12 @@ int main(int argc, char *argv[])
     printf("Filesize : %ld bytes\n", filesize);
 
     // EXT2 operations
-    initialize_filesystem_ext2();
+    ramdisk_init(&image_device, "image", image_storage, 4 * 1024 * 1024);
+    if (initialize_filesystem_ext2(&image_device) != 0)
+    {
+        fprintf(stderr, "Error: Storage image '%s' does not hold a filesystem of this OS. Run 'make disk' to recreate it.\n", argv[3]);
+        exit(1);
+    }
     char *name = argv[1];
     struct EXT2DriverRequest request;
     struct EXT2DriverRequest reqread;
@@ -110,13 +98,26 @@ int main(int argc, char *argv[])
         }
     }
 
-    bool is_replace = true;
-    retcode = write(&request);
-    if (retcode == 1 && is_replace)
+    // Existing file is overwritten in place, only a file that shrinks is truncated first
+    int32_t fd = file_open(&image_files, &request, EXT2_O_RDWR | EXT2_O_CREAT);
+    if (fd >= 0 && file_lseek(&image_files, fd, 0, EXT2_SEEK_END) > 0)
+    {
+        printf("File exists. Overwriting...\n");
+        if ((uint32_t)file_lseek(&image_files, fd, 0, EXT2_SEEK_END) > filesize)
+        {
+            file_close(&image_files, fd);
+            fd = file_open(&image_files, &request, EXT2_O_RDWR | EXT2_O_TRUNC);
+        }
+    }
+    if (fd >= 0)
     {
-        printf("File exists. Deleting and overwriting...\n");
-        retcode = delete(&request);
-        retcode = write(&request);
+        int32_t written = filesize > 0 ? file_pwrite(&image_files, fd, file_buffer, filesize, 0) : 0;
+        file_close(&image_files, fd);
+        retcode = written == (int32_t)filesize ? 0 : -1;
+    }
+    else
+    {
+        retcode = fd == -3 ? 2 : (fd == -2 ? 1 : -1);
     }
 
     if (retcode == 0)
@@ -128,6 +129,9 @@ int main(int argc, char *argv[])
     else
         puts("Error: Unknown error");
 
+    // Commit last journal transaction before image is written back
+    journal_commit(true);
+
     rewind(fptr);
     fwrite(image_storage, 4 * 1024 * 1024, 1, fptr);
     fclose(fptr);
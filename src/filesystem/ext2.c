@@ -3,10 +3,38 @@
 #include "header/stdlib/string.h"
 #include "header/ext2.h"
 #include "header/disk.h"
+#include "header/blockdev.h"
+#include "header/bcache.h"
 
+static struct BlockDevice *ext2_device;
+static struct BufferCache ext2_cache;
 static struct EXT2Superblock EXT2SB;
 static struct EXT2BlockGroupDescriptorTable EXT2_BGDT;
 
+/**
+ * EXT2Geometry, ukuran yang diturunkan dari s_log_block_size, diisi saat mount / create_ext2()
+ *
+ * @param block_size         Byte per block filesystem, 1024 << s_log_block_size
+ * @param blocks_per_group   Block per group, disk dibagi rata ke GROUPS_COUNT group
+ * @param inodes_per_block   Inode per block inode table, inode tidak melewati batas block
+ * @param inode_table_blocks Block inode table per group, EXT2_INODE_TABLE_SIZE byte
+ * @param inodes_per_group   inodes_per_block * inode_table_blocks
+ * @param pointers_per_block Block pointer dalam satu block indirect
+ * @param superblock_block   Block yang memuat byte EXT2_SUPERBLOCK_OFFSET, BGDT di block berikutnya
+ */
+struct EXT2Geometry
+{
+    uint32_t block_size;
+    uint32_t blocks_per_group;
+    uint32_t inodes_per_block;
+    uint32_t inode_table_blocks;
+    uint32_t inodes_per_group;
+    uint32_t pointers_per_block;
+    uint32_t superblock_block;
+};
+
+static struct EXT2Geometry ext2_geo;
+
 const uint8_t fs_signature[BLOCK_SIZE] = {
     'C',
     'o',
@@ -93,19 +121,54 @@ const uint8_t fs_signature[BLOCK_SIZE] = {
 };
 
 /* =================== HELPER FUNCTIONS ============================*/
+static void load_bitmaps(void);
+static void flush_bitmaps(void);
+static void sync_inodes(void);
+static void dcache_init(void);
+static void bitmap_set(uint32_t *bitmap, uint32_t bit, bool used);
+static void prealloc_discard(struct EXT2MemInode *node);
+static void journal_init(void);
+static void journal_create(void);
+static void journal_load(void);
+static void journal_dirty(struct BufferHead *buffer);
+static void journal_write(const void *ptr, uint32_t block);
+static void journal_revoke(uint32_t block);
+static void journal_commit_transaction(void);
+
+static void set_geometry(uint32_t log_block_size)
+{
+    ext2_geo.block_size = EXT2_MIN_BLOCK_SIZE << log_block_size;
+    ext2_geo.blocks_per_group = DISK_SPACE / ext2_geo.block_size / GROUPS_COUNT;
+    ext2_geo.inodes_per_block = ext2_geo.block_size / INODE_SIZE;
+    ext2_geo.inode_table_blocks = EXT2_INODE_TABLE_SIZE / ext2_geo.block_size;
+    ext2_geo.inodes_per_group = ext2_geo.inodes_per_block * ext2_geo.inode_table_blocks;
+    ext2_geo.pointers_per_block = EXT2_POINTERS_PER_BLOCK(ext2_geo.block_size);
+    ext2_geo.superblock_block = EXT2_SUPERBLOCK_OFFSET / ext2_geo.block_size;
+}
+
+// Block di awal group sampai akhir inode table (boot, SB & BGDT di group 0, bitmap, inode table), bit terpakai block bitmap group uninit
+static uint32_t group_metadata_blocks(uint32_t group)
+{
+    return EXT2_BGDT.table[group].bg_inode_table + ext2_geo.inode_table_blocks - group * ext2_geo.blocks_per_group;
+}
+
 void commit_metadata(void)
 {
-    struct BlockBuffer buffer;
+    // Bitmap & inode yang berubah ikut ditulis ke cache bersama SB & BGDT
+    flush_bitmaps();
+    sync_inodes();
 
-    // Update superblock
-    memset(&buffer, 0, sizeof(buffer));
-    memcpy(buffer.buf, &EXT2SB, sizeof(EXT2SB));
-    write_blocks(&buffer, 1, 1);
+    // Update superblock, dengan block 2 / 4 KiB superblock berbagi block 0 dengan boot sector
+    struct BufferHead *sb_buff = bcache_get(&ext2_cache, ext2_geo.superblock_block);
+    memcpy(sb_buff->data + EXT2_SUPERBLOCK_OFFSET % ext2_geo.block_size, &EXT2SB, sizeof(EXT2SB));
+    journal_dirty(sb_buff);
+    bcache_release(&ext2_cache, sb_buff);
 
     // Update BGDT
-    memset(&buffer, 0, sizeof(buffer));
-    memcpy(buffer.buf, &EXT2_BGDT, sizeof(EXT2_BGDT));
-    write_blocks(&buffer, 2, 1);
+    struct BufferHead *bgdt_buff = bcache_get_new(&ext2_cache, ext2_geo.superblock_block + 1);
+    memcpy(bgdt_buff->data, &EXT2_BGDT, sizeof(EXT2_BGDT));
+    journal_dirty(bgdt_buff);
+    bcache_release(&ext2_cache, bgdt_buff);
 }
 
 char *get_entry_name(void *entry)
@@ -113,6 +176,11 @@ char *get_entry_name(void *entry)
     return (char *)((struct EXT2DirectoryEntry *)entry + 1);
 }
 
+char *get_dirent_name(struct EXT2Dirent *dirent)
+{
+    return (char *)(dirent + 1);
+}
+
 struct EXT2DirectoryEntry *get_directory_entry(void *ptr, uint32_t offset)
 {
     return (struct EXT2DirectoryEntry *)((uint8_t *)ptr + offset);
@@ -155,50 +223,239 @@ uint32_t get_dir_first_child_offset(void *ptr)
 
 uint32_t inode_to_bgd(uint32_t inode)
 {
-    return (inode - 1) / INODES_PER_GROUP;
+    return (inode - 1) / ext2_geo.inodes_per_group;
 }
 
 uint32_t inode_to_local(uint32_t inode)
 {
-    return ((inode - 1) % INODES_PER_GROUP);
+    return ((inode - 1) % ext2_geo.inodes_per_group);
+}
+
+/**
+ * Jalur pointer block ke-index file: offsets[0] index i_block, offsets[1..depth] index di tiap block pointer
+ *
+ * @return depth 0 (direct), 1 (single indirect), 2 (doubly indirect), -1 jika index di luar jangkauan
+ */
+static int8_t file_block_path(uint32_t index, uint32_t *offsets)
+{
+    if (index < EXT2_NDIR_BLOCKS)
+    {
+        offsets[0] = index;
+        return 0;
+    }
+
+    index -= EXT2_NDIR_BLOCKS;
+    if (index < ext2_geo.pointers_per_block)
+    {
+        offsets[0] = EXT2_IND_BLOCK;
+        offsets[1] = index;
+        return 1;
+    }
+
+    index -= ext2_geo.pointers_per_block;
+    if (index < ext2_geo.pointers_per_block * ext2_geo.pointers_per_block)
+    {
+        offsets[0] = EXT2_DIND_BLOCK;
+        offsets[1] = index / ext2_geo.pointers_per_block;
+        offsets[2] = index % ext2_geo.pointers_per_block;
+        return 2;
+    }
+    return -1;
+}
+
+uint32_t get_file_block(struct EXT2MemInode *node, uint32_t index)
+{
+    uint32_t offsets[3];
+    int8_t depth = file_block_path(index, offsets);
+    if (depth < 0 || (node->i_flags & EXT2_INLINE_DATA_FL))
+        return 0;
+
+    uint32_t block = node->i_block[offsets[0]];
+    for (int8_t level = 1; level <= depth && block != 0; level++)
+    {
+        struct BufferHead *pointer_buff = bcache_get(&ext2_cache, block);
+        block = ((uint32_t *)pointer_buff->data)[offsets[level]];
+        bcache_release(&ext2_cache, pointer_buff);
+    }
+    return block;
+}
+
+/* =================== INODE CACHE ============================*/
+
+#define EXT2_ICACHE_SIZE    64 // Jumlah inode yang disimpan di memori
+#define EXT2_ICACHE_BUCKETS 32 // Power of two
+
+/**
+ * EXT2InodeCache, inode yang sedang / baru dipakai dalam bentuk EXT2MemInode
+ *
+ * @param nodes  Pool inode, slot dengan inode 0 kosong
+ * @param hash   Head bucket, index inode & (EXT2_ICACHE_BUCKETS - 1)
+ * @param clock  Bertambah tiap iget(), slot unpinned dengan last_used terkecil diganti
+ * @param hits   iget() yang dilayani dari cache
+ * @param misses iget() yang membaca inode table
+ */
+struct EXT2InodeCache
+{
+    struct EXT2MemInode nodes[EXT2_ICACHE_SIZE];
+    struct EXT2MemInode *hash[EXT2_ICACHE_BUCKETS];
+    uint32_t clock;
+    uint32_t hits;
+    uint32_t misses;
+};
+
+static struct EXT2InodeCache ext2_icache;
+
+static void icache_init(void)
+{
+    memset(&ext2_icache, 0, sizeof(ext2_icache));
+}
+
+static uint32_t inode_table_block(uint32_t inode)
+{
+    return EXT2_BGDT.table[inode_to_bgd(inode)].bg_inode_table + inode_to_local(inode) / ext2_geo.inodes_per_block;
+}
+
+// Inode di disk packed, field disalin satu per satu ke bentuk aligned
+static void inode_load(struct EXT2MemInode *node, struct BufferHead *table_buff)
+{
+    struct EXT2Inode *inode_table = (struct EXT2Inode *)table_buff->data;
+    struct EXT2Inode *disk_node = &inode_table[inode_to_local(node->inode) % ext2_geo.inodes_per_block];
+    node->i_mode = disk_node->i_mode;
+    node->i_size = disk_node->i_size;
+    node->i_blocks = disk_node->i_blocks;
+    node->i_flags = disk_node->i_flags;
+    memcpy(node->i_block, (uint8_t *)disk_node + offsetof(struct EXT2Inode, i_block), sizeof(node->i_block));
+}
+
+static void inode_store(struct EXT2MemInode *node, struct BufferHead *table_buff)
+{
+    struct EXT2Inode *inode_table = (struct EXT2Inode *)table_buff->data;
+    struct EXT2Inode *disk_node = &inode_table[inode_to_local(node->inode) % ext2_geo.inodes_per_block];
+    disk_node->i_mode = node->i_mode;
+    disk_node->i_size = node->i_size;
+    disk_node->i_blocks = node->i_blocks;
+    disk_node->i_flags = node->i_flags;
+    memcpy((uint8_t *)disk_node + offsetof(struct EXT2Inode, i_block), node->i_block, sizeof(node->i_block));
+    node->dirty = false;
+}
+
+// Semua inode dirty yang berada di sektor inode table yang sama ditulis dengan satu pin buffer
+static void icache_writeback(uint32_t block)
+{
+    struct BufferHead *table_buff = bcache_get(&ext2_cache, block);
+    for (uint32_t i = 0; i < EXT2_ICACHE_SIZE; i++)
+    {
+        struct EXT2MemInode *node = &ext2_icache.nodes[i];
+        if (node->inode != 0 && node->dirty && inode_table_block(node->inode) == block)
+            inode_store(node, table_buff);
+    }
+    journal_dirty(table_buff);
+    bcache_release(&ext2_cache, table_buff);
 }
 
-/* =================== INODE OPERATIONS ============================*/
+static void sync_inodes(void)
+{
+    for (uint32_t i = 0; i < EXT2_ICACHE_SIZE; i++)
+    {
+        struct EXT2MemInode *node = &ext2_icache.nodes[i];
+        if (node->inode != 0 && node->dirty)
+            icache_writeback(inode_table_block(node->inode));
+    }
+}
 
-void read_inode(uint32_t inode, struct EXT2Inode *buffer)
+static struct EXT2MemInode **icache_bucket(uint32_t inode)
 {
-    uint32_t bgd_index = inode_to_bgd(inode);
-    uint32_t local_index = inode_to_local(inode);
+    return &ext2_icache.hash[inode & (EXT2_ICACHE_BUCKETS - 1)];
+}
 
-    struct BlockBuffer inode_buff;
-    uint32_t block_num = EXT2_BGDT.table[bgd_index].bg_inode_table + (local_index / INODES_PER_TABLE);
-    read_blocks(&inode_buff, block_num, 1);
+static void icache_unhash(struct EXT2MemInode *node)
+{
+    struct EXT2MemInode **link = icache_bucket(node->inode);
+    while (*link != node)
+        link = &(*link)->hash_next;
+    *link = node->hash_next;
+    node->hash_next = (struct EXT2MemInode *)0;
+    node->inode = 0;
+}
 
-    struct EXT2Inode *inode_table = (struct EXT2Inode *)inode_buff.buf;
-    memcpy(buffer, &inode_table[local_index % INODES_PER_TABLE], sizeof(struct EXT2Inode));
+// Inode yang sudah ada di cache tanpa membaca inode table, NULL jika tidak ada
+static struct EXT2MemInode *icache_lookup(uint32_t inode)
+{
+    for (struct EXT2MemInode *node = *icache_bucket(inode); node != (struct EXT2MemInode *)0; node = node->hash_next)
+    {
+        if (node->inode == inode)
+            return node;
+    }
+    return (struct EXT2MemInode *)0;
 }
 
-void write_inode(uint32_t inode, struct EXT2Inode *buffer)
+struct EXT2MemInode *iget(uint32_t inode)
 {
-    uint32_t bgd_index = inode_to_bgd(inode);
-    uint32_t local_index = inode_to_local(inode);
+    if (inode == 0 || inode_to_bgd(inode) >= GROUPS_COUNT || EXT2_BGDT.table[inode_to_bgd(inode)].bg_inode_table == 0)
+        return (struct EXT2MemInode *)0;
+
+    ext2_icache.clock++;
+    struct EXT2MemInode *cached = icache_lookup(inode);
+    if (cached != (struct EXT2MemInode *)0)
+    {
+        ext2_icache.hits++;
+        cached->refcount++;
+        cached->last_used = ext2_icache.clock;
+        return cached;
+    }
+
+    // Miss: pakai slot unpinned yang paling lama tidak dipakai, slot kosong punya last_used 0
+    struct EXT2MemInode *victim = (struct EXT2MemInode *)0;
+    for (uint32_t i = 0; i < EXT2_ICACHE_SIZE; i++)
+    {
+        struct EXT2MemInode *node = &ext2_icache.nodes[i];
+        if (node->refcount == 0 && (victim == (struct EXT2MemInode *)0 || node->last_used < victim->last_used))
+            victim = node;
+    }
+    if (victim == (struct EXT2MemInode *)0)
+        return (struct EXT2MemInode *)0; // Semua inode di-pin
 
-    struct BlockBuffer inode_buff;
-    uint32_t block_num = EXT2_BGDT.table[bgd_index].bg_inode_table + (local_index / INODES_PER_TABLE);
-    read_blocks(&inode_buff, block_num, 1);
+    if (victim->inode != 0)
+    {
+        prealloc_discard(victim);
+        if (victim->dirty)
+            icache_writeback(inode_table_block(victim->inode));
+        icache_unhash(victim);
+    }
+
+    ext2_icache.misses++;
+    victim->inode = inode;
+    victim->refcount = 1;
+    victim->dirty = false;
+    victim->unlinked = false;
+    victim->last_used = ext2_icache.clock;
+    struct BufferHead *table_buff = bcache_get(&ext2_cache, inode_table_block(inode));
+    inode_load(victim, table_buff);
+    bcache_release(&ext2_cache, table_buff);
+
+    struct EXT2MemInode **bucket = icache_bucket(inode);
+    victim->hash_next = *bucket;
+    *bucket = victim;
+    return victim;
+}
 
-    struct EXT2Inode *inode_table = (struct EXT2Inode *)inode_buff.buf;
-    memcpy(&inode_table[local_index % INODES_PER_TABLE], buffer, sizeof(struct EXT2Inode));
+void iput(struct EXT2MemInode *node)
+{
+    if (node != (struct EXT2MemInode *)0)
+        node->refcount--;
+}
 
-    write_blocks(&inode_buff, block_num, 1);
+void inode_mark_dirty(struct EXT2MemInode *node)
+{
+    node->dirty = true;
 }
 
 /* =================== DIRECTORY INITIALIZATION ============================*/
 
-void init_directory_table(struct EXT2Inode *node, uint32_t inode, uint32_t parent_inode)
+void init_directory_table(struct EXT2MemInode *node, uint32_t inode, uint32_t parent_inode)
 {
-    struct BlockBuffer bb;
-    memset(&bb, 0, sizeof(bb));
+    uint8_t bb[EXT2_MAX_BLOCK_SIZE];
+    memset(bb, 0, ext2_geo.block_size);
 
     // Entry 1: "."
     struct EXT2DirectoryEntry self = {
@@ -206,437 +463,2419 @@ void init_directory_table(struct EXT2Inode *node, uint32_t inode, uint32_t paren
         .rec_len = get_entry_record_len(1),
         .name_len = 1,
         .file_type = EXT2_FT_DIR};
-    memcpy(bb.buf, &self, sizeof(self));
-    memcpy(bb.buf + sizeof(self), ".", 1);
+    memcpy(bb, &self, sizeof(self));
+    memcpy(bb + sizeof(self), ".", 1);
 
     // Entry 2: ".."
     uint32_t offset = self.rec_len;
     struct EXT2DirectoryEntry parent = {
         .inode = parent_inode,
-        .rec_len = BLOCK_SIZE - self.rec_len,
+        .rec_len = ext2_geo.block_size - self.rec_len,
         .name_len = 2,
         .file_type = EXT2_FT_DIR};
-    memcpy(bb.buf + offset, &parent, sizeof(parent));
-    memcpy(bb.buf + offset + sizeof(parent), "..", 2);
+    memcpy(bb + offset, &parent, sizeof(parent));
+    memcpy(bb + offset + sizeof(parent), "..", 2);
 
-    write_blocks(&bb, node->i_block[0], 1);
-    node->i_blocks = 1;
-    node->i_size = BLOCK_SIZE;
+    journal_write(bb, node->i_block[0]);
+    node->i_blocks = ext2_geo.block_size / 512;
+    node->i_size = ext2_geo.block_size;
 }
 
 /* =================== FILESYSTEM INITIALIZATION ============================*/
 
 bool is_empty_storage(void)
 {
+    // Boot sector selalu satu sektor disk, dibaca langsung tanpa buffer cache. Gagal dibaca bukan berarti kosong
     struct BlockBuffer bootSectorBuff;
-    read_blocks(&bootSectorBuff, BOOT_SECTOR, 1);
+    if (blockdev_read(ext2_device, &bootSectorBuff, BOOT_SECTOR, 1) != 0)
+        return false;
     return memcmp(bootSectorBuff.buf, fs_signature, BLOCK_SIZE) != 0;
 }
 
-void create_ext2(void)
+// Superblock dari versi lama (tanpa s_log_block_size) atau disk lain tidak valid, geometry diisi jika valid
+static bool is_valid_superblock(void)
+{
+    if (EXT2SB.s_magic != EXT2_SUPER_MAGIC || EXT2SB.s_log_block_size > EXT2_MAX_LOG_BLOCK_SIZE)
+        return false;
+
+    set_geometry(EXT2SB.s_log_block_size);
+    return EXT2SB.s_first_data_block == ext2_geo.superblock_block &&
+           EXT2SB.s_blocks_per_group == ext2_geo.blocks_per_group &&
+           EXT2SB.s_inodes_per_group == ext2_geo.inodes_per_group;
+}
+
+void create_ext2(uint32_t log_block_size)
 {
-    struct BlockBuffer buffer;
+    if (log_block_size > EXT2_MAX_LOG_BLOCK_SIZE)
+        log_block_size = EXT2_MAX_LOG_BLOCK_SIZE;
+    set_geometry(log_block_size);
+    bcache_init(&ext2_cache, ext2_device, ext2_geo.block_size, BCACHE_DEFAULT_BUFFERS);
+    icache_init();
+    dcache_init();
+    journal_init(); // Metadata format ditulis langsung, journal dibuat di akhir
+
+    uint8_t buffer[EXT2_MAX_BLOCK_SIZE];
+
+    // Semua metadata di-batch, block bersebelahan digabung jadi satu command
+    blockdev_plug(ext2_device);
+
+    // 1. Write filesystem signature to boot sector, sektor pertama block 0
+    memset(buffer, 0, ext2_geo.block_size);
+    memcpy(buffer, fs_signature, BLOCK_SIZE);
+    bcache_write(&ext2_cache, buffer, BOOT_SECTOR);
+
+    // 2. Initialize Block Group Descriptor Table
+    // Group 0 diawali boot sector, superblock & BGDT (superblock di block 0 untuk block 2 / 4 KiB), group lain langsung diawali block bitmap
+    // Journal menempati block setelah root directory di group 0
+    // Hanya group 0 yang ditulis, group lain ditandai uninit sehingga waktu format tidak bergantung ukuran disk.
+    // Bitmap group uninit dihitung di memori (load_bitmaps()), inode table dikosongkan saat inode pertama dialokasikan
+    // atau oleh inode_table_lazy_init(). Data block tidak dikosongkan, setiap block baru selalu diisi penuh sebelum dipakai
+    memset(&EXT2_BGDT, 0, sizeof(EXT2_BGDT));
+    uint32_t group0_metadata = ext2_geo.superblock_block + 2;
+    uint32_t root_dir_block = group0_metadata + 2 + ext2_geo.inode_table_blocks;
+    uint32_t journal_blocks = EXT2_JOURNAL_SIZE / ext2_geo.block_size;
+    for (uint32_t group = 0; group < GROUPS_COUNT; group++)
+    {
+        struct EXT2BlockGroupDescriptor *bgd = &EXT2_BGDT.table[group];
+        uint32_t group_start = group * ext2_geo.blocks_per_group;
+        uint32_t metadata_start = group == 0 ? group0_metadata : group_start;
+        bgd->bg_block_bitmap = metadata_start;
+        bgd->bg_inode_bitmap = metadata_start + 1;
+        bgd->bg_inode_table = metadata_start + 2;
+
+        // Block bitmap: metadata group (dan root directory & journal di group 0) terpakai
+        // Inode bitmap: inode 1 reserved, inode 2 root, direktori dengan inode < 2 tidak bisa dibaca
+        uint32_t used_blocks = group_metadata_blocks(group) + (group == 0 ? 1 + journal_blocks : 0);
+        uint32_t used_inodes = group == 0 ? 2 : 0;
+        bgd->bg_free_blocks_count = ext2_geo.blocks_per_group - used_blocks;
+        bgd->bg_free_inodes_count = ext2_geo.inodes_per_group - used_inodes;
+        bgd->bg_used_dirs_count = group == 0 ? 1 : 0; // Root directory
+        if (group != 0)
+        {
+            bgd->bg_flags = EXT2_BG_INODE_UNINIT | EXT2_BG_BLOCK_UNINIT;
+            continue;
+        }
 
-    // 1. Write filesystem signature to boot sector
-    memset(&buffer, 0, sizeof(buffer));
-    memcpy(buffer.buf, fs_signature, BLOCK_SIZE);
-    write_blocks(&buffer, BOOT_SECTOR, 1);
+        // 3. Bitmap group 0
+        memset(buffer, 0, ext2_geo.block_size);
+        for (uint32_t bit = 0; bit < used_blocks; bit++)
+            bitmap_set((uint32_t *)buffer, bit, true);
+        bcache_write(&ext2_cache, buffer, bgd->bg_block_bitmap);
+
+        memset(buffer, 0, ext2_geo.block_size);
+        for (uint32_t bit = 0; bit < used_inodes; bit++)
+            bitmap_set((uint32_t *)buffer, bit, true);
+        bcache_write(&ext2_cache, buffer, bgd->bg_inode_bitmap);
+
+        // 4. Inode table group 0 berisi root, dikosongkan sekarang
+        memset(buffer, 0, ext2_geo.block_size);
+        for (uint32_t i = 0; i < ext2_geo.inode_table_blocks; i++)
+            bcache_write(&ext2_cache, buffer, bgd->bg_inode_table + i);
+        bgd->bg_flags = EXT2_BG_INODE_ZEROED;
+    }
 
-    // 2. Initialize Superblock
+    // 5. Initialize Superblock, free count adalah jumlah semua group
     memset(&EXT2SB, 0, sizeof(EXT2SB));
-    EXT2SB.s_inodes_count = INODES_PER_GROUP * GROUPS_COUNT;
-    EXT2SB.s_blocks_count = BLOCKS_PER_GROUP * GROUPS_COUNT;
+    EXT2SB.s_inodes_count = ext2_geo.inodes_per_group * GROUPS_COUNT;
+    EXT2SB.s_blocks_count = ext2_geo.blocks_per_group * GROUPS_COUNT;
     EXT2SB.s_r_blocks_count = 0;
-    EXT2SB.s_free_blocks_count = BLOCKS_PER_GROUP - (5 + INODES_TABLE_BLOCK_COUNT + 1);
-    EXT2SB.s_free_inodes_count = INODES_PER_GROUP - 1; // Root menggunakan 1 inode
-    EXT2SB.s_first_data_block = 1;
+    for (uint32_t group = 0; group < GROUPS_COUNT; group++)
+    {
+        EXT2SB.s_free_blocks_count += EXT2_BGDT.table[group].bg_free_blocks_count;
+        EXT2SB.s_free_inodes_count += EXT2_BGDT.table[group].bg_free_inodes_count;
+    }
+    EXT2SB.s_first_data_block = ext2_geo.superblock_block; // 1 untuk block 1 KiB, 0 untuk block lebih besar
+    EXT2SB.s_log_block_size = log_block_size;
     EXT2SB.s_first_ino = 2; // Inode pertama yang tersedia adalah 2 (root)
-    EXT2SB.s_blocks_per_group = BLOCKS_PER_GROUP;
-    EXT2SB.s_frags_per_group = BLOCKS_PER_GROUP;
-    EXT2SB.s_inodes_per_group = INODES_PER_GROUP;
+    EXT2SB.s_blocks_per_group = ext2_geo.blocks_per_group;
+    EXT2SB.s_frags_per_group = ext2_geo.blocks_per_group;
+    EXT2SB.s_inodes_per_group = ext2_geo.inodes_per_group;
     EXT2SB.s_magic = EXT2_SUPER_MAGIC;
     EXT2SB.s_prealloc_blocks = 16;
     EXT2SB.s_prealloc_dir_blocks = 16;
+    EXT2SB.s_journal_block = root_dir_block + 1;
+    EXT2SB.s_journal_blocks = journal_blocks;
+
+    // 6. Root directory adalah inode 2, masuk ke inode table saat commit_metadata()
+    // Superblock & BGDT juga ditulis oleh commit_metadata()
+    struct EXT2MemInode *root_node = iget(2);
+    root_node->i_mode = EXT2_S_IFDIR | 0755;
+    root_node->i_block[0] = root_dir_block;
+    init_directory_table(root_node, 2, 2);
+    inode_mark_dirty(root_node);
+    iput(root_node);
 
-    // Write superblock to block 1
-    memset(&buffer, 0, sizeof(buffer));
-    memcpy(buffer.buf, &EXT2SB, sizeof(EXT2SB));
-    write_blocks(&buffer, 1, 1);
-
-    // 3. Initialize Block Group Descriptor Table
-    memset(&EXT2_BGDT, 0, sizeof(EXT2_BGDT));
-    EXT2_BGDT.table[0].bg_block_bitmap = 3;
-    EXT2_BGDT.table[0].bg_inode_bitmap = 4;
-    EXT2_BGDT.table[0].bg_inode_table = 5;
-    EXT2_BGDT.table[0].bg_free_blocks_count = BLOCKS_PER_GROUP - (5 + INODES_TABLE_BLOCK_COUNT + 1);
-    EXT2_BGDT.table[0].bg_free_inodes_count = INODES_PER_GROUP - 1;
-    EXT2_BGDT.table[0].bg_used_dirs_count = 1; // Root directory
+    // 7. Pastikan metadata terakhir ditulis ulang, bitmap di memori dibaca ulang dengan geometry baru. Journal tetap dikosongkan
+    // seluruhnya (ukurannya tetap), isi lama tidak boleh terbaca sebagai transaksi saat recovery
+    commit_metadata();
+    bcache_sync(&ext2_cache);
+    journal_create();
+    blockdev_unplug(ext2_device);
+    load_bitmaps();
+}
 
-    // Write BGDT to block 2
-    memset(&buffer, 0, sizeof(buffer));
-    memcpy(buffer.buf, &EXT2_BGDT, sizeof(EXT2_BGDT));
-    write_blocks(&buffer, 2, 1);
+int8_t initialize_filesystem_ext2(struct BlockDevice *device)
+{
+    ext2_device = device;
+    icache_init();
+    dcache_init();
+    journal_init();
+
+    // Read superblock (byte 1024) langsung dari disk, block size baru diketahui dari isinya
+    struct BlockBuffer sb_sectors[2];
+    if (blockdev_read(device, sb_sectors, EXT2_SUPERBLOCK_OFFSET / BLOCK_SIZE, 2) != 0)
+        return -1;
+    memcpy(&EXT2SB, sb_sectors, sizeof(EXT2SB));
 
-    // 4. Initialize Block Bitmap (block 3)
-    memset(&buffer, 0, sizeof(buffer));
-    // Mark blocks 0-21 as used (boot, superblock, BGDT, bitmaps, inode table)
-    buffer.buf[0] = 0xFF; // blocks 0-7
-    buffer.buf[1] = 0xFF; // blocks 8-15
-    buffer.buf[2] = 0x7F; // blocks 16-22 (01111111)
-    write_blocks(&buffer, 3, 1);
+    if (is_empty_storage())
+    {
+        create_ext2(EXT2_DEFAULT_LOG_BLOCK_SIZE);
+    }
+    else if (!is_valid_superblock())
+    {
+        // Disk berisi data lain (superblock rusak, geometry lain, format lama), tidak pernah diformat tanpa diminta
+        return -1;
+    }
+    else
+    {
+        bcache_init(&ext2_cache, device, ext2_geo.block_size, BCACHE_DEFAULT_BUFFERS);
+
+        // Replay journal sebelum metadata dibaca, superblock dibaca ulang karena bisa ikut di-replay
+        journal_load();
+        struct BufferHead *sb_buff = bcache_get(&ext2_cache, ext2_geo.superblock_block);
+        memcpy(&EXT2SB, sb_buff->data + EXT2_SUPERBLOCK_OFFSET % ext2_geo.block_size, sizeof(EXT2SB));
+        bcache_release(&ext2_cache, sb_buff);
+
+        // Read BGDT (block setelah superblock)
+        struct BufferHead *bgdt_buff = bcache_get(&ext2_cache, ext2_geo.superblock_block + 1);
+        memcpy(&EXT2_BGDT, bgdt_buff->data, sizeof(EXT2_BGDT));
+        bcache_release(&ext2_cache, bgdt_buff);
+        load_bitmaps();
+    }
+    return 0;
+}
 
-    // 5. Initialize Inode Bitmap (block 4)
-    memset(&buffer, 0, sizeof(buffer));
-    buffer.buf[0] = 0x02; // Inode 2 terpakai (00000010)
-    write_blocks(&buffer, 4, 1);
+/* =================== DIRECTORY UTILITIES ============================*/
 
-    // 6. Initialize Inode Table (starting from block 5)
-    memset(&buffer, 0, sizeof(buffer));
+static bool is_dot_name(const char *name, uint8_t name_len)
+{
+    return (name_len == 1 && name[0] == '.') || (name_len == 2 && name[0] == '.' && name[1] == '.');
+}
 
-    struct EXT2Inode *inode_table = (struct EXT2Inode *)buffer.buf;
+static bool is_dot_entry(struct EXT2DirectoryEntry *entry)
+{
+    return is_dot_name(get_entry_name(entry), entry->name_len);
+}
 
-    // Root directory adalah inode 2 (index 1 dalam array)
-    inode_table[1].i_mode = EXT2_S_IFDIR | 0755;
-    inode_table[1].i_size = BLOCK_SIZE;
-    inode_table[1].i_blocks = BLOCK_SIZE / 512;
-    inode_table[1].i_block[0] = EXT2_BGDT.table[0].bg_inode_table + INODES_TABLE_BLOCK_COUNT;
+bool is_directory_empty(uint32_t inode)
+{
+    struct EXT2MemInode *node = iget(inode);
+    bool empty = true;
 
-    // Clear sisa i_block
-    for (int i = 1; i < 15; i++)
+    // Semua block direktori dicek, entry selain "." dan ".." berarti tidak kosong
+    uint32_t dir_blocks = node->i_size / ext2_geo.block_size;
+    for (uint32_t i = 0; i < dir_blocks && empty; i++)
     {
-        inode_table[1].i_block[i] = 0;
-    }
+        uint32_t block = get_file_block(node, i);
+        if (block == 0)
+            continue;
 
-    write_blocks(&buffer, EXT2_BGDT.table[0].bg_inode_table, 1);
-
-    // Clear remaining inode table blocks if any
-    if (INODES_TABLE_BLOCK_COUNT > 1)
-    {
-        memset(&buffer, 0, sizeof(buffer));
-        for (uint32_t i = 1; i < INODES_TABLE_BLOCK_COUNT; i++)
+        struct BufferHead *dbuff = bcache_get(&ext2_cache, block);
+        uint32_t offset = 0;
+        while (offset < ext2_geo.block_size)
         {
-            write_blocks(&buffer, EXT2_BGDT.table[0].bg_inode_table + i, 1);
+            struct EXT2DirectoryEntry *entry = get_directory_entry(dbuff->data, offset);
+            if (entry->rec_len == 0)
+                break;
+            if (entry->inode != 0 && !is_dot_entry(entry))
+            {
+                empty = false;
+                break;
+            }
+            offset += entry->rec_len;
         }
+        bcache_release(&ext2_cache, dbuff);
     }
 
-    // 7. Initialize root directory content
-    memset(&buffer, 0, sizeof(buffer));
-    read_blocks(&buffer, EXT2_BGDT.table[0].bg_inode_table, 1);
-
-    inode_table = (struct EXT2Inode *)buffer.buf;
-    struct EXT2Inode *root_node = &inode_table[1];
+    iput(node);
+    return empty;
+}
 
-    init_directory_table(root_node, 2, 2);
+/* =================== BITMAP OPERATIONS ============================*/
 
-    // Write back updated inode table
-    write_blocks(&buffer, EXT2_BGDT.table[0].bg_inode_table, 1);
+#define EXT2_BITMAP_WORDS (EXT2_MAX_BLOCKS_PER_GROUP / 32) // Bitmap group terbesar (block 1 KiB) dalam word 32 bit, inode bitmap lebih kecil
+#define EXT2_BITMAP_FULL  0xFFFFFFFFu                      // Hasil bitmap_find_free() jika tidak ada bit kosong
+
+/**
+ * EXT2GroupBitmap, salinan bitmap satu block group yang selalu ada di memori
+ *
+ * @param block_bitmap Bit n menandai block group * blocks_per_group + n terpakai
+ * @param inode_bitmap Bit n menandai inode group * inodes_per_group + n + 1 terpakai
+ * @param reserve_bitmap Bit n menandai block sedang dipesan window preallocation suatu inode, hanya ada di memori
+ * @param loaded       Group punya bitmap di disk dan sudah dibaca
+ * @param block_dirty  block_bitmap berubah sejak commit_metadata() terakhir
+ * @param inode_dirty  inode_bitmap berubah sejak commit_metadata() terakhir
+ */
+struct EXT2GroupBitmap
+{
+    uint32_t block_bitmap[EXT2_BITMAP_WORDS];
+    uint32_t inode_bitmap[EXT2_BITMAP_WORDS];
+    uint32_t reserve_bitmap[EXT2_BITMAP_WORDS];
+    bool loaded;
+    bool block_dirty;
+    bool inode_dirty;
+};
 
-    // 8. Clear data blocks agar tidak ada data sisa dari boot sebelumnya
-    memset(&buffer, 0, sizeof(buffer));
-    uint32_t first_data_block = EXT2_BGDT.table[0].bg_inode_table + INODES_TABLE_BLOCK_COUNT;
-    uint32_t last_block = BLOCKS_PER_GROUP; // batas maksimum block group
+static struct EXT2GroupBitmap ext2_bitmaps[GROUPS_COUNT];
 
-    for (uint32_t i = first_data_block; i < last_block; i++)
+// Index bit 0 pertama di antara bit start sampai bits - 1, dicari 32 bit sekaligus. Bit reserved (jika ada) ikut dilewati
+static uint32_t bitmap_find_free(const uint32_t *bitmap, const uint32_t *reserved, uint32_t start, uint32_t bits)
+{
+    for (uint32_t word = start / 32; word * 32 < bits; word++)
     {
-        write_blocks(&buffer, i, 1);
+        uint32_t used_mask = bitmap[word];
+        if (reserved != (const uint32_t *)0)
+            used_mask |= reserved[word];
+        if (word == start / 32)
+            used_mask |= (1u << (start % 32)) - 1; // Bit sebelum start
+        uint32_t free_mask = ~used_mask;
+        if (free_mask == 0)
+            continue;
+
+        uint32_t bit = word * 32 + __builtin_ctz(free_mask);
+        return bit < bits ? bit : EXT2_BITMAP_FULL; // Sisa word terakhir di luar group
     }
-
-    // 9. Pastikan metadata terakhir ditulis ulang
-    commit_metadata();
+    return EXT2_BITMAP_FULL;
 }
 
-void initialize_filesystem_ext2(void)
+static uint32_t bitmap_count_used(const uint32_t *bitmap, uint32_t bits)
 {
-    if (is_empty_storage())
+    uint32_t used = 0;
+    for (uint32_t word = 0; word * 32 < bits; word++)
     {
-        create_ext2();
+        uint32_t value = bitmap[word];
+        if (bits - word * 32 < 32)
+            value &= (1u << (bits - word * 32)) - 1;
+        // Popcount SWAR, kernel tidak di-link dengan libgcc
+        value = value - ((value >> 1) & 0x55555555u);
+        value = (value & 0x33333333u) + ((value >> 2) & 0x33333333u);
+        value = (value + (value >> 4)) & 0x0F0F0F0Fu;
+        used += (value * 0x01010101u) >> 24;
     }
-
-    // Read superblock (block 1)
-    struct BlockBuffer bb;
-    memset(&bb, 0, sizeof(bb));
-    read_blocks(&bb, 1, 1);
-    memcpy(&EXT2SB, bb.buf, sizeof(EXT2SB));
-
-    // Read BGDT (block 2)
-    memset(&bb, 0, sizeof(bb));
-    read_blocks(&bb, 2, 1);
-    memcpy(&EXT2_BGDT, bb.buf, sizeof(EXT2_BGDT));
+    return used;
 }
 
-/* =================== DIRECTORY UTILITIES ============================*/
-
-bool is_directory_empty(uint32_t inode)
+static bool bitmap_test(const uint32_t *bitmap, uint32_t bit)
 {
-    struct EXT2Inode node_data;
-    read_inode(inode, &node_data); // Gunakan fungsi read_inode Anda yang sudah benar!
-    struct EXT2Inode *node = &node_data;
+    return (bitmap[bit / 32] & (1u << (bit % 32))) != 0;
+}
 
-    // Read directory data block
-    struct BlockBuffer dbuff;
-    read_blocks(&dbuff, node->i_block[0], 1);
+static void bitmap_set(uint32_t *bitmap, uint32_t bit, bool used)
+{
+    if (used)
+        bitmap[bit / 32] |= 1u << (bit % 32);
+    else
+        bitmap[bit / 32] &= ~(1u << (bit % 32));
+}
 
-    // Skip "." dan ".." entries
-    struct EXT2DirectoryEntry *first_entry = (struct EXT2DirectoryEntry *)dbuff.buf;
-    uint32_t offset = first_entry->rec_len;
+// Jumlah bit kosong & tidak di-reserve berurutan mulai dari start, paling banyak max
+static uint32_t bitmap_free_run(const uint32_t *bitmap, const uint32_t *reserved, uint32_t start, uint32_t max, uint32_t bits)
+{
+    uint32_t length = 0;
+    while (length < max && start + length < bits && !bitmap_test(bitmap, start + length) && !bitmap_test(reserved, start + length))
+        length++;
+    return length;
+}
 
-    struct EXT2DirectoryEntry *second_entry = (struct EXT2DirectoryEntry *)(dbuff.buf + offset);
-    offset += second_entry->rec_len;
+// Bitmap di disk menempati awal block, sisa block setelah bit terakhir group dibiarkan 0
+static void bitmap_read(uint32_t *bitmap, uint32_t block, uint32_t bits)
+{
+    struct BufferHead *bitmap_buff = bcache_get(&ext2_cache, block);
+    memset(bitmap, 0, EXT2_BITMAP_WORDS * sizeof(uint32_t));
+    memcpy(bitmap, bitmap_buff->data, (bits + 7) / 8);
+    bcache_release(&ext2_cache, bitmap_buff);
+}
 
-    // Check if there's any entry after "." and ".."
-    struct EXT2DirectoryEntry *third_entry = (struct EXT2DirectoryEntry *)(dbuff.buf + offset);
+static void bitmap_write(const uint32_t *bitmap, uint32_t block, uint32_t bits)
+{
+    struct BufferHead *bitmap_buff = bcache_get_new(&ext2_cache, block);
+    memcpy(bitmap_buff->data, bitmap, (bits + 7) / 8);
+    journal_dirty(bitmap_buff);
+    bcache_release(&ext2_cache, bitmap_buff);
+}
 
-    return third_entry->inode == 0;
+// Baca bitmap semua group sekali saat mount, free count dihitung ulang dari bitmap. Bitmap group uninit tidak ada di disk
+static void load_bitmaps(void)
+{
+    EXT2SB.s_free_blocks_count = 0;
+    EXT2SB.s_free_inodes_count = 0;
+    for (uint32_t group = 0; group < GROUPS_COUNT; group++)
+    {
+        struct EXT2GroupBitmap *bitmap = &ext2_bitmaps[group];
+        struct EXT2BlockGroupDescriptor *bgd = &EXT2_BGDT.table[group];
+        bitmap->loaded = bgd->bg_block_bitmap != 0;
+        bitmap->block_dirty = false;
+        bitmap->inode_dirty = false;
+        memset(bitmap->reserve_bitmap, 0, sizeof(bitmap->reserve_bitmap));
+        if (!bitmap->loaded)
+            continue;
+
+        if (bgd->bg_flags & EXT2_BG_BLOCK_UNINIT)
+        {
+            memset(bitmap->block_bitmap, 0, sizeof(bitmap->block_bitmap));
+            for (uint32_t bit = 0; bit < group_metadata_blocks(group); bit++)
+                bitmap_set(bitmap->block_bitmap, bit, true);
+        }
+        else
+        {
+            bitmap_read(bitmap->block_bitmap, bgd->bg_block_bitmap, ext2_geo.blocks_per_group);
+        }
+        if (bgd->bg_flags & EXT2_BG_INODE_UNINIT)
+            memset(bitmap->inode_bitmap, 0, sizeof(bitmap->inode_bitmap));
+        else
+            bitmap_read(bitmap->inode_bitmap, bgd->bg_inode_bitmap, ext2_geo.inodes_per_group);
+        bgd->bg_free_blocks_count = ext2_geo.blocks_per_group - bitmap_count_used(bitmap->block_bitmap, ext2_geo.blocks_per_group);
+        bgd->bg_free_inodes_count = ext2_geo.inodes_per_group - bitmap_count_used(bitmap->inode_bitmap, ext2_geo.inodes_per_group);
+        EXT2SB.s_free_blocks_count += bgd->bg_free_blocks_count;
+        EXT2SB.s_free_inodes_count += bgd->bg_free_inodes_count;
+    }
 }
 
-/* =================== BITMAP OPERATIONS ============================*/
+// Tulis bitmap yang berubah ke buffer cache, ke disk lewat journal_commit()
+// Bitmap pertama group uninit ditulis utuh, flag uninit dilepas di BGDT yang ditulis pada transaksi yang sama
+static void flush_bitmaps(void)
+{
+    for (uint32_t group = 0; group < GROUPS_COUNT; group++)
+    {
+        struct EXT2GroupBitmap *bitmap = &ext2_bitmaps[group];
+        struct EXT2BlockGroupDescriptor *bgd = &EXT2_BGDT.table[group];
+        if (bitmap->block_dirty)
+        {
+            bitmap_write(bitmap->block_bitmap, bgd->bg_block_bitmap, ext2_geo.blocks_per_group);
+            bgd->bg_flags &= ~EXT2_BG_BLOCK_UNINIT;
+        }
+        if (bitmap->inode_dirty)
+        {
+            bitmap_write(bitmap->inode_bitmap, bgd->bg_inode_bitmap, ext2_geo.inodes_per_group);
+            bgd->bg_flags &= ~EXT2_BG_INODE_UNINIT;
+        }
+        bitmap->block_dirty = false;
+        bitmap->inode_dirty = false;
+    }
+}
 
 bool is_block_used(uint32_t block_number)
 {
-    struct BlockBuffer bitmap_buff;
-    read_blocks(&bitmap_buff, EXT2_BGDT.table[0].bg_block_bitmap, 1);
+    uint32_t group = block_number / ext2_geo.blocks_per_group;
+    if (group >= GROUPS_COUNT || !ext2_bitmaps[group].loaded)
+        return true; // Di luar group yang ada, anggap terpakai
 
-    uint32_t byte_index = block_number / 8;
-    uint32_t bit_index = block_number % 8;
-
-    return (bitmap_buff.buf[byte_index] & (1 << bit_index)) != 0;
+    return bitmap_test(ext2_bitmaps[group].block_bitmap, block_number % ext2_geo.blocks_per_group);
 }
 
 void set_block_used(uint32_t block_number, bool used)
 {
-    struct BlockBuffer bitmap_buff;
-    read_blocks(&bitmap_buff, EXT2_BGDT.table[0].bg_block_bitmap, 1);
+    if (is_block_used(block_number) == used)
+        return; // Free count hanya berubah jika bit benar-benar berubah
 
-    uint32_t byte_index = block_number / 8;
-    uint32_t bit_index = block_number % 8;
+    uint32_t group = block_number / ext2_geo.blocks_per_group;
+    if (group >= GROUPS_COUNT || !ext2_bitmaps[group].loaded)
+        return;
 
+    bitmap_set(ext2_bitmaps[group].block_bitmap, block_number % ext2_geo.blocks_per_group, used);
+    ext2_bitmaps[group].block_dirty = true;
     if (used)
     {
-        bitmap_buff.buf[byte_index] |= (1 << bit_index);
-        EXT2_BGDT.table[0].bg_free_blocks_count--;
+        EXT2_BGDT.table[group].bg_free_blocks_count--;
+        EXT2SB.s_free_blocks_count--;
     }
     else
     {
-        bitmap_buff.buf[byte_index] &= ~(1 << bit_index);
-        EXT2_BGDT.table[0].bg_free_blocks_count++;
+        EXT2_BGDT.table[group].bg_free_blocks_count++;
+        EXT2SB.s_free_blocks_count++;
     }
-
-    write_blocks(&bitmap_buff, EXT2_BGDT.table[0].bg_block_bitmap, 1);
 }
 
 bool is_inode_used(uint32_t inode)
 {
-    struct BlockBuffer bitmap_buff;
-    read_blocks(&bitmap_buff, EXT2_BGDT.table[0].bg_inode_bitmap, 1);
+    uint32_t group = inode_to_bgd(inode);
+    if (inode == 0 || group >= GROUPS_COUNT || !ext2_bitmaps[group].loaded)
+        return true;
 
-    uint32_t byte_index = (inode - 1) / 8;
-    uint32_t bit_index = (inode - 1) % 8;
-
-    return (bitmap_buff.buf[byte_index] & (1 << bit_index)) != 0;
+    return bitmap_test(ext2_bitmaps[group].inode_bitmap, inode_to_local(inode));
 }
 
 void set_inode_used(uint32_t inode, bool used)
 {
-    struct BlockBuffer bitmap_buff;
-    read_blocks(&bitmap_buff, EXT2_BGDT.table[0].bg_inode_bitmap, 1);
+    if (is_inode_used(inode) == used)
+        return;
 
-    uint32_t byte_index = (inode - 1) / 8;
-    uint32_t bit_index = (inode - 1) % 8;
+    uint32_t group = inode_to_bgd(inode);
+    if (inode == 0 || group >= GROUPS_COUNT || !ext2_bitmaps[group].loaded)
+        return;
 
+    bitmap_set(ext2_bitmaps[group].inode_bitmap, inode_to_local(inode), used);
+    ext2_bitmaps[group].inode_dirty = true;
     if (used)
     {
-        bitmap_buff.buf[byte_index] |= (1 << bit_index);
-        EXT2_BGDT.table[0].bg_free_inodes_count--;
+        EXT2_BGDT.table[group].bg_free_inodes_count--;
         EXT2SB.s_free_inodes_count--;
     }
     else
     {
-        bitmap_buff.buf[byte_index] &= ~(1 << bit_index);
-        EXT2_BGDT.table[0].bg_free_inodes_count++;
+        EXT2_BGDT.table[group].bg_free_inodes_count++;
         EXT2SB.s_free_inodes_count++;
     }
-
-    write_blocks(&bitmap_buff, EXT2_BGDT.table[0].bg_inode_bitmap, 1);
 }
 
-uint32_t allocate_block(void)
+/**
+ * Cari extent kosong sepanjang want block mulai dari block goal, lalu group berikutnya (berputar sampai group goal lagi).
+ * Jika tidak ada extent sepanjang want, dipakai extent terpanjang yang ditemukan. Block tidak ditandai terpakai
+ *
+ * @param length Panjang extent yang ditemukan, 0 jika disk penuh
+ * @return Block pertama extent
+ */
+static uint32_t find_extent(uint32_t goal, uint32_t want, uint32_t *length)
 {
-    uint32_t first_data_block = EXT2_BGDT.table[0].bg_inode_table + INODES_TABLE_BLOCK_COUNT;
-
-    for (uint32_t i = first_data_block; i < BLOCKS_PER_GROUP; i++)
+    uint32_t groups = GROUPS_COUNT;
+    uint32_t goal_group = goal / ext2_geo.blocks_per_group;
+    if (goal_group >= groups)
+        goal_group = goal = 0;
+
+    uint32_t best_block = 0;
+    uint32_t best_length = 0;
+    for (uint32_t pass = 0; pass <= groups && best_length < want; pass++)
     {
-        if (!is_block_used(i))
+        uint32_t group = (goal_group + pass) % groups;
+        struct EXT2GroupBitmap *bitmap = &ext2_bitmaps[group];
+        if (!bitmap->loaded || EXT2_BGDT.table[group].bg_free_blocks_count == 0)
+            continue;
+
+        uint32_t bit = pass == 0 ? goal % ext2_geo.blocks_per_group : 0;
+        while (best_length < want)
         {
-            set_block_used(i, true);
-            return i;
+            bit = bitmap_find_free(bitmap->block_bitmap, bitmap->reserve_bitmap, bit, ext2_geo.blocks_per_group);
+            if (bit == EXT2_BITMAP_FULL)
+                break;
+
+            uint32_t run = bitmap_free_run(bitmap->block_bitmap, bitmap->reserve_bitmap, bit, want, ext2_geo.blocks_per_group);
+            if (run > best_length)
+            {
+                best_block = group * ext2_geo.blocks_per_group + bit;
+                best_length = run;
+            }
+            bit += run;
         }
     }
-    return 0; // No free block
+    *length = best_length;
+    return best_block;
 }
 
-uint32_t allocate_inode(void)
+// Alokasi satu block sedekat mungkin setelah goal, window preallocation dilepas semua jika hanya block itu yang tersisa
+static uint32_t allocate_block_near(uint32_t goal)
 {
-    for (uint32_t i = 1; i <= INODES_PER_GROUP; i++)
+    // Block metadata (boot, SB, BGDT, bitmap, inode table) sudah ditandai terpakai di bitmap
+    uint32_t length;
+    uint32_t block = find_extent(goal, 1, &length);
+    if (length == 0)
     {
-        if (!is_inode_used(i))
-        {
-            set_inode_used(i, true);
-            return i;
-        }
+        for (uint32_t i = 0; i < EXT2_ICACHE_SIZE; i++)
+            prealloc_discard(&ext2_icache.nodes[i]);
+        block = find_extent(goal, 1, &length);
     }
-    return 0; // No free inode
-}
+    if (length == 0)
+        return 0; // No free block
 
-/* =================== DIRECTORY ENTRY OPERATIONS ============================*/
+    set_block_used(block, true);
+    return block;
+}
 
-struct EXT2DirectoryEntry *find_entry_in_dir(uint32_t dir_inode, char *name, uint8_t name_len)
+uint32_t allocate_block(void)
 {
-    struct EXT2Inode dir_node;
-    read_inode(dir_inode, &dir_node);
+    return allocate_block_near(0);
+}
 
-    if (!(dir_node.i_mode & EXT2_S_IFDIR))
+/**
+ * Kosongkan inode table group yang belum pernah dipakai. Ditulis sebagai data biasa (bukan lewat journal),
+ * block data ditulis sebelum commit record sehingga flag EXT2_BG_INODE_ZEROED tidak mendahului isinya.
+ * Inode group ini yang terlanjur ada di cache (isi lama inode table) dibuang
+ */
+static void inode_table_zero(uint32_t group)
+{
+    struct EXT2BlockGroupDescriptor *bgd = &EXT2_BGDT.table[group];
+    for (uint32_t i = 0; i < ext2_geo.inode_table_blocks; i++)
     {
-        return (struct EXT2DirectoryEntry *)0;
+        struct BufferHead *table_buff = bcache_get_new(&ext2_cache, bgd->bg_inode_table + i);
+        memset(table_buff->data, 0, ext2_geo.block_size);
+        bcache_mark_dirty(&ext2_cache, table_buff);
+        bcache_release(&ext2_cache, table_buff);
     }
-
-    static char find_buf[BLOCK_SIZE * 8];
-
-    struct EXT2DriverRequest req = {
-        .buf = find_buf,
-        .parent_inode = dir_inode,
-        .buffer_size = sizeof(find_buf)};
-
-    if (read_directory(&req) != 0)
+    for (uint32_t i = 0; i < EXT2_ICACHE_SIZE; i++)
     {
-        return (struct EXT2DirectoryEntry *)0;
+        struct EXT2MemInode *node = &ext2_icache.nodes[i];
+        if (node->inode != 0 && node->refcount == 0 && !node->dirty && inode_to_bgd(node->inode) == group)
+            icache_unhash(node);
     }
+    bgd->bg_flags |= EXT2_BG_INODE_ZEROED;
+}
 
-    uint32_t offset = 0;
-    while (offset < req.buffer_size)
+bool inode_table_lazy_init(void)
+{
+    for (uint32_t group = 0; group < GROUPS_COUNT; group++)
     {
-        struct EXT2DirectoryEntry *entry = (struct EXT2DirectoryEntry *)(find_buf + offset);
+        uint16_t flags = EXT2_BGDT.table[group].bg_flags;
+        if (!ext2_bitmaps[group].loaded || !(flags & EXT2_BG_INODE_UNINIT) || (flags & EXT2_BG_INODE_ZEROED))
+            continue;
+
+        blockdev_plug(ext2_device);
+        inode_table_zero(group);
+        commit_metadata();
+        journal_commit(false);
+        blockdev_unplug(ext2_device);
+        return true;
+    }
+    return false;
+}
 
-        if (entry->rec_len == 0)
-            break;
+static uint32_t allocate_inode_in_group(uint32_t group)
+{
+    if (!ext2_bitmaps[group].loaded || EXT2_BGDT.table[group].bg_free_inodes_count == 0)
+        return 0;
 
-        if (entry->inode != 0 && entry->name_len == name_len)
-        {
-            char *entry_name = get_entry_name(entry);
-            if (memcmp(entry_name, name, name_len) == 0)
-            {
-                static struct EXT2DirectoryEntry found_entry;
-                memcpy(&found_entry, entry, sizeof(struct EXT2DirectoryEntry));
-                return &found_entry;
-            }
-        }
+    uint32_t bit = bitmap_find_free(ext2_bitmaps[group].inode_bitmap, (const uint32_t *)0, 0, ext2_geo.inodes_per_group);
+    if (bit == EXT2_BITMAP_FULL)
+        return 0;
 
-        offset += entry->rec_len;
-    }
+    // Inode pertama group uninit, inode table belum tentu kosong
+    if (!(EXT2_BGDT.table[group].bg_flags & EXT2_BG_INODE_ZEROED) && (EXT2_BGDT.table[group].bg_flags & EXT2_BG_INODE_UNINIT))
+        inode_table_zero(group);
 
-    return (struct EXT2DirectoryEntry *)0;
+    uint32_t inode = group * ext2_geo.inodes_per_group + bit + 1;
+    set_inode_used(inode, true);
+    return inode;
 }
 
-/* =================== READ OPERATIONS ============================*/
-
-int8_t read(struct EXT2DriverRequest *request)
+uint32_t allocate_inode(void)
 {
-    if (request->parent_inode < 2)
+    for (uint32_t group = 0; group < GROUPS_COUNT; group++)
     {
-        return 4;
+        uint32_t inode = allocate_inode_in_group(group);
+        if (inode != 0)
+            return inode;
     }
+    return 0; // No free inode
+}
 
-    struct EXT2DirectoryEntry *entry = find_entry_in_dir(request->parent_inode, request->name, request->name_len);
+/* =================== GROUP PLACEMENT ============================*/
 
-    if (entry == (struct EXT2DirectoryEntry *)0)
-    {
-        return 3;
-    }
+/*
+ * Pemilihan group inode baru ala Orlov (Linux ext2 / ext3):
+ * - Direktori di bawah root disebar ke group yang free inode & free block-nya di atas rata-rata
+ *   dengan direktori paling sedikit, sehingga subtree yang tidak berhubungan tidak saling berebut group.
+ * - Direktori lain tetap di group parent selama group itu belum terlalu padat.
+ * - File selalu di group parent, block datanya mulai dari setelah inode table group itu (file_block_goal()).
+ */
 
-    if (entry->file_type != EXT2_FT_REG_FILE)
-    {
-        return 1;
-    }
+#define EXT2_GROUP_NONE 0xFFFFFFFFu
 
-    struct EXT2Inode file_inode;
-    read_inode(entry->inode, &file_inode);
+static uint32_t ext2_orlov_rotor; // Awal pencarian direktori top level, bergeser tiap pemakaian agar seri tidak selalu ke group 0
 
-    uint32_t bytes_to_read = file_inode.i_size;
-    if (bytes_to_read > request->buffer_size)
-    {
-        bytes_to_read = request->buffer_size;
-    }
+static bool group_has_space(uint32_t group, uint32_t min_inodes, uint32_t min_blocks)
+{
+    struct EXT2BlockGroupDescriptor *bgd = &EXT2_BGDT.table[group];
+    return ext2_bitmaps[group].loaded && bgd->bg_free_inodes_count > 0
+        && bgd->bg_free_inodes_count >= min_inodes && bgd->bg_free_blocks_count >= min_blocks;
+}
 
-    uint32_t bytes_read = 0;
-    uint8_t *buf = (uint8_t *)request->buf;
-    struct BlockBuffer block_buff;
+static uint32_t find_group_dir(uint32_t parent_group, bool top_level)
+{
+    uint32_t groups = GROUPS_COUNT;
+    uint32_t avg_free_inodes = EXT2SB.s_free_inodes_count / groups;
+    uint32_t avg_free_blocks = EXT2SB.s_free_blocks_count / groups;
 
-    for (int i = 0; i < 12; i++)
+    if (top_level)
     {
-        if (file_inode.i_block[i] == 0 || bytes_read >= bytes_to_read)
-            break;
-
-        read_blocks(&block_buff, file_inode.i_block[i], 1);
-
-        uint32_t bytes_to_copy = BLOCK_SIZE;
-        if (bytes_read + bytes_to_copy > bytes_to_read)
+        uint32_t best_group = EXT2_GROUP_NONE;
+        for (uint32_t i = 0; i < groups; i++)
         {
-            bytes_to_copy = bytes_to_read - bytes_read;
+            uint32_t group = (ext2_orlov_rotor + i) % groups;
+            if (!group_has_space(group, avg_free_inodes, avg_free_blocks))
+                continue;
+            if (best_group == EXT2_GROUP_NONE
+                || EXT2_BGDT.table[group].bg_used_dirs_count < EXT2_BGDT.table[best_group].bg_used_dirs_count)
+                best_group = group;
         }
-
-        memcpy(buf + bytes_read, block_buff.buf, bytes_to_copy);
-        bytes_read += bytes_to_copy;
+        ext2_orlov_rotor = (ext2_orlov_rotor + 1) % groups;
+        if (best_group != EXT2_GROUP_NONE)
+            return best_group;
     }
-
-    if (file_inode.i_block[12] != 0 && bytes_read < bytes_to_read)
+    else
     {
-        struct BlockBuffer indirect_block_buff;
-        read_blocks(&indirect_block_buff, file_inode.i_block[12], 1);
-        uint32_t *indirect_pointers = (uint32_t *)indirect_block_buff.buf;
-
-        for (unsigned int i = 0; i < (BLOCK_SIZE / sizeof(uint32_t)); i++)
+        uint32_t dirs = 0;
+        for (uint32_t group = 0; group < groups; group++)
+            dirs += EXT2_BGDT.table[group].bg_used_dirs_count;
+
+        // Group parent dipakai selama direktori, inode & block-nya tidak jauh di bawah rata-rata
+        uint32_t max_dirs = dirs / groups + ext2_geo.inodes_per_group / 16;
+        uint32_t min_inodes = avg_free_inodes > ext2_geo.inodes_per_group / 4 ? avg_free_inodes - ext2_geo.inodes_per_group / 4 : 0;
+        uint32_t min_blocks = avg_free_blocks > ext2_geo.blocks_per_group / 4 ? avg_free_blocks - ext2_geo.blocks_per_group / 4 : 0;
+        for (uint32_t i = 0; i < groups; i++)
         {
-            if (indirect_pointers[i] == 0 || bytes_read >= bytes_to_read)
-                break;
-
-            read_blocks(&block_buff, indirect_pointers[i], 1);
-
-            uint32_t bytes_to_copy = BLOCK_SIZE;
-            if (bytes_read + bytes_to_copy > bytes_to_read)
-            {
-                bytes_to_copy = bytes_to_read - bytes_read;
-            }
-
-            memcpy(buf + bytes_read, block_buff.buf, bytes_to_copy);
-            bytes_read += bytes_to_copy;
+            uint32_t group = (parent_group + i) % groups;
+            if (EXT2_BGDT.table[group].bg_used_dirs_count < max_dirs && group_has_space(group, min_inodes, min_blocks))
+                return group;
         }
     }
 
-    request->buffer_size = bytes_read;
-
-    return 0;
+    // Fallback: group mana pun dengan free inode di atas rata-rata, lalu group mana pun yang masih punya inode
+    for (uint32_t i = 0; i < groups; i++)
+    {
+        uint32_t group = (parent_group + i) % groups;
+        if (group_has_space(group, avg_free_inodes, 0))
+            return group;
+    }
+    for (uint32_t i = 0; i < groups; i++)
+    {
+        uint32_t group = (parent_group + i) % groups;
+        if (group_has_space(group, 0, 0))
+            return group;
+    }
+    return EXT2_GROUP_NONE;
 }
 
-int8_t read_directory(struct EXT2DriverRequest *request)
+static uint32_t find_group_other(uint32_t parent_group)
 {
-    // Validasi
-    if (request->parent_inode < 2 || request->parent_inode > INODES_PER_GROUP)
+    uint32_t groups = GROUPS_COUNT;
+    if (group_has_space(parent_group, 0, 1))
+        return parent_group;
+
+    // Hash kuadratik dari group parent, group yang penuh cepat dilewati
+    for (uint32_t i = 1; i < groups; i <<= 1)
     {
-        return 3; // Parent folder tidak dapat dibaca / invalid
+        uint32_t group = (parent_group + i) % groups;
+        if (group_has_space(group, 0, 1))
+            return group;
     }
 
-    // Baca inode parent
-    struct BlockBuffer inode_buff;
-    uint32_t bgd_index = inode_to_bgd(request->parent_inode);
-    uint32_t local_index = inode_to_local(request->parent_inode);
+    // Group mana pun yang masih punya inode, walaupun block-nya habis
+    for (uint32_t i = 0; i < groups; i++)
+    {
+        uint32_t group = (parent_group + i) % groups;
+        if (group_has_space(group, 0, 0))
+            return group;
+    }
+    return EXT2_GROUP_NONE;
+}
 
-    read_blocks(&inode_buff, EXT2_BGDT.table[bgd_index].bg_inode_table, 1);
+// Alokasi inode untuk entry baru di direktori parent_inode, group dipilih dengan kebijakan di atas
+static uint32_t allocate_inode_near(uint32_t parent_inode, bool is_directory)
+{
+    uint32_t parent_group = inode_to_bgd(parent_inode);
+    if (parent_group >= GROUPS_COUNT)
+        parent_group = 0;
+
+    uint32_t group = is_directory ? find_group_dir(parent_group, parent_inode == 2) : find_group_other(parent_group);
+    if (group == EXT2_GROUP_NONE)
+        return 0;
+
+    uint32_t inode = allocate_inode_in_group(group);
+    return inode != 0 ? inode : allocate_inode();
+}
+
+/* =================== BLOCK PREALLOCATION ============================*/
+
+/*
+ * Window preallocation: block bebas tepat setelah block terakhir yang dialokasikan untuk inode dipesan di
+ * reserve_bitmap, sehingga alokasi inode lain melewatinya dan block berikutnya file tetap contiguous.
+ * Pesanan hanya ada di memori, tidak pernah ikut ke bitmap di disk dan tidak mengubah free count.
+ */
+
+static void prealloc_discard(struct EXT2MemInode *node)
+{
+    for (uint32_t i = 0; i < node->prealloc_count; i++)
+    {
+        uint32_t block = node->prealloc_block + i;
+        bitmap_set(ext2_bitmaps[block / ext2_geo.blocks_per_group].reserve_bitmap, block % ext2_geo.blocks_per_group, false);
+    }
+    node->prealloc_count = 0;
+}
+
+// Block yang diharapkan untuk block file berikutnya: tepat setelah block sebelumnya (previous), atau awal group inode
+static uint32_t file_block_goal(struct EXT2MemInode *node, uint32_t previous)
+{
+    if (previous != 0)
+        return previous + 1;
+    return inode_to_bgd(node->inode) * ext2_geo.blocks_per_group;
+}
+
+/**
+ * Alokasi disk block untuk file. Block diambil dari window preallocation jika window tepat berada di goal,
+ * jika tidak dicari extent kosong sepanjang remaining block dekat goal. Sisa extent ditambah
+ * s_prealloc_blocks (s_prealloc_dir_blocks untuk direktori) menjadi window baru
+ *
+ * @param goal      Hasil file_block_goal()
+ * @param remaining Jumlah block yang masih akan dialokasikan caller mulai dari block ini, minimal 1
+ * @return Block baru yang sudah ditandai terpakai, 0 jika disk penuh
+ */
+static uint32_t allocate_file_block(struct EXT2MemInode *node, uint32_t goal, uint32_t remaining)
+{
+    if (node->prealloc_count > 0 && node->prealloc_block == goal)
+    {
+        bitmap_set(ext2_bitmaps[goal / ext2_geo.blocks_per_group].reserve_bitmap, goal % ext2_geo.blocks_per_group, false);
+        node->prealloc_block++;
+        node->prealloc_count--;
+        set_block_used(goal, true);
+        return goal;
+    }
+
+    prealloc_discard(node);
+    uint32_t length;
+    uint32_t block = find_extent(goal, remaining, &length);
+    if (length == 0)
+        return allocate_block_near(goal); // Sisa block bebas hanya di window inode lain
+
+    // Block setelah extent yang masih bebas ikut dipesan, sampai ukuran window
+    uint32_t group = block / ext2_geo.blocks_per_group;
+    uint32_t window = (node->i_mode & EXT2_S_IFDIR) ? EXT2SB.s_prealloc_dir_blocks : EXT2SB.s_prealloc_blocks;
+    length += bitmap_free_run(ext2_bitmaps[group].block_bitmap, ext2_bitmaps[group].reserve_bitmap,
+                              block % ext2_geo.blocks_per_group + length, window, ext2_geo.blocks_per_group);
+
+    set_block_used(block, true);
+    node->prealloc_block = block + 1;
+    node->prealloc_count = length - 1;
+    for (uint32_t i = 0; i < node->prealloc_count; i++)
+        bitmap_set(ext2_bitmaps[group].reserve_bitmap, (block + 1 + i) % ext2_geo.blocks_per_group, true);
+    return block;
+}
+
+/* =================== METADATA JOURNAL ============================*/
+
+/*
+ * Journal metadata gaya JBD (ordered mode). Setiap block metadata yang diubah operasi masuk ke transaksi
+ * berjalan dan di-pin, tidak ditulis ke lokasi asalnya. Commit menulis data file dulu, lalu descriptor,
+ * salinan block & commit block secara berurutan di log. Setelah commit block sampai di disk block metadata
+ * boleh ditulis ke lokasi asal kapan saja (eviction), dan paling lambat saat checkpoint ketika log hampir penuh.
+ * Banyak operasi kecil berbagi satu transaksi (group commit), block yang sama hanya dicatat sekali.
+ */
+
+#define EXT2_JOURNAL_MAX_BLOCKS (EXT2_JOURNAL_SIZE / EXT2_MIN_BLOCK_SIZE) // Panjang journal terbesar (block 1 KiB)
+#define EXT2_JOURNAL_MAX_TRANSACTION (BCACHE_MAX_BUFFERS / 4)            // Transaksi memakai paling banyak seperempat buffer cache
+#define EXT2_PIN_RESERVE 8u                                              // Buffer yang selalu disisakan journal & read-ahead untuk pin satu operasi (dx split, block map, inode table)
+#define EXT2_JOURNAL_COMMIT_INTERVAL 5000000000ull                       // Umur transaksi maksimum dalam TSC cycle, sekitar 5 detik pada 1 GHz
+#define EXT2_JOURNAL_CHECKSUM_SEED 2166136261u                           // FNV-1a offset basis
+
+/**
+ * EXT2Journal, state journal di memori
+ *
+ * @param enabled         Filesystem punya journal yang valid, jika false metadata ditulis langsung seperti ext2
+ * @param first_block     Block journal superblock, s_journal_block
+ * @param blocks          Panjang journal, s_journal_blocks
+ * @param max_transaction Block per transaksi, seperempat journal dan seperempat buffer cache
+ * @param head            Log block berikutnya yang ditulis
+ * @param start           Log block transaksi tertua yang belum di-checkpoint, 0 jika log kosong
+ * @param sequence        Id transaksi berjalan
+ * @param started_at      TSC saat block pertama masuk transaksi berjalan
+ * @param buffers         Buffer metadata transaksi berjalan, di-pin sampai commit
+ * @param revoked         Block yang pernah di-log lalu dibebaskan di transaksi berjalan
+ * @param logged          Block yang punya salinan di log sejak checkpoint terakhir
+ */
+struct EXT2Journal
+{
+    bool enabled;
+    uint32_t first_block;
+    uint32_t blocks;
+    uint32_t max_transaction;
+    uint32_t head;
+    uint32_t start;
+    uint32_t sequence;
+    uint64_t started_at;
+    struct BufferHead *buffers[EXT2_JOURNAL_MAX_TRANSACTION];
+    uint32_t buffer_count;
+    uint32_t revoked[EXT2_JOURNAL_MAX_BLOCKS];
+    uint32_t revoke_count;
+    uint32_t logged[EXT2_JOURNAL_MAX_BLOCKS];
+    uint32_t logged_count;
+};
+
+static struct EXT2Journal ext2_journal;
+
+// Revoke yang ditemukan saat recovery, block tidak di-replay dari transaksi sebelum sequence
+struct EXT2JournalRevoke
+{
+    uint32_t block;
+    uint32_t sequence;
+};
+
+static struct EXT2JournalRevoke ext2_journal_revokes[EXT2_JOURNAL_MAX_BLOCKS];
+static uint32_t ext2_journal_revoke_count;
+
+static void journal_init(void)
+{
+    memset(&ext2_journal, 0, sizeof(ext2_journal));
+}
+
+static uint32_t journal_tags_per_block(void)
+{
+    return (ext2_geo.block_size - sizeof(struct EXT2JournalHeader)) / sizeof(struct EXT2JournalBlockTag);
+}
+
+// Log block terbanyak yang dipakai satu transaksi: descriptor untuk semua tag, salinan block & commit block
+static uint32_t journal_transaction_space(void)
+{
+    uint32_t tags = ext2_journal.max_transaction + ext2_journal.blocks;
+    return (tags + journal_tags_per_block() - 1) / journal_tags_per_block() + ext2_journal.max_transaction + 1;
+}
+
+// Log ditulis langsung ke device, bukan lewat buffer cache, agar urutan terhadap flush terjaga
+static void journal_write_block(uint32_t index, const void *data)
+{
+    uint32_t sectors = ext2_geo.block_size / BLOCK_SIZE;
+    blockdev_write(ext2_device, data, (ext2_journal.first_block + index) * sectors, sectors);
+}
+
+static void journal_read_block(uint32_t index, void *data)
+{
+    uint32_t sectors = ext2_geo.block_size / BLOCK_SIZE;
+    blockdev_read(ext2_device, data, (ext2_journal.first_block + index) * sectors, sectors);
+}
+
+static void journal_write_super(uint32_t start, uint32_t sequence)
+{
+    uint8_t block[EXT2_MAX_BLOCK_SIZE];
+    memset(block, 0, ext2_geo.block_size);
+    struct EXT2JournalSuperblock *jsb = (struct EXT2JournalSuperblock *)block;
+    jsb->s_header.h_magic = EXT2_JOURNAL_MAGIC;
+    jsb->s_header.h_blocktype = EXT2_JOURNAL_SUPERBLOCK;
+    jsb->s_blocksize = ext2_geo.block_size;
+    jsb->s_maxlen = ext2_journal.blocks;
+    jsb->s_first = 1;
+    jsb->s_sequence = sequence;
+    jsb->s_start = start;
+    journal_write_block(0, block);
+}
+
+static uint32_t journal_checksum(uint32_t hash, const uint8_t *data, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+static bool journal_contains(const uint32_t *blocks, uint32_t count, uint32_t block)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (blocks[i] == block)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Masukkan buffer metadata yang baru diubah ke transaksi berjalan, pengganti bcache_mark_dirty() untuk metadata
+ * @param buffer Buffer yang di-pin caller, ikut di-pin transaksi sampai commit
+ */
+static void journal_dirty(struct BufferHead *buffer)
+{
+    struct EXT2Journal *journal = &ext2_journal;
+    if (!journal->enabled)
+    {
+        bcache_mark_dirty(&ext2_cache, buffer);
+        return;
+    }
+
+    // Buffer yang gagal dibaca berisi nol, tidak boleh masuk log lalu menimpa block aslinya saat checkpoint
+    if (!buffer->valid)
+        return;
+
+    // Isi baru tidak boleh sampai di lokasi asal sebelum transaksi di-commit
+    bcache_mark_clean(&ext2_cache, buffer);
+    for (uint32_t i = 0; i < journal->buffer_count; i++)
+    {
+        if (journal->buffers[i] == buffer)
+            return;
+    }
+    if (journal->buffer_count == journal->max_transaction || bcache_unpinned(&ext2_cache) <= EXT2_PIN_RESERVE)
+    {
+        // Transaksi atau buffer cache penuh di tengah operasi, transaksi berjalan di-commit lebih dulu dan pin-nya
+        // dilepas. Block tidak boleh ditulis langsung ke lokasi asal: salinan lama di log yang belum di-checkpoint
+        // akan menimpanya saat recovery
+        journal_commit_transaction();
+    }
+
+    if (journal->buffer_count == 0 && journal->revoke_count == 0)
+        journal->started_at = disk_timestamp();
+    journal->buffers[journal->buffer_count++] = bcache_get(&ext2_cache, buffer->block);
+}
+
+/**
+ * Titik aman operasi panjang (write / fallocate file besar) untuk memecah diri menjadi beberapa transaksi.
+ * Jika transaksi berjalan sudah setengah penuh, metadata di memori ikut ditulis lalu transaksi di-commit,
+ * sehingga overflow di journal_dirty() tidak terjadi di tengah commit_metadata()
+ */
+static void journal_restart(void)
+{
+    struct EXT2Journal *journal = &ext2_journal;
+    if (!journal->enabled || journal->buffer_count < journal->max_transaction / 2)
+        return;
+    commit_metadata();
+    journal_commit_transaction();
+}
+
+// Pengganti bcache_write() untuk metadata
+static void journal_write(const void *ptr, uint32_t block)
+{
+    struct BufferHead *buffer = bcache_get_new(&ext2_cache, block);
+    memcpy(buffer->data, ptr, ext2_geo.block_size);
+    journal_dirty(buffer);
+    bcache_release(&ext2_cache, buffer);
+}
+
+/**
+ * Block metadata dibebaskan. Block dikeluarkan dari transaksi berjalan, dan jika block punya salinan di log
+ * dicatat sebagai revoke agar recovery tidak menimpa isi barunya (misal data file) dengan salinan lama.
+ * Sampai revoke di-commit block dipesan di reserve_bitmap sehingga belum bisa dialokasikan ulang
+ */
+static void journal_revoke(uint32_t block)
+{
+    struct EXT2Journal *journal = &ext2_journal;
+    if (!journal->enabled)
+        return;
+
+    for (uint32_t i = 0; i < journal->buffer_count; i++)
+    {
+        if (journal->buffers[i]->block == block)
+        {
+            bcache_release(&ext2_cache, journal->buffers[i]);
+            journal->buffers[i] = journal->buffers[--journal->buffer_count];
+            break;
+        }
+    }
+
+    if (!journal_contains(journal->logged, journal->logged_count, block) ||
+        journal_contains(journal->revoked, journal->revoke_count, block))
+        return;
+
+    if (journal->buffer_count == 0 && journal->revoke_count == 0)
+        journal->started_at = disk_timestamp();
+    journal->revoked[journal->revoke_count++] = block;
+    bitmap_set(ext2_bitmaps[block / ext2_geo.blocks_per_group].reserve_bitmap, block % ext2_geo.blocks_per_group, true);
+}
+
+// Semua block yang di-log sudah ditulis ke lokasi asal, log dikosongkan
+static void journal_checkpoint(void)
+{
+    struct EXT2Journal *journal = &ext2_journal;
+    bcache_sync(&ext2_cache);
+    blockdev_flush(ext2_device);
+    journal_write_super(0, journal->sequence);
+    blockdev_flush(ext2_device);
+    journal->start = 0;
+    journal->head = 1;
+    journal->logged_count = 0;
+}
+
+static void journal_commit_transaction(void)
+{
+    struct EXT2Journal *journal = &ext2_journal;
+    uint8_t block[EXT2_MAX_BLOCK_SIZE];
+    blockdev_plug(ext2_device);
+
+    // 1. Ordered mode: data file sampai di disk sebelum metadata yang menunjuknya di-commit
+    bcache_sync_data(&ext2_cache);
+    blockdev_flush(ext2_device);
+
+    // 2. Log kosong, journal superblock menunjuk transaksi ini sebagai awal replay
+    if (journal->start == 0)
+    {
+        journal->start = journal->head;
+        journal_write_super(journal->start, journal->sequence);
+    }
+
+    // 3. Descriptor block diikuti salinan block yang di-tag, revoke tidak punya salinan
+    uint32_t checksum = EXT2_JOURNAL_CHECKSUM_SEED;
+    uint32_t tags = journal->buffer_count + journal->revoke_count;
+    uint32_t tag = 0;
+    while (tag < tags)
+    {
+        memset(block, 0, ext2_geo.block_size);
+        struct EXT2JournalHeader *header = (struct EXT2JournalHeader *)block;
+        header->h_magic = EXT2_JOURNAL_MAGIC;
+        header->h_blocktype = EXT2_JOURNAL_DESCRIPTOR_BLOCK;
+        header->h_sequence = journal->sequence;
+
+        struct EXT2JournalBlockTag *descriptor_tags = (struct EXT2JournalBlockTag *)(header + 1);
+        uint32_t first_tag = tag;
+        uint32_t count = 0;
+        for (; tag < tags && count < journal_tags_per_block(); tag++, count++)
+        {
+            if (tag < journal->buffer_count)
+            {
+                struct BufferHead *buffer = journal->buffers[tag];
+                descriptor_tags[count].t_blocknr = buffer->block;
+                if (*(uint32_t *)buffer->data == EXT2_JOURNAL_MAGIC)
+                    descriptor_tags[count].t_flags = EXT2_JOURNAL_FLAG_ESCAPE;
+            }
+            else
+            {
+                descriptor_tags[count].t_blocknr = journal->revoked[tag - journal->buffer_count];
+                descriptor_tags[count].t_flags = EXT2_JOURNAL_FLAG_REVOKE;
+            }
+        }
+        descriptor_tags[count - 1].t_flags |= EXT2_JOURNAL_FLAG_LAST_TAG;
+        checksum = journal_checksum(checksum, block, ext2_geo.block_size);
+        journal_write_block(journal->head++, block);
+
+        for (uint32_t i = first_tag; i < tag && i < journal->buffer_count; i++)
+        {
+            // Block yang diawali magic di-escape agar tidak terbaca sebagai block journal saat recovery
+            memcpy(block, journal->buffers[i]->data, ext2_geo.block_size);
+            if (*(uint32_t *)block == EXT2_JOURNAL_MAGIC)
+                *(uint32_t *)block = 0;
+            checksum = journal_checksum(checksum, block, ext2_geo.block_size);
+            journal_write_block(journal->head++, block);
+        }
+    }
+
+    // 4. Commit block setelah semua block log, transaksi dianggap ada hanya jika commit block dan checksum cocok
+    memset(block, 0, ext2_geo.block_size);
+    struct EXT2JournalCommit *commit = (struct EXT2JournalCommit *)block;
+    commit->c_header.h_magic = EXT2_JOURNAL_MAGIC;
+    commit->c_header.h_blocktype = EXT2_JOURNAL_COMMIT_BLOCK;
+    commit->c_header.h_sequence = journal->sequence;
+    commit->c_checksum = checksum;
+    journal_write_block(journal->head++, block);
+    blockdev_flush(ext2_device);
+
+    // 5. Transaksi aman di log, block metadata ditulis ke lokasi asal saat eviction atau checkpoint
+    for (uint32_t i = 0; i < journal->buffer_count; i++)
+    {
+        struct BufferHead *buffer = journal->buffers[i];
+        if (!journal_contains(journal->logged, journal->logged_count, buffer->block))
+            journal->logged[journal->logged_count++] = buffer->block;
+        bcache_mark_journaled(&ext2_cache, buffer);
+        bcache_release(&ext2_cache, buffer);
+    }
+    for (uint32_t i = 0; i < journal->revoke_count; i++)
+    {
+        uint32_t revoked = journal->revoked[i];
+        bitmap_set(ext2_bitmaps[revoked / ext2_geo.blocks_per_group].reserve_bitmap, revoked % ext2_geo.blocks_per_group, false);
+    }
+    journal->buffer_count = 0;
+    journal->revoke_count = 0;
+    journal->sequence++;
+
+    // 6. Transaksi berikutnya belum tentu muat di sisa log
+    if (journal->head + journal_transaction_space() > journal->blocks)
+        journal_checkpoint();
+    blockdev_unplug(ext2_device);
+}
+
+void journal_commit(bool force)
+{
+    struct EXT2Journal *journal = &ext2_journal;
+    if (!journal->enabled)
+    {
+        bcache_sync(&ext2_cache);
+        return;
+    }
+    if (journal->buffer_count == 0 && journal->revoke_count == 0)
+        return;
+
+    bool full = journal->buffer_count >= journal->max_transaction / 2;
+    bool old = disk_timestamp() - journal->started_at >= EXT2_JOURNAL_COMMIT_INTERVAL;
+    if (force || full || old)
+        journal_commit_transaction();
+}
+
+static bool journal_is_revoked(uint32_t block, uint32_t sequence, uint32_t end)
+{
+    for (uint32_t i = 0; i < ext2_journal_revoke_count; i++)
+    {
+        struct EXT2JournalRevoke *revoke = &ext2_journal_revokes[i];
+        if (revoke->block == block && revoke->sequence > sequence && revoke->sequence < end)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Baca satu transaksi di log mulai index
+ *
+ * @param index    Log block descriptor pertama, diisi log block setelah commit block
+ * @param sequence Id transaksi yang diharapkan, block dengan id lain adalah sisa log lama
+ * @param end      0 saat scan: revoke dicatat. Selain itu id setelah transaksi valid terakhir: block ditulis ke lokasi asal
+ * @return Transaksi lengkap dan checksum cocok
+ */
+static bool journal_walk(uint32_t *index, uint32_t sequence, uint32_t end)
+{
+    uint8_t descriptor[EXT2_MAX_BLOCK_SIZE];
+    uint8_t block[EXT2_MAX_BLOCK_SIZE];
+    uint32_t checksum = EXT2_JOURNAL_CHECKSUM_SEED;
+    uint32_t cursor = *index;
+    while (cursor < ext2_journal.blocks)
+    {
+        journal_read_block(cursor++, descriptor);
+        struct EXT2JournalHeader *header = (struct EXT2JournalHeader *)descriptor;
+        if (header->h_magic != EXT2_JOURNAL_MAGIC || header->h_sequence != sequence)
+            return false;
+        if (header->h_blocktype == EXT2_JOURNAL_COMMIT_BLOCK)
+        {
+            *index = cursor;
+            return ((struct EXT2JournalCommit *)descriptor)->c_checksum == checksum;
+        }
+        if (header->h_blocktype != EXT2_JOURNAL_DESCRIPTOR_BLOCK)
+            return false;
+        checksum = journal_checksum(checksum, descriptor, ext2_geo.block_size);
+
+        struct EXT2JournalBlockTag *tags = (struct EXT2JournalBlockTag *)(header + 1);
+        for (uint32_t i = 0; i < journal_tags_per_block(); i++)
+        {
+            struct EXT2JournalBlockTag *tag = &tags[i];
+            if (tag->t_flags & EXT2_JOURNAL_FLAG_REVOKE)
+            {
+                if (end == 0 && ext2_journal_revoke_count < EXT2_JOURNAL_MAX_BLOCKS)
+                {
+                    ext2_journal_revokes[ext2_journal_revoke_count].block = tag->t_blocknr;
+                    ext2_journal_revokes[ext2_journal_revoke_count].sequence = sequence;
+                    ext2_journal_revoke_count++;
+                }
+            }
+            else
+            {
+                if (cursor >= ext2_journal.blocks)
+                    return false;
+                journal_read_block(cursor++, block);
+                checksum = journal_checksum(checksum, block, ext2_geo.block_size);
+                if (end != 0 && tag->t_blocknr < EXT2SB.s_blocks_count && !journal_is_revoked(tag->t_blocknr, sequence, end))
+                {
+                    if (tag->t_flags & EXT2_JOURNAL_FLAG_ESCAPE)
+                        *(uint32_t *)block = EXT2_JOURNAL_MAGIC;
+                    bcache_write(&ext2_cache, block, tag->t_blocknr);
+                }
+            }
+            if (tag->t_flags & EXT2_JOURNAL_FLAG_LAST_TAG)
+                break;
+        }
+    }
+    return false;
+}
+
+/**
+ * Replay transaksi yang sudah di-commit tapi mungkin belum di-checkpoint. Pass pertama mencari transaksi
+ * lengkap terakhir & mengumpulkan revoke, pass kedua menulis block ke lokasi asal berurutan sesuai transaksi
+ * @return Id transaksi setelah transaksi valid terakhir
+ */
+static uint32_t journal_recover(struct EXT2JournalSuperblock *jsb)
+{
+    ext2_journal_revoke_count = 0;
+    uint32_t index = jsb->s_start;
+    uint32_t end = jsb->s_sequence;
+    while (journal_walk(&index, end, 0))
+        end++;
+
+    index = jsb->s_start;
+    for (uint32_t sequence = jsb->s_sequence; sequence < end; sequence++)
+        journal_walk(&index, sequence, end);
+    bcache_sync(&ext2_cache);
+    blockdev_flush(ext2_device);
+    return end;
+}
+
+static void journal_start(uint32_t sequence)
+{
+    struct EXT2Journal *journal = &ext2_journal;
+    journal->max_transaction = journal->blocks / 4;
+    if (journal->max_transaction > ext2_cache.size / 4)
+        journal->max_transaction = ext2_cache.size / 4;
+    journal->head = 1;
+    journal->start = 0;
+    journal->sequence = sequence;
+    journal->enabled = true;
+}
+
+// Journal baru saat create_ext2(), log dikosongkan agar sisa isi disk tidak terbaca sebagai transaksi
+static void journal_create(void)
+{
+    struct EXT2Journal *journal = &ext2_journal;
+    journal_init();
+    journal->first_block = EXT2SB.s_journal_block;
+    journal->blocks = EXT2SB.s_journal_blocks;
+
+    uint8_t block[EXT2_MAX_BLOCK_SIZE];
+    memset(block, 0, ext2_geo.block_size);
+    for (uint32_t i = 1; i < journal->blocks; i++)
+        journal_write_block(i, block);
+    journal_write_super(0, 1);
+    blockdev_flush(ext2_device);
+    journal_start(1);
+}
+
+// Mount: replay log jika filesystem tidak di-unmount bersih. Filesystem tanpa journal valid tetap bisa dipakai tanpa journal
+static void journal_load(void)
+{
+    struct EXT2Journal *journal = &ext2_journal;
+    journal_init();
+    if (EXT2SB.s_journal_blocks < 2 || EXT2SB.s_journal_blocks > EXT2_JOURNAL_MAX_BLOCKS)
+        return;
+    journal->first_block = EXT2SB.s_journal_block;
+    journal->blocks = EXT2SB.s_journal_blocks;
+
+    uint8_t block[EXT2_MAX_BLOCK_SIZE];
+    journal_read_block(0, block);
+    struct EXT2JournalSuperblock *jsb = (struct EXT2JournalSuperblock *)block;
+    if (jsb->s_header.h_magic != EXT2_JOURNAL_MAGIC || jsb->s_header.h_blocktype != EXT2_JOURNAL_SUPERBLOCK ||
+        jsb->s_blocksize != ext2_geo.block_size || jsb->s_maxlen != journal->blocks || jsb->s_start >= journal->blocks)
+        return;
+
+    uint32_t sequence = jsb->s_sequence;
+    if (jsb->s_start != 0)
+    {
+        sequence = journal_recover(jsb);
+        journal_write_super(0, sequence);
+        blockdev_flush(ext2_device);
+    }
+    journal_start(sequence);
+}
+
+/* =================== FILE BLOCK MAPPING ============================*/
+
+#define EXT2_MAP_SINGLE_KEY 0xFFFFFFFFu // leaf_key block map untuk block single indirect
+
+/**
+ * EXT2BlockMap, cursor pemetaan block file untuk akses berurutan. Block pointer (single indirect atau
+ * block level kedua doubly indirect) yang sedang dipakai disalin sekali ke pointers, sehingga block
+ * indirect dibaca / ditulis sekali per pointers_per_block block data, bukan sekali per block data
+ *
+ * @param node       Inode file yang di-pin caller
+ * @param leaf_block Disk block yang disalin di pointers, 0 jika belum ada
+ * @param leaf_key   EXT2_MAP_SINGLE_KEY atau index entry di block doubly indirect
+ * @param dirty      pointers berubah dan belum ditulis ke buffer cache
+ * @param pointers   Salinan isi leaf_block
+ */
+struct EXT2BlockMap
+{
+    struct EXT2MemInode *node;
+    uint32_t leaf_block;
+    uint32_t leaf_key;
+    bool dirty;
+    uint32_t pointers[EXT2_POINTERS_PER_BLOCK(EXT2_MAX_BLOCK_SIZE)];
+};
+
+static void block_map_init(struct EXT2BlockMap *map, struct EXT2MemInode *node)
+{
+    map->node = node;
+    map->leaf_block = 0;
+    map->dirty = false;
+}
+
+static void block_map_flush(struct EXT2BlockMap *map)
+{
+    if (map->dirty)
+        journal_write(map->pointers, map->leaf_block);
+    map->dirty = false;
+}
+
+// Block pointer kosong baru di dekat goal, dihitung ke i_blocks inode
+static uint32_t block_map_new_pointer_block(struct EXT2BlockMap *map, uint32_t goal)
+{
+    uint32_t block = allocate_block_near(goal);
+    if (block != 0)
+        map->node->i_blocks += ext2_geo.block_size / 512;
+    return block;
+}
+
+/**
+ * Salin leaf yang memetakan offsets ke map->pointers, leaf yang sama tidak dibaca ulang
+ *
+ * @param allocate Block pointer yang belum ada dialokasikan di dekat goal
+ * @return false jika leaf belum ada dan allocate false, disk penuh, atau leaf gagal dibaca
+ */
+static bool block_map_load(struct EXT2BlockMap *map, int8_t depth, uint32_t *offsets, bool allocate, uint32_t goal)
+{
+    uint32_t key = depth == 1 ? EXT2_MAP_SINGLE_KEY : offsets[1];
+    if (map->leaf_block != 0 && map->leaf_key == key)
+        return true;
+
+    // Leaf berganti: pointer leaf lama sudah di cache, operasi yang mengalokasikan boleh pindah transaksi
+    if (allocate)
+    {
+        block_map_flush(map);
+        journal_restart();
+    }
+
+    struct EXT2MemInode *node = map->node;
+    bool fresh = false;
+    uint32_t leaf;
+    if (depth == 1)
+    {
+        leaf = node->i_block[EXT2_IND_BLOCK];
+        if (leaf == 0 && allocate)
+        {
+            leaf = block_map_new_pointer_block(map, goal);
+            node->i_block[EXT2_IND_BLOCK] = leaf;
+            fresh = true;
+        }
+    }
+    else
+    {
+        uint32_t dind = node->i_block[EXT2_DIND_BLOCK];
+        struct BufferHead *dind_buff = (struct BufferHead *)0;
+        if (dind == 0 && allocate)
+        {
+            dind = block_map_new_pointer_block(map, goal);
+            node->i_block[EXT2_DIND_BLOCK] = dind;
+            if (dind != 0)
+            {
+                dind_buff = bcache_get_new(&ext2_cache, dind);
+                memset(dind_buff->data, 0, ext2_geo.block_size);
+                journal_dirty(dind_buff);
+            }
+        }
+        else if (dind != 0)
+        {
+            dind_buff = bcache_get(&ext2_cache, dind);
+        }
+        if (dind_buff == (struct BufferHead *)0)
+            return false;
+
+        uint32_t *dind_pointers = (uint32_t *)dind_buff->data;
+        leaf = dind_pointers[offsets[1]];
+        if (leaf == 0 && allocate)
+        {
+            leaf = block_map_new_pointer_block(map, goal);
+            dind_pointers[offsets[1]] = leaf;
+            journal_dirty(dind_buff);
+            fresh = true;
+        }
+        bcache_release(&ext2_cache, dind_buff);
+    }
+    if (leaf == 0)
+        return false;
+
+    block_map_flush(map);
+    if (fresh)
+        memset(map->pointers, 0, sizeof(map->pointers));
+    else if (bcache_read(&ext2_cache, map->pointers, leaf) != 0)
+    {
+        map->leaf_block = 0; // Leaf gagal dibaca, dicoba lagi pada akses berikutnya
+        return false;
+    }
+    map->leaf_block = leaf;
+    map->leaf_key = key;
+    map->dirty = fresh; // Leaf baru tetap harus ditulis walaupun tidak ada pointer yang dipasang
+    return true;
+}
+
+// Disk block dari block ke-index file, 0 jika belum dialokasikan
+static uint32_t block_map_get(struct EXT2BlockMap *map, uint32_t index)
+{
+    uint32_t offsets[3];
+    int8_t depth = file_block_path(index, offsets);
+    if (depth < 0)
+        return 0;
+    if (depth == 0)
+        return map->node->i_block[offsets[0]];
+    if (!block_map_load(map, depth, offsets, false, 0))
+        return 0;
+    return map->pointers[offsets[depth]];
+}
+
+/**
+ * Pasang disk block sebagai block ke-index file, block indirect dialokasikan di dekat block jika perlu.
+ * Perubahan pointer baru sampai ke buffer cache saat leaf berganti atau block_map_flush()
+ *
+ * @return false jika index di luar jangkauan doubly indirect atau disk penuh
+ */
+static bool block_map_set(struct EXT2BlockMap *map, uint32_t index, uint32_t block)
+{
+    uint32_t offsets[3];
+    int8_t depth = file_block_path(index, offsets);
+    if (depth < 0)
+        return false;
+    if (depth == 0)
+    {
+        map->node->i_block[offsets[0]] = block;
+        return true;
+    }
+    if (!block_map_load(map, depth, offsets, true, block))
+        return false;
+    map->pointers[offsets[depth]] = block;
+    map->dirty = true;
+    return true;
+}
+
+// Versi satu block dari block_map_set(), untuk pemanggil yang hanya memasang satu block
+static bool set_file_block(struct EXT2MemInode *node, uint32_t index, uint32_t block)
+{
+    struct EXT2BlockMap map;
+    block_map_init(&map, node);
+    bool success = block_map_set(&map, index, block);
+    block_map_flush(&map);
+    return success;
+}
+
+static void free_block(uint32_t block)
+{
+    set_block_used(block, false);
+    journal_revoke(block);
+    bcache_invalidate(&ext2_cache, block); // Isi block bebas tidak perlu ditulis
+}
+
+// Bebaskan block pointer beserta semua block yang ditunjuknya, depth 1 berisi pointer ke block data
+static void free_pointer_block(uint32_t block, uint32_t depth)
+{
+    struct BufferHead *pointer_buff = bcache_get(&ext2_cache, block);
+    uint32_t *blocks = (uint32_t *)pointer_buff->data;
+    for (uint32_t i = 0; i < ext2_geo.pointers_per_block; i++)
+    {
+        if (blocks[i] == 0)
+            continue;
+        if (depth > 1)
+            free_pointer_block(blocks[i], depth - 1);
+        else
+            free_block(blocks[i]);
+    }
+    bcache_release(&ext2_cache, pointer_buff);
+    free_block(block);
+}
+
+// Bebaskan semua block data & block indirect milik inode, termasuk window preallocation
+static void free_file_blocks(struct EXT2MemInode *node)
+{
+    prealloc_discard(node);
+    if (node->i_flags & EXT2_INLINE_DATA_FL)
+    {
+        // Isi i_block adalah data file, bukan nomor block
+        memset(node->i_block, 0, sizeof(node->i_block));
+        node->i_flags &= ~EXT2_INLINE_DATA_FL;
+    }
+    for (uint32_t i = 0; i < EXT2_NDIR_BLOCKS; i++)
+    {
+        if (node->i_block[i] != 0)
+            free_block(node->i_block[i]);
+        node->i_block[i] = 0;
+    }
+
+    if (node->i_block[EXT2_IND_BLOCK] != 0)
+        free_pointer_block(node->i_block[EXT2_IND_BLOCK], 1);
+    if (node->i_block[EXT2_DIND_BLOCK] != 0)
+        free_pointer_block(node->i_block[EXT2_DIND_BLOCK], 2);
+    node->i_block[EXT2_IND_BLOCK] = 0;
+    node->i_block[EXT2_DIND_BLOCK] = 0;
+    node->i_blocks = 0;
+}
+
+// Range yang seluruhnya nol tidak perlu block, dibaca kembali sebagai hole
+static bool is_zero_range(const uint8_t *data, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (data[i] != 0)
+            return false;
+    }
+    return true;
+}
+
+bool allocate_node_blocks(void *ptr, struct EXT2MemInode *node, uint32_t size)
+{
+    // Seluruh file diminta sebagai satu extent, pointer block ditulis sekali per leaf lewat block map
+    struct EXT2BlockMap map;
+    block_map_init(&map, node);
+    uint32_t blocks_needed = (size + ext2_geo.block_size - 1) / ext2_geo.block_size;
+    uint32_t previous = 0;
+    bool success = true;
+    for (uint32_t i = 0; i < blocks_needed; i++)
+    {
+        uint32_t offset = i * ext2_geo.block_size;
+        uint32_t bytes_to_write = size - offset < ext2_geo.block_size ? size - offset : ext2_geo.block_size;
+        if (is_zero_range((uint8_t *)ptr + offset, bytes_to_write))
+            continue; // Hole, pointer tetap 0
+
+        uint32_t block = allocate_file_block(node, file_block_goal(node, previous), blocks_needed - i);
+        if (block == 0 || !block_map_set(&map, i, block))
+        {
+            if (block != 0)
+                free_block(block);
+            success = false;
+            break;
+        }
+        node->i_blocks += ext2_geo.block_size / 512;
+        previous = block;
+
+        // Block baru ditimpa penuh, tidak perlu dibaca dari disk
+        struct BufferHead *write_buff = bcache_get_new(&ext2_cache, block);
+        memset(write_buff->data, 0, ext2_geo.block_size);
+        memcpy(write_buff->data, (uint8_t *)ptr + offset, bytes_to_write);
+        bcache_mark_dirty(&ext2_cache, write_buff);
+        bcache_release(&ext2_cache, write_buff);
+    }
+    block_map_flush(&map);
+    return success;
+}
+
+/**
+ * Pindahkan isi inline file ke block data pertama, dipanggil sebelum file tumbuh melewati EXT2_INLINE_DATA_MAX
+ *
+ * @param remaining Jumlah block yang akan dimiliki file, untuk ukuran window preallocation
+ * @return false jika disk penuh, file tetap inline
+ */
+static bool inline_data_expand(struct EXT2MemInode *node, uint32_t remaining)
+{
+    uint32_t block = allocate_file_block(node, file_block_goal(node, 0), remaining);
+    if (block == 0)
+        return false;
+
+    struct BufferHead *data_buff = bcache_get_new(&ext2_cache, block);
+    memset(data_buff->data, 0, ext2_geo.block_size);
+    memcpy(data_buff->data, node->i_block, node->i_size);
+    bcache_mark_dirty(&ext2_cache, data_buff);
+    bcache_release(&ext2_cache, data_buff);
+
+    memset(node->i_block, 0, sizeof(node->i_block));
+    node->i_block[0] = block;
+    node->i_blocks = ext2_geo.block_size / 512;
+    node->i_flags &= ~EXT2_INLINE_DATA_FL;
+    inode_mark_dirty(node);
+    return true;
+}
+
+/* =================== DIRECTORY ENTRY CACHE ============================*/
+
+#define EXT2_DCACHE_SIZE        64
+#define EXT2_DCACHE_BUCKETS     32 // Power of two
+#define EXT2_DCACHE_NAME_LENGTH 32 // Nama yang lebih panjang tidak di-cache
+
+/**
+ * EXT2Dentry, hasil lookup satu nama di satu direktori
+ *
+ * @param parent_inode Direktori tempat nama dicari, 0 jika slot kosong
+ * @param hash         Hash nama, dibandingkan sebelum memcmp
+ * @param inode        Inode hasil lookup, 0 untuk negative entry (nama tidak ada)
+ * @param file_type    file_type dari directory entry
+ * @param name_len     Panjang nama
+ * @param name         Nama, tidak null terminated
+ * @param last_used    Nilai clock saat terakhir dipakai, slot paling lama diganti
+ * @param hash_next    Entry berikutnya di bucket yang sama
+ */
+struct EXT2Dentry
+{
+    uint32_t parent_inode;
+    uint32_t hash;
+    uint32_t inode;
+    uint8_t file_type;
+    uint8_t name_len;
+    char name[EXT2_DCACHE_NAME_LENGTH];
+    uint32_t last_used;
+    struct EXT2Dentry *hash_next;
+};
+
+/**
+ * EXT2DentryCache, cache lookup nama, bucket dari hash nama dan inode parent
+ *
+ * @param entries Pool entry
+ * @param hash    Head bucket
+ * @param clock   Bertambah tiap lookup
+ * @param hits    Lookup yang dijawab cache, termasuk negative entry
+ * @param misses  Lookup yang membaca block direktori
+ */
+struct EXT2DentryCache
+{
+    struct EXT2Dentry entries[EXT2_DCACHE_SIZE];
+    struct EXT2Dentry *hash[EXT2_DCACHE_BUCKETS];
+    uint32_t clock;
+    uint32_t hits;
+    uint32_t misses;
+};
+
+static struct EXT2DentryCache ext2_dcache;
+
+static void dcache_init(void)
+{
+    memset(&ext2_dcache, 0, sizeof(ext2_dcache));
+}
+
+// FNV-1a
+static uint32_t dcache_hash(const char *name, uint8_t name_len)
+{
+    uint32_t hash = 2166136261u;
+    for (uint8_t i = 0; i < name_len; i++)
+    {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static struct EXT2Dentry **dcache_bucket(uint32_t parent_inode, uint32_t hash)
+{
+    return &ext2_dcache.hash[(hash ^ parent_inode) & (EXT2_DCACHE_BUCKETS - 1)];
+}
+
+static struct EXT2Dentry *dcache_find(uint32_t parent_inode, const char *name, uint8_t name_len, uint32_t hash)
+{
+    for (struct EXT2Dentry *dentry = *dcache_bucket(parent_inode, hash); dentry != (struct EXT2Dentry *)0; dentry = dentry->hash_next)
+    {
+        if (dentry->parent_inode == parent_inode && dentry->hash == hash && dentry->name_len == name_len && memcmp(dentry->name, name, name_len) == 0)
+        {
+            dentry->last_used = ++ext2_dcache.clock;
+            return dentry;
+        }
+    }
+    return (struct EXT2Dentry *)0;
+}
+
+static void dcache_unhash(struct EXT2Dentry *dentry)
+{
+    struct EXT2Dentry **link = dcache_bucket(dentry->parent_inode, dentry->hash);
+    while (*link != dentry)
+        link = &(*link)->hash_next;
+    *link = dentry->hash_next;
+    dentry->hash_next = (struct EXT2Dentry *)0;
+    dentry->parent_inode = 0;
+}
+
+// Simpan hasil lookup, inode 0 menyimpan negative entry
+static void dcache_store(uint32_t parent_inode, const char *name, uint8_t name_len, uint32_t inode, uint8_t file_type)
+{
+    if (name_len > EXT2_DCACHE_NAME_LENGTH)
+        return;
+
+    uint32_t hash = dcache_hash(name, name_len);
+    struct EXT2Dentry *dentry = dcache_find(parent_inode, name, name_len, hash);
+    if (dentry == (struct EXT2Dentry *)0)
+    {
+        dentry = &ext2_dcache.entries[0];
+        for (uint32_t i = 1; i < EXT2_DCACHE_SIZE; i++)
+        {
+            if (ext2_dcache.entries[i].last_used < dentry->last_used)
+                dentry = &ext2_dcache.entries[i];
+        }
+        if (dentry->parent_inode != 0)
+            dcache_unhash(dentry);
+
+        struct EXT2Dentry **bucket = dcache_bucket(parent_inode, hash);
+        dentry->parent_inode = parent_inode;
+        dentry->hash = hash;
+        dentry->name_len = name_len;
+        memcpy(dentry->name, name, name_len);
+        dentry->last_used = ++ext2_dcache.clock;
+        dentry->hash_next = *bucket;
+        *bucket = dentry;
+    }
+    dentry->inode = inode;
+    dentry->file_type = file_type;
+}
+
+// Direktori dihapus, inode bisa dipakai ulang direktori lain sehingga seluruh isinya dibuang
+static void dcache_forget_directory(uint32_t dir_inode)
+{
+    for (uint32_t i = 0; i < EXT2_DCACHE_SIZE; i++)
+    {
+        struct EXT2Dentry *dentry = &ext2_dcache.entries[i];
+        if (dentry->parent_inode == dir_inode)
+        {
+            dcache_unhash(dentry);
+            dentry->last_used = 0;
+        }
+    }
+}
+
+/* =================== DIRECTORY BLOCK OPERATIONS ============================*/
+
+#define EXT2_DIR_MAX_ENTRIES (EXT2_MAX_BLOCK_SIZE / 12) // Entry terkecil 12 byte (8 byte header + nama 1 - 4 karakter)
+
+// Hash nama untuk htree, bit 0 dipakai sebagai tanda lanjutan di EXT2DxEntry
+static uint32_t dx_hash(const char *name, uint8_t name_len)
+{
+    return dcache_hash(name, name_len) & ~1u;
+}
+
+static uint32_t dx_count(struct EXT2DxRoot *root)
+{
+    return root->entries[0].hash >> 16;
+}
+
+static void dx_set_count(struct EXT2DxRoot *root, uint32_t count)
+{
+    root->entries[0].hash = (count << 16) | EXT2_DX_ROOT_LIMIT(ext2_geo.block_size);
+}
+
+// Binary search index entry terakhir dengan hash <= hash, entries[0] mencakup hash 0
+static uint32_t dx_find_leaf(struct EXT2DxRoot *root, uint32_t hash)
+{
+    uint32_t low = 1;
+    uint32_t high = dx_count(root);
+    while (low < high)
+    {
+        uint32_t mid = (low + high) / 2;
+        if (root->entries[mid].hash > hash)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low - 1;
+}
+
+static bool dir_block_find(uint8_t *buf, const char *name, uint8_t name_len, struct EXT2DirectoryEntry *result)
+{
+    uint32_t offset = 0;
+    while (offset < ext2_geo.block_size)
+    {
+        struct EXT2DirectoryEntry *entry = get_directory_entry(buf, offset);
+        if (entry->rec_len == 0)
+            break;
+
+        if (entry->inode != 0 && entry->name_len == name_len && memcmp(get_entry_name(entry), name, name_len) == 0)
+        {
+            memcpy(result, entry, sizeof(struct EXT2DirectoryEntry));
+            return true;
+        }
+        offset += entry->rec_len;
+    }
+    return false;
+}
+
+// Isi celah pertama yang cukup: entry kosong, atau sisa rec_len di belakang entry hidup
+static bool dir_block_insert(uint8_t *buf, uint32_t inode, const char *name, uint8_t name_len, uint8_t file_type)
+{
+    uint16_t needed = get_entry_record_len(name_len);
+    struct EXT2DirectoryEntry *entry = get_directory_entry(buf, 0);
+    if (entry->rec_len == 0)
+    {
+        // Block belum pernah diisi, jadikan satu entry kosong selebar block
+        entry->inode = 0;
+        entry->rec_len = ext2_geo.block_size;
+    }
+
+    uint32_t offset = 0;
+    while (offset < ext2_geo.block_size)
+    {
+        entry = get_directory_entry(buf, offset);
+        if (entry->rec_len == 0)
+            break;
+
+        uint16_t used = entry->inode == 0 ? 0 : get_entry_record_len(entry->name_len);
+        if (entry->rec_len - used >= needed)
+        {
+            if (used > 0)
+            {
+                struct EXT2DirectoryEntry *gap = get_directory_entry(buf, offset + used);
+                gap->rec_len = entry->rec_len - used;
+                entry->rec_len = used;
+                entry = gap;
+            }
+            entry->inode = inode;
+            entry->name_len = name_len;
+            entry->file_type = file_type;
+            memcpy(get_entry_name(entry), name, name_len);
+            return true;
+        }
+        offset += entry->rec_len;
+    }
+    return false;
+}
+
+// Entry digabung ke entry sebelumnya, entry pertama block cukup ditandai kosong
+static bool dir_block_remove(uint8_t *buf, const char *name, uint8_t name_len)
+{
+    struct EXT2DirectoryEntry *prev_entry = (struct EXT2DirectoryEntry *)0;
+    uint32_t offset = 0;
+    while (offset < ext2_geo.block_size)
+    {
+        struct EXT2DirectoryEntry *entry = get_directory_entry(buf, offset);
+        if (entry->rec_len == 0)
+            break;
+
+        if (entry->inode != 0 && entry->name_len == name_len && memcmp(get_entry_name(entry), name, name_len) == 0)
+        {
+            if (prev_entry != (struct EXT2DirectoryEntry *)0)
+                prev_entry->rec_len += entry->rec_len;
+            else
+                entry->inode = 0;
+            return true;
+        }
+        prev_entry = entry;
+        offset += entry->rec_len;
+    }
+    return false;
+}
+
+// Block kosong baru di akhir direktori, dikembalikan dalam keadaan di-pin
+static struct BufferHead *dir_append_block(struct EXT2MemInode *dir_node, uint32_t *index)
+{
+    *index = dir_node->i_size / ext2_geo.block_size;
+    uint32_t previous = *index > 0 ? get_file_block(dir_node, *index - 1) : 0;
+    uint32_t block = allocate_file_block(dir_node, file_block_goal(dir_node, previous), 1);
+    if (block == 0)
+        return (struct BufferHead *)0;
+
+    if (!set_file_block(dir_node, *index, block))
+    {
+        set_block_used(block, false);
+        return (struct BufferHead *)0;
+    }
+    dir_node->i_size += ext2_geo.block_size;
+    dir_node->i_blocks += ext2_geo.block_size / 512;
+
+    struct BufferHead *dir_buff = bcache_get_new(&ext2_cache, block);
+    memset(dir_buff->data, 0, ext2_geo.block_size);
+    journal_dirty(dir_buff);
+    return dir_buff;
+}
+
+/**
+ * Leaf penuh dibagi dua berdasarkan urutan hash, separuh atas pindah ke block baru di akhir
+ * direktori dan index entry baru disisipkan tepat setelah leaf lama
+ *
+ * @return false jika index root penuh atau disk penuh
+ */
+static bool dx_split_leaf(struct EXT2MemInode *dir_node, struct EXT2DxRoot *root, uint32_t leaf)
+{
+    uint32_t count = dx_count(root);
+    if (count >= EXT2_DX_ROOT_LIMIT(ext2_geo.block_size))
+        return false;
+
+    struct BufferHead *old_buff = bcache_get(&ext2_cache, get_file_block(dir_node, root->entries[leaf].block));
+    uint8_t old_copy[EXT2_MAX_BLOCK_SIZE];
+    memcpy(old_copy, old_buff->data, ext2_geo.block_size);
+
+    // Insertion sort entry hidup berdasarkan hash, paling banyak satu block
+    uint32_t hashes[EXT2_DIR_MAX_ENTRIES];
+    uint16_t offsets[EXT2_DIR_MAX_ENTRIES];
+    uint32_t entries = 0;
+    uint32_t offset = 0;
+    while (offset < ext2_geo.block_size && entries < EXT2_DIR_MAX_ENTRIES)
+    {
+        struct EXT2DirectoryEntry *entry = get_directory_entry(old_copy, offset);
+        if (entry->rec_len == 0)
+            break;
+        if (entry->inode != 0)
+        {
+            uint32_t hash = dx_hash(get_entry_name(entry), entry->name_len);
+            uint32_t i = entries++;
+            while (i > 0 && hashes[i - 1] > hash)
+            {
+                hashes[i] = hashes[i - 1];
+                offsets[i] = offsets[i - 1];
+                i--;
+            }
+            hashes[i] = hash;
+            offsets[i] = offset;
+        }
+        offset += entry->rec_len;
+    }
+    if (entries < 2)
+    {
+        bcache_release(&ext2_cache, old_buff);
+        return false;
+    }
+
+    uint32_t new_index;
+    struct BufferHead *new_buff = dir_append_block(dir_node, &new_index);
+    if (new_buff == (struct BufferHead *)0)
+    {
+        bcache_release(&ext2_cache, old_buff);
+        return false;
+    }
+
+    uint32_t split = entries / 2;
+    uint32_t continued = hashes[split - 1] == hashes[split] ? 1 : 0;
+    memset(old_buff->data, 0, ext2_geo.block_size);
+    for (uint32_t i = 0; i < entries; i++)
+    {
+        struct EXT2DirectoryEntry *entry = get_directory_entry(old_copy, offsets[i]);
+        uint8_t *target = i < split ? old_buff->data : new_buff->data;
+        dir_block_insert(target, entry->inode, get_entry_name(entry), entry->name_len, entry->file_type);
+    }
+    journal_dirty(old_buff);
+    journal_dirty(new_buff);
+    bcache_release(&ext2_cache, old_buff);
+    bcache_release(&ext2_cache, new_buff);
+
+    for (uint32_t i = count; i > leaf + 1; i--)
+        root->entries[i] = root->entries[i - 1];
+    root->entries[leaf + 1].hash = hashes[split] | continued;
+    root->entries[leaf + 1].block = new_index;
+    dx_set_count(root, count + 1);
+    return true;
+}
+
+// Direktori linear yang penuh diubah jadi htree: isi block 0 pindah ke leaf baru, block 0 jadi EXT2DxRoot
+static bool dx_make_indexed(struct EXT2MemInode *dir_node, uint32_t dir_inode)
+{
+    uint32_t leaf_index;
+    struct BufferHead *leaf_buff = dir_append_block(dir_node, &leaf_index);
+    if (leaf_buff == (struct BufferHead *)0)
+        return false;
+
+    struct BufferHead *root_buff = bcache_get(&ext2_cache, get_file_block(dir_node, 0));
+    uint32_t parent_inode = dir_inode;
+    uint32_t offset = 0;
+    while (offset < ext2_geo.block_size)
+    {
+        struct EXT2DirectoryEntry *entry = get_directory_entry(root_buff->data, offset);
+        if (entry->rec_len == 0)
+            break;
+        if (entry->inode != 0 && !is_dot_entry(entry))
+            dir_block_insert(leaf_buff->data, entry->inode, get_entry_name(entry), entry->name_len, entry->file_type);
+        else if (entry->inode != 0 && entry->name_len == 2)
+            parent_inode = entry->inode;
+        offset += entry->rec_len;
+    }
+    journal_dirty(leaf_buff);
+    bcache_release(&ext2_cache, leaf_buff);
+
+    memset(root_buff->data, 0, ext2_geo.block_size);
+    struct EXT2DxRoot *root = (struct EXT2DxRoot *)root_buff->data;
+    root->dot.inode = dir_inode;
+    root->dot.rec_len = get_entry_record_len(1);
+    root->dot.name_len = 1;
+    root->dot.file_type = EXT2_FT_DIR;
+    root->dot_name[0] = '.';
+    root->dotdot.inode = parent_inode;
+    root->dotdot.rec_len = ext2_geo.block_size - get_entry_record_len(1);
+    root->dotdot.name_len = 2;
+    root->dotdot.file_type = EXT2_FT_DIR;
+    root->dotdot_name[0] = '.';
+    root->dotdot_name[1] = '.';
+    root->hash_version = EXT2_DX_HASH_FNV1A;
+    root->info_length = 8;
+    root->indirect_levels = 0;
+    dx_set_count(root, 1);
+    root->entries[0].block = leaf_index;
+    journal_dirty(root_buff);
+    bcache_release(&ext2_cache, root_buff);
+
+    dir_node->i_flags |= EXT2_INDEX_FL;
+    return true;
+}
+
+static bool dir_find_entry(struct EXT2MemInode *dir_node, const char *name, uint8_t name_len, struct EXT2DirectoryEntry *result)
+{
+    bool found = false;
+    if (dir_node->i_flags & EXT2_INDEX_FL)
+    {
+        // Hanya leaf dengan range hash yang cocok dibaca, ditambah leaf lanjutan jika hash bertabrakan
+        uint32_t hash = dx_hash(name, name_len);
+        struct BufferHead *root_buff = bcache_get(&ext2_cache, get_file_block(dir_node, 0));
+        struct EXT2DxRoot *root = (struct EXT2DxRoot *)root_buff->data;
+        if (is_dot_name(name, name_len))
+        {
+            // "." dan ".." berada di block root, bukan di leaf
+            found = dir_block_find(root_buff->data, name, name_len, result);
+            bcache_release(&ext2_cache, root_buff);
+            return found;
+        }
+        for (uint32_t leaf = dx_find_leaf(root, hash); !found && leaf < dx_count(root); leaf++)
+        {
+            if (leaf > 0 && root->entries[leaf].hash > hash && root->entries[leaf].hash != (hash | 1))
+                break;
+            struct BufferHead *leaf_buff = bcache_get(&ext2_cache, get_file_block(dir_node, root->entries[leaf].block));
+            found = dir_block_find(leaf_buff->data, name, name_len, result);
+            bcache_release(&ext2_cache, leaf_buff);
+        }
+        bcache_release(&ext2_cache, root_buff);
+        return found;
+    }
+
+    uint32_t dir_blocks = dir_node->i_size / ext2_geo.block_size;
+    for (uint32_t i = 0; i < dir_blocks && !found; i++)
+    {
+        uint32_t block = get_file_block(dir_node, i);
+        if (block == 0)
+            continue;
+        struct BufferHead *dir_buff = bcache_get(&ext2_cache, block);
+        found = dir_block_find(dir_buff->data, name, name_len, result);
+        bcache_release(&ext2_cache, dir_buff);
+    }
+    return found;
+}
+
+/**
+ * Tambah entry ke direktori. Direktori linear memakai celah pertama yang cukup di block mana pun
+ * dan diubah jadi htree saat penuh. Direktori htree mengisi leaf sesuai hash, leaf penuh dibagi dua.
+ *
+ * @return false jika direktori atau disk penuh
+ */
+static bool dir_add_entry(struct EXT2MemInode *dir_node, uint32_t dir_inode, const char *name, uint8_t name_len, uint32_t inode, uint8_t file_type)
+{
+    inode_mark_dirty(dir_node);
+    if (!(dir_node->i_flags & EXT2_INDEX_FL))
+    {
+        uint32_t dir_blocks = dir_node->i_size / ext2_geo.block_size;
+        for (uint32_t i = 0; i < dir_blocks; i++)
+        {
+            uint32_t block = get_file_block(dir_node, i);
+            if (block == 0)
+                continue;
+            struct BufferHead *dir_buff = bcache_get(&ext2_cache, block);
+            bool added = dir_block_insert(dir_buff->data, inode, name, name_len, file_type);
+            if (added)
+                journal_dirty(dir_buff);
+            bcache_release(&ext2_cache, dir_buff);
+            if (added)
+                return true;
+        }
+
+        if (!dx_make_indexed(dir_node, dir_inode))
+            return false;
+    }
+
+    uint32_t hash = dx_hash(name, name_len);
+    struct BufferHead *root_buff = bcache_get(&ext2_cache, get_file_block(dir_node, 0));
+    struct EXT2DxRoot *root = (struct EXT2DxRoot *)root_buff->data;
+    bool added = false;
+    for (uint32_t attempt = 0; attempt < 2; attempt++)
+    {
+        uint32_t leaf = dx_find_leaf(root, hash);
+        struct BufferHead *leaf_buff = bcache_get(&ext2_cache, get_file_block(dir_node, root->entries[leaf].block));
+        added = dir_block_insert(leaf_buff->data, inode, name, name_len, file_type);
+        if (added)
+            journal_dirty(leaf_buff);
+        bcache_release(&ext2_cache, leaf_buff);
+
+        if (added || attempt > 0 || !dx_split_leaf(dir_node, root, leaf))
+            break;
+        journal_dirty(root_buff);
+    }
+    bcache_release(&ext2_cache, root_buff);
+    return added;
+}
+
+static bool dir_remove_entry(struct EXT2MemInode *dir_node, const char *name, uint8_t name_len)
+{
+    bool removed = false;
+    if (dir_node->i_flags & EXT2_INDEX_FL)
+    {
+        uint32_t hash = dx_hash(name, name_len);
+        struct BufferHead *root_buff = bcache_get(&ext2_cache, get_file_block(dir_node, 0));
+        struct EXT2DxRoot *root = (struct EXT2DxRoot *)root_buff->data;
+        for (uint32_t leaf = dx_find_leaf(root, hash); !removed && leaf < dx_count(root); leaf++)
+        {
+            if (leaf > 0 && root->entries[leaf].hash > hash && root->entries[leaf].hash != (hash | 1))
+                break;
+            struct BufferHead *leaf_buff = bcache_get(&ext2_cache, get_file_block(dir_node, root->entries[leaf].block));
+            removed = dir_block_remove(leaf_buff->data, name, name_len);
+            if (removed)
+                journal_dirty(leaf_buff);
+            bcache_release(&ext2_cache, leaf_buff);
+        }
+        bcache_release(&ext2_cache, root_buff);
+        return removed;
+    }
+
+    uint32_t dir_blocks = dir_node->i_size / ext2_geo.block_size;
+    for (uint32_t i = 0; i < dir_blocks && !removed; i++)
+    {
+        uint32_t block = get_file_block(dir_node, i);
+        if (block == 0)
+            continue;
+        struct BufferHead *dir_buff = bcache_get(&ext2_cache, block);
+        removed = dir_block_remove(dir_buff->data, name, name_len);
+        if (removed)
+            journal_dirty(dir_buff);
+        bcache_release(&ext2_cache, dir_buff);
+    }
+    return removed;
+}
+
+/* =================== DIRECTORY ENTRY OPERATIONS ============================*/
+
+struct EXT2DirectoryEntry *find_entry_in_dir(uint32_t dir_inode, char *name, uint8_t name_len)
+{
+    static struct EXT2DirectoryEntry found_entry;
+
+    uint32_t hash = dcache_hash(name, name_len);
+    struct EXT2Dentry *dentry = dcache_find(dir_inode, name, name_len, hash);
+    if (dentry != (struct EXT2Dentry *)0)
+    {
+        ext2_dcache.hits++;
+        if (dentry->inode == 0)
+            return (struct EXT2DirectoryEntry *)0; // Negative entry, nama sudah pasti tidak ada
+
+        found_entry.inode = dentry->inode;
+        found_entry.rec_len = get_entry_record_len(name_len);
+        found_entry.name_len = name_len;
+        found_entry.file_type = dentry->file_type;
+        return &found_entry;
+    }
+
+    struct EXT2MemInode *dir_node = iget(dir_inode);
+    if (dir_node == (struct EXT2MemInode *)0 || !(dir_node->i_mode & EXT2_S_IFDIR))
+    {
+        iput(dir_node);
+        return (struct EXT2DirectoryEntry *)0;
+    }
+    ext2_dcache.misses++;
+
+    // Direktori htree hanya membaca leaf sesuai hash, direktori linear di-scan langsung di buffer cache
+    bool found = dir_find_entry(dir_node, name, name_len, &found_entry);
+    iput(dir_node);
+
+    if (!found)
+    {
+        dcache_store(dir_inode, name, name_len, 0, EXT2_FT_UNKNOWN);
+        return (struct EXT2DirectoryEntry *)0;
+    }
+    dcache_store(dir_inode, name, name_len, found_entry.inode, found_entry.file_type);
+    return &found_entry;
+}
+
+int8_t lookup(struct EXT2DriverRequest *request)
+{
+    struct EXT2MemInode *dir_node = iget(request->parent_inode);
+    bool is_directory = dir_node != (struct EXT2MemInode *)0 && (dir_node->i_mode & EXT2_S_IFDIR);
+    iput(dir_node);
+    if (!is_directory)
+    {
+        return 2;
+    }
+
+    struct EXT2DirectoryEntry *entry = find_entry_in_dir(request->parent_inode, request->name, request->name_len);
+    if (entry == (struct EXT2DirectoryEntry *)0)
+    {
+        return 1;
+    }
+
+    if (request->buf != (void *)0 && request->buffer_size >= sizeof(struct EXT2DirectoryEntry))
+    {
+        memcpy(request->buf, entry, sizeof(struct EXT2DirectoryEntry));
+    }
+    return 0;
+}
+
+/* =================== READ OPERATIONS ============================*/
+
+#define EXT2_READAHEAD_SLOTS       8  // Jumlah file yang dilacak sekaligus
+#define EXT2_READAHEAD_MIN_WINDOW  4
+#define EXT2_READAHEAD_INIT_WINDOW 8
+#define EXT2_READAHEAD_MAX_WINDOW  32 // Seluruh window di-pin sekaligus, harus di bawah BCACHE_MIN_BUFFERS
+
+/**
+ * EXT2ReadAhead, state read-ahead satu file
+ *
+ * @param inode      Inode file, 0 jika slot kosong
+ * @param last_used  Nilai ext2_readahead_clock saat terakhir dipakai, slot paling lama diganti
+ * @param next_index Index block file berikutnya jika akses sekuensial
+ * @param window     Ukuran window berikutnya dalam block
+ * @param start      Index block pertama window terakhir
+ * @param size       Jumlah block window terakhir
+ * @param hits       Block window terakhir yang masih ada di cache saat dibaca
+ * @param misses     Block window terakhir yang sudah di-evict sebelum dibaca
+ */
+struct EXT2ReadAhead
+{
+    uint32_t inode;
+    uint32_t last_used;
+    uint32_t next_index;
+    uint32_t window;
+    uint32_t start;
+    uint32_t size;
+    uint32_t hits;
+    uint32_t misses;
+};
+
+static struct EXT2ReadAhead ext2_readahead[EXT2_READAHEAD_SLOTS];
+static uint32_t ext2_readahead_clock;
+
+static struct EXT2ReadAhead *readahead_state(uint32_t inode)
+{
+    struct EXT2ReadAhead *victim = &ext2_readahead[0];
+    ext2_readahead_clock++;
+    for (uint32_t i = 0; i < EXT2_READAHEAD_SLOTS; i++)
+    {
+        struct EXT2ReadAhead *ra = &ext2_readahead[i];
+        if (ra->inode == inode)
+        {
+            ra->last_used = ext2_readahead_clock;
+            return ra;
+        }
+        if (ra->last_used < victim->last_used)
+            victim = ra;
+    }
+
+    memset(victim, 0, sizeof(*victim));
+    victim->inode = inode;
+    victim->last_used = ext2_readahead_clock;
+    victim->window = EXT2_READAHEAD_INIT_WINDOW;
+    return victim;
+}
+
+// Inode dihapus, state lama tidak boleh dipakai file baru dengan inode yang sama
+static void readahead_forget(uint32_t inode)
+{
+    for (uint32_t i = 0; i < EXT2_READAHEAD_SLOTS; i++)
+    {
+        if (ext2_readahead[i].inode == inode)
+            memset(&ext2_readahead[i], 0, sizeof(ext2_readahead[i]));
+    }
+}
+
+/**
+ * Dipanggil sebelum block index dibaca. Jika index di luar window terakhir, window baru
+ * [index, index + window) di-queue sekaligus sehingga block bersebelahan jadi satu command.
+ * Window membesar 2x jika seluruh window terakhir terpakai dari cache, mengecil setengah
+ * jika ada block yang di-evict sebelum dibaca. Akses acak kembali ke window minimum.
+ *
+ * @param ra          State read-ahead file
+ * @param map         Block map file, dipakai bersama read() sehingga block indirect tidak dibaca ulang
+ * @param index       Index block file yang akan dibaca
+ * @param file_blocks Jumlah block file, read-ahead tidak melewati akhir file
+ */
+static void readahead_access(struct EXT2ReadAhead *ra, struct EXT2BlockMap *map, uint32_t index, uint32_t file_blocks)
+{
+    bool sequential = index == ra->next_index;
+    ra->next_index = index + 1;
+
+    if (ra->size > 0 && index >= ra->start && index < ra->start + ra->size)
+    {
+        if (bcache_cached(&ext2_cache, block_map_get(map, index)))
+            ra->hits++;
+        else
+            ra->misses++;
+        return;
+    }
+
+    if (!sequential)
+    {
+        ra->window = index == 0 ? EXT2_READAHEAD_INIT_WINDOW : EXT2_READAHEAD_MIN_WINDOW;
+    }
+    else if (ra->size > 0)
+    {
+        if (ra->misses > 0 && ra->window > EXT2_READAHEAD_MIN_WINDOW)
+            ra->window /= 2;
+        else if (ra->misses == 0 && ra->hits == ra->size && ra->window < EXT2_READAHEAD_MAX_WINDOW)
+            ra->window *= 2;
+    }
+
+    // Buffer tetap di-pin sampai unplug, data async belum ada sebelum itu
+    struct BufferHead *window_buff[EXT2_READAHEAD_MAX_WINDOW];
+    uint32_t count = 0;
+    blockdev_plug(ext2_device);
+    while (count < ra->window && index + count < file_blocks && bcache_unpinned(&ext2_cache) > EXT2_PIN_RESERVE)
+    {
+        uint32_t block = block_map_get(map, index + count);
+        if (block == 0)
+            break;
+        window_buff[count++] = bcache_get_async(&ext2_cache, block);
+    }
+    blockdev_unplug(ext2_device);
+    for (uint32_t i = 0; i < count; i++)
+        bcache_release(&ext2_cache, window_buff[i]);
+
+    ra->start = index;
+    ra->size = count;
+    ra->hits = 1; // Block index sendiri
+    ra->misses = 0;
+}
+
+/**
+ * Salin isi file mulai offset, block dibaca berurutan lewat cache dan read-ahead mengisi cache per window
+ * @param node Inode file yang di-pin caller
+ * @return Jumlah byte yang dibaca, berhenti di akhir file
+ */
+static uint32_t inode_read_at(struct EXT2MemInode *node, uint8_t *buf, uint32_t count, uint32_t offset)
+{
+    if (offset >= node->i_size)
+        return 0;
+    if (count > node->i_size - offset)
+        count = node->i_size - offset;
+
+    // Isi file inline sudah terbaca bersama inode table saat iget()
+    if (node->i_flags & EXT2_INLINE_DATA_FL)
+    {
+        memcpy(buf, (uint8_t *)node->i_block + offset, count);
+        return count;
+    }
+
+    struct EXT2BlockMap map;
+    block_map_init(&map, node);
+    struct EXT2ReadAhead *ra = readahead_state(node->inode);
+    uint32_t file_blocks = (node->i_size + ext2_geo.block_size - 1) / ext2_geo.block_size;
+    uint32_t bytes_read = 0;
+
+    for (uint32_t i = offset / ext2_geo.block_size; bytes_read < count; i++)
+    {
+        // Hanya block pertama yang bisa dimulai di tengah block
+        uint32_t block_offset = (offset + bytes_read) % ext2_geo.block_size;
+        uint32_t bytes_to_copy = ext2_geo.block_size - block_offset;
+        if (bytes_read + bytes_to_copy > count)
+        {
+            bytes_to_copy = count - bytes_read;
+        }
+
+        uint32_t block = block_map_get(&map, i);
+        if (block == 0)
+        {
+            // Hole dibaca sebagai nol tanpa I/O, akses setelahnya tetap dihitung sekuensial
+            memset(buf + bytes_read, 0, bytes_to_copy);
+            ra->next_index = i + 1;
+        }
+        else
+        {
+            readahead_access(ra, &map, i, file_blocks);
+            struct BufferHead *data_buff = bcache_get(&ext2_cache, block);
+            memcpy(buf + bytes_read, data_buff->data + block_offset, bytes_to_copy);
+            bcache_release(&ext2_cache, data_buff);
+        }
+        bytes_read += bytes_to_copy;
+    }
+    return bytes_read;
+}
+
+int8_t read(struct EXT2DriverRequest *request)
+{
+    if (request->parent_inode < 2)
+    {
+        return 4;
+    }
+
+    struct EXT2DirectoryEntry *entry = find_entry_in_dir(request->parent_inode, request->name, request->name_len);
+
+    if (entry == (struct EXT2DirectoryEntry *)0)
+    {
+        return 3;
+    }
+
+    if (entry->file_type != EXT2_FT_REG_FILE)
+    {
+        return 1;
+    }
+
+    struct EXT2MemInode *file_inode = iget(entry->inode);
+    if (file_inode == (struct EXT2MemInode *)0)
+    {
+        return -1;
+    }
+
+    uint32_t bytes_read = inode_read_at(file_inode, (uint8_t *)request->buf, request->buffer_size, 0);
+    iput(file_inode);
+
+    request->buffer_size = bytes_read;
+
+    return 0;
+}
+
+int8_t read_directory(struct EXT2DriverRequest *request)
+{
+    // Validasi
+    if (request->parent_inode < 2 || request->parent_inode > EXT2SB.s_inodes_count)
+    {
+        return 3; // Parent folder tidak dapat dibaca / invalid
+    }
 
-    struct EXT2Inode *inode_table = (struct EXT2Inode *)inode_buff.buf;
-    struct EXT2Inode *dir_inode = &inode_table[local_index];
+    // Baca inode parent
+    struct EXT2MemInode *dir_inode = iget(request->parent_inode);
+    if (dir_inode == (struct EXT2MemInode *)0)
+    {
+        return 3;
+    }
 
     // Cek tipe
     if (!(dir_inode->i_mode & EXT2_S_IFDIR))
     {
+        iput(dir_inode);
         return 1; // Bukan sebuah folder
     }
 
@@ -650,30 +2889,29 @@ int8_t read_directory(struct EXT2DriverRequest *request)
     }
 
     // Hitung jumlah blok yang diperlukan
-    uint32_t blocks_to_read = (bytes_to_read + BLOCK_SIZE - 1) / BLOCK_SIZE;
-
-    if (blocks_to_read > 12)
-        blocks_to_read = 12; // Implementasi ini hanya mendukung direct blocks
+    uint32_t blocks_to_read = (bytes_to_read + ext2_geo.block_size - 1) / ext2_geo.block_size;
 
     for (uint32_t i = 0; i < blocks_to_read; i++)
     {
-        if (dir_inode->i_block[i] == 0)
+        uint32_t block = get_file_block(dir_inode, i);
+        if (block == 0)
             break; // Berhenti jika blok tidak dialokasikan
 
-        struct BlockBuffer block_buff;
-        read_blocks(&block_buff, dir_inode->i_block[i], 1);
+        struct BufferHead *block_buff = bcache_get(&ext2_cache, block);
 
         // Tentukan berapa banyak yang harus disalin dari blok ini
-        uint32_t bytes_to_copy = BLOCK_SIZE;
+        uint32_t bytes_to_copy = ext2_geo.block_size;
         if (bytes_read + bytes_to_copy > bytes_to_read)
         {
             bytes_to_copy = bytes_to_read - bytes_read;
         }
 
         // Salin ke buffer request PADA OFFSET YANG BENAR
-        memcpy((uint8_t *)request->buf + bytes_read, block_buff.buf, bytes_to_copy);
+        memcpy((uint8_t *)request->buf + bytes_read, block_buff->data, bytes_to_copy);
         bytes_read += bytes_to_copy;
+        bcache_release(&ext2_cache, block_buff);
     }
+    iput(dir_inode);
 
     // Set ukuran file yang sebenarnya dibaca
     request->buffer_size = bytes_read;
@@ -681,16 +2919,125 @@ int8_t read_directory(struct EXT2DriverRequest *request)
     return 0; // Operasi berhasil
 }
 
+/**
+ * Isi size & mode entry get_dirents(). Inode di cache bisa lebih baru dari inode table sehingga dipakai lebih dulu,
+ * selain itu dibaca langsung dari block inode table tanpa mengisi inode cache. Block inode table terakhir tetap di-pin
+ * sehingga inode bersebelahan dalam satu batch hanya mengambil block itu sekali
+ * @param table_buff Block inode table yang sedang di-pin, NULL jika belum ada
+ */
+static void dirent_fill_stat(struct EXT2Dirent *dirent, struct BufferHead **table_buff)
+{
+    struct EXT2MemInode *node = icache_lookup(dirent->inode);
+    if (node != (struct EXT2MemInode *)0)
+    {
+        dirent->size = node->i_size;
+        dirent->mode = node->i_mode;
+        return;
+    }
+
+    uint32_t block = inode_table_block(dirent->inode);
+    if (*table_buff == (struct BufferHead *)0 || (*table_buff)->block != block)
+    {
+        if (*table_buff != (struct BufferHead *)0)
+            bcache_release(&ext2_cache, *table_buff);
+        *table_buff = bcache_get(&ext2_cache, block);
+    }
+    struct EXT2Inode *disk_node = &((struct EXT2Inode *)(*table_buff)->data)[inode_to_local(dirent->inode) % ext2_geo.inodes_per_block];
+    dirent->size = disk_node->i_size;
+    dirent->mode = disk_node->i_mode;
+}
+
+int8_t get_dirents(struct EXT2DirentRequest *request)
+{
+    if (request->dir_inode < 2 || request->dir_inode > EXT2SB.s_inodes_count)
+    {
+        return 3;
+    }
+    struct EXT2MemInode *dir_node = iget(request->dir_inode);
+    if (dir_node == (struct EXT2MemInode *)0)
+    {
+        return 3;
+    }
+    if (!(dir_node->i_mode & EXT2_S_IFDIR))
+    {
+        iput(dir_node);
+        return 1;
+    }
+
+    // Cookie adalah posisi byte di direktori. Block di-scan dari awal sehingga cookie yang tidak tepat di awal entry
+    // tetap mulai di entry berikutnya. Direktori htree juga bisa dibaca linear, isi block 0 hanya "." dan ".."
+    uint32_t position = request->cookie;
+    uint32_t filled = 0;
+    bool full = false;
+    struct BufferHead *table_buff = (struct BufferHead *)0;
+    while (position < dir_node->i_size && !full)
+    {
+        uint32_t index = position / ext2_geo.block_size;
+        uint32_t block_start = index * ext2_geo.block_size;
+        uint32_t block = get_file_block(dir_node, index);
+        if (block == 0)
+        {
+            position = block_start + ext2_geo.block_size;
+            continue;
+        }
+
+        struct BufferHead *dir_buff = bcache_get(&ext2_cache, block);
+        uint32_t offset = 0;
+        while (offset < ext2_geo.block_size)
+        {
+            struct EXT2DirectoryEntry *entry = get_directory_entry(dir_buff->data, offset);
+            if (entry->rec_len == 0)
+            {
+                offset = ext2_geo.block_size; // Block rusak, lanjut ke block berikutnya
+                break;
+            }
+            if (block_start + offset >= position && entry->inode != 0)
+            {
+                uint16_t rec_len = EXT2_DIRENT_LEN(entry->name_len);
+                if (filled + rec_len > request->buffer_size)
+                {
+                    full = true;
+                    break;
+                }
+                struct EXT2Dirent *dirent = (struct EXT2Dirent *)((uint8_t *)request->buf + filled);
+                dirent->inode = entry->inode;
+                dirent->rec_len = rec_len;
+                dirent->name_len = entry->name_len;
+                dirent->file_type = entry->file_type;
+                memcpy(get_dirent_name(dirent), get_entry_name(entry), entry->name_len);
+                get_dirent_name(dirent)[entry->name_len] = '\0';
+                dirent_fill_stat(dirent, &table_buff);
+                filled += rec_len;
+            }
+            offset += entry->rec_len;
+        }
+        bcache_release(&ext2_cache, dir_buff);
+        if (block_start + offset > position)
+            position = block_start + offset;
+    }
+    if (table_buff != (struct BufferHead *)0)
+        bcache_release(&ext2_cache, table_buff);
+    iput(dir_node);
+
+    if (full && filled == 0)
+    {
+        return 2; // Entry berikutnya tidak muat di buffer
+    }
+    request->buffer_size = filled;
+    request->cookie = position;
+    return 0;
+}
+
 /* =================== WRITE OPERATIONS ============================*/
 
 int8_t write(struct EXT2DriverRequest *request)
 {
     // Validasi parent inode
-    struct EXT2Inode parent_node;
-    read_inode(request->parent_inode, &parent_node);
+    struct EXT2MemInode *parent_node = iget(request->parent_inode);
 
-    if (!(parent_node.i_mode & EXT2_S_IFDIR))
+    if (parent_node == (struct EXT2MemInode *)0 || !(parent_node->i_mode & EXT2_S_IFDIR))
     {
+        iput(parent_node);
         return 2; // Parent bukan direktori
     }
 
@@ -702,209 +3049,711 @@ int8_t write(struct EXT2DriverRequest *request)
 
     if (existing != (struct EXT2DirectoryEntry *)0)
     {
+        iput(parent_node);
         return 1; // Entry sudah ada
     }
 
     // 3. Alokasi inode baru
-    uint32_t new_inode = allocate_inode();
+    uint32_t new_inode = allocate_inode_near(request->parent_inode, request->is_directory);
     if (new_inode == 0)
     {
+        iput(parent_node);
         return -1;
     }
 
-    struct EXT2Inode new_node;
-    memset(&new_node, 0, sizeof(new_node));
+    // Bitmap, data, inode table, parent dir, SB & BGDT ditulis sekaligus saat unplug
+    blockdev_plug(ext2_device);
+
+    // Inode baru ditimpa seluruhnya, isi lama di inode table tidak dipakai
+    struct EXT2MemInode *new_node = iget(new_inode);
+    if (new_node == (struct EXT2MemInode *)0)
+    {
+        iput(parent_node);
+        set_inode_used(new_inode, false);
+        blockdev_unplug(ext2_device);
+        return -1; // Semua slot inode cache di-pin
+    }
+    new_node->i_mode = 0;
+    new_node->i_size = 0;
+    new_node->i_blocks = 0;
+    new_node->i_flags = 0;
+    memset(new_node->i_block, 0, sizeof(new_node->i_block));
 
     if (request->is_directory)
     {
         // Buat direktori
-        new_node.i_mode = EXT2_S_IFDIR | 0755;
-        new_node.i_size = BLOCK_SIZE;
-        new_node.i_blocks = BLOCK_SIZE / 512;
+        new_node->i_mode = EXT2_S_IFDIR | 0755;
+        new_node->i_size = ext2_geo.block_size;
+        new_node->i_blocks = ext2_geo.block_size / 512;
 
-        uint32_t dir_block = allocate_block();
+        uint32_t dir_block = allocate_file_block(new_node, file_block_goal(new_node, 0), 1);
         if (dir_block == 0)
         {
+            iput(new_node);
+            iput(parent_node);
             set_inode_used(new_inode, false);
+            blockdev_unplug(ext2_device);
             return -1;
         }
 
-        new_node.i_block[0] = dir_block;
-        init_directory_table(&new_node, new_inode, request->parent_inode);
+        new_node->i_block[0] = dir_block;
+        init_directory_table(new_node, new_inode, request->parent_inode);
 
-        EXT2_BGDT.table[0].bg_used_dirs_count++;
+        EXT2_BGDT.table[inode_to_bgd(new_inode)].bg_used_dirs_count++;
     }
     else
     {
         // Buat file
-        new_node.i_mode = EXT2_S_IFREG | 0644;
-        new_node.i_size = request->buffer_size;
+        new_node->i_mode = EXT2_S_IFREG | 0644;
+        new_node->i_size = request->buffer_size;
 
-        uint32_t blocks_needed = (request->buffer_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
-        if (blocks_needed > 12)
-            blocks_needed = 12;
-        new_node.i_blocks = blocks_needed * (BLOCK_SIZE / 512);
-
-        uint32_t bytes_written = 0;
-        for (uint32_t i = 0; i < blocks_needed; i++)
+        // File kecil disimpan di i_block tanpa block data, file lebih besar lewat direct, single indirect
+        // lalu doubly indirect, i_blocks ikut menghitung block pointer
+        if (request->buffer_size > 0 && request->buffer_size <= EXT2_INLINE_DATA_MAX)
         {
-            uint32_t block_num = allocate_block();
-            if (block_num == 0)
-            {
-                for (uint32_t j = 0; j < i; j++)
-                    set_block_used(new_node.i_block[j], false);
-                set_inode_used(new_inode, false);
-                return -1;
-            }
+            memcpy(new_node->i_block, request->buf, request->buffer_size);
+            new_node->i_flags = EXT2_INLINE_DATA_FL;
+        }
+        else if (!allocate_node_blocks(request->buf, new_node, request->buffer_size))
+        {
+            free_file_blocks(new_node);
+            new_node->i_mode = 0;
+            new_node->i_size = 0;
+            inode_mark_dirty(new_node);
+            iput(new_node);
+            iput(parent_node);
+            set_inode_used(new_inode, false);
+            commit_metadata();
+            journal_commit(false);
+            blockdev_unplug(ext2_device);
+            return -1;
+        }
+    }
+
+    // File selesai ditulis, window preallocation file dilepas. Direktori tetap memegang window untuk block berikutnya
+    if (!request->is_directory)
+        prealloc_discard(new_node);
+
+    // 4. Tulis inode baru
+    // 5. Tambahkan entry ke parent directory, direktori bertambah block / jadi htree jika penuh
+    uint8_t file_type = request->is_directory ? EXT2_FT_DIR : EXT2_FT_REG_FILE;
+    bool added = dir_add_entry(parent_node, request->parent_inode, request->name, request->name_len, new_inode, file_type);
+    iput(parent_node);
+    if (added)
+    {
+        dcache_store(request->parent_inode, request->name, request->name_len, new_inode, file_type);
+    }
+    else
+    {
+        // Direktori atau disk penuh, inode & block baru dikembalikan
+        free_file_blocks(new_node);
+        new_node->i_mode = 0;
+        new_node->i_size = 0;
+        if (request->is_directory)
+            EXT2_BGDT.table[inode_to_bgd(new_inode)].bg_used_dirs_count--;
+        set_inode_used(new_inode, false);
+    }
+    inode_mark_dirty(new_node);
+    iput(new_node);
 
-            new_node.i_block[i] = block_num;
+    commit_metadata();
+    journal_commit(false);
+    blockdev_unplug(ext2_device);
 
-            struct BlockBuffer write_buff;
-            memset(&write_buff, 0, sizeof(write_buff));
+    return added ? 0 : -1;
+}
 
-            uint32_t bytes_to_write = BLOCK_SIZE;
-            if (bytes_written + bytes_to_write > request->buffer_size)
-                bytes_to_write = request->buffer_size - bytes_written;
+int8_t fallocate(struct EXT2DriverRequest *request)
+{
+    // File dibuat kosong lebih dulu jika belum ada
+    struct EXT2DirectoryEntry *entry = find_entry_in_dir(request->parent_inode, request->name, request->name_len);
+    if (entry == (struct EXT2DirectoryEntry *)0)
+    {
+        struct EXT2DriverRequest create_request = *request;
+        create_request.buffer_size = 0;
+        create_request.is_directory = false;
+        int8_t status = write(&create_request);
+        if (status != 0)
+            return status == 2 ? 2 : -1;
+        entry = find_entry_in_dir(request->parent_inode, request->name, request->name_len);
+        if (entry == (struct EXT2DirectoryEntry *)0)
+            return -1;
+    }
 
-            memcpy(write_buff.buf, (uint8_t *)request->buf + bytes_written, bytes_to_write);
-            write_blocks(&write_buff, block_num, 1);
-            bytes_written += bytes_to_write;
-        }
+    struct EXT2MemInode *node = iget(entry->inode);
+    if (node == (struct EXT2MemInode *)0 || !(node->i_mode & EXT2_S_IFREG))
+    {
+        iput(node);
+        return 1; // Bukan file
     }
 
-    // 4. Tulis inode baru
-    write_inode(new_inode, &new_node);
+    uint32_t blocks_used = (node->i_size + ext2_geo.block_size - 1) / ext2_geo.block_size;
+    uint32_t blocks_needed = (request->buffer_size + ext2_geo.block_size - 1) / ext2_geo.block_size;
 
-    // 5. Tambahkan entry ke parent directory
-    struct BlockBuffer parent_buff;
-    read_blocks(&parent_buff, parent_node.i_block[0], 1);
+    blockdev_plug(ext2_device);
 
-    uint32_t offset = 0;
-    struct EXT2DirectoryEntry *last_entry = (struct EXT2DirectoryEntry *)0;
+    // Isi inline pindah ke block pertama lebih dulu, block baru menyusul di belakangnya
+    int8_t status = 0;
+    if ((node->i_flags & EXT2_INLINE_DATA_FL) && request->buffer_size > node->i_size && !inline_data_expand(node, blocks_needed))
+        status = -1;
 
-    while (offset < BLOCK_SIZE)
+    // Block baru diminta sebagai satu extent tepat setelah block terakhir file, isinya nol
+    struct EXT2BlockMap map;
+    block_map_init(&map, node);
+    uint32_t allocated = blocks_used;
+    uint32_t previous = blocks_used > 0 ? block_map_get(&map, blocks_used - 1) : 0;
+    while (status == 0 && allocated < blocks_needed)
     {
-        struct EXT2DirectoryEntry *entry = (struct EXT2DirectoryEntry *)(parent_buff.buf + offset);
-        if (entry->rec_len == 0)
+        uint32_t block = allocate_file_block(node, file_block_goal(node, previous), blocks_needed - allocated);
+        if (block == 0 || !block_map_set(&map, allocated, block))
+        {
+            if (block != 0)
+                free_block(block);
+            status = -1;
             break;
-        last_entry = entry;
-        offset += entry->rec_len;
+        }
+
+        struct BufferHead *zero_buff = bcache_get_new(&ext2_cache, block);
+        memset(zero_buff->data, 0, ext2_geo.block_size);
+        bcache_mark_dirty(&ext2_cache, zero_buff);
+        bcache_release(&ext2_cache, zero_buff);
+        node->i_blocks += ext2_geo.block_size / 512;
+        previous = block;
+        allocated++;
     }
 
-    uint16_t new_rec_len = get_entry_record_len(request->name_len);
-    if (last_entry != (struct EXT2DirectoryEntry *)0)
+    if (status == 0)
     {
-        uint16_t actual_last_len = get_entry_record_len(last_entry->name_len);
-        uint16_t available_space = last_entry->rec_len - actual_last_len;
-        if (available_space >= new_rec_len)
+        if (request->buffer_size > node->i_size)
+            node->i_size = request->buffer_size;
+    }
+    else
+    {
+        // Disk penuh, block yang sudah dialokasikan dikembalikan
+        while (allocated > blocks_used)
         {
-            last_entry->rec_len = actual_last_len;
-            offset = ((uint8_t *)last_entry - parent_buff.buf) + actual_last_len;
+            allocated--;
+            free_block(block_map_get(&map, allocated));
+            block_map_set(&map, allocated, 0);
+            node->i_blocks -= ext2_geo.block_size / 512;
         }
     }
+    block_map_flush(&map);
+    prealloc_discard(node);
+    readahead_forget(node->inode);
+    inode_mark_dirty(node);
+    iput(node);
 
-    struct EXT2DirectoryEntry *new_entry = (struct EXT2DirectoryEntry *)(parent_buff.buf + offset);
-    new_entry->inode = new_inode;
-    new_entry->rec_len = BLOCK_SIZE - offset;
-    new_entry->name_len = request->name_len;
-    new_entry->file_type = request->is_directory ? EXT2_FT_DIR : EXT2_FT_REG_FILE;
-    memcpy(get_entry_name(new_entry), request->name, request->name_len);
-
-    write_blocks(&parent_buff, parent_node.i_block[0], 1);
     commit_metadata();
+    journal_commit(false);
+    blockdev_unplug(ext2_device);
 
-    return 0;
+    return status;
 }
 
-/* =================== DELETE OPERATIONS ============================*/
-
-int8_t delete(struct EXT2DriverRequest *request)
+/**
+ * Tulis count byte mulai offset ke file. Block yang sudah ada ditimpa di tempat (block yang hanya sebagian
+ * ditimpa dibaca dulu), block baru dialokasikan lewat window preallocation inode sehingga append berulang
+ * tetap contiguous. Celah antara akhir file lama dan offset dibiarkan sebagai hole, begitu juga block baru
+ * yang hanya akan berisi nol
+ *
+ * @param node Inode file yang di-pin caller
+ * @return Jumlah byte yang ditulis, kurang dari count jika disk penuh
+ */
+static uint32_t inode_write_at(struct EXT2MemInode *node, const uint8_t *buf, uint32_t count, uint32_t offset)
 {
-    // Validasi parent inode
-    struct EXT2Inode parent_node;
-    read_inode(request->parent_inode, &parent_node);
-
-    if (!(parent_node.i_mode & EXT2_S_IFDIR))
-    {
-        return 3; // Parent bukan direktori
-    }
+    if (offset + count < offset)
+        count = 0xFFFFFFFFu - offset; // Ukuran file tidak boleh melewati 4 GiB
 
-    // Find entry in directory
-    struct BlockBuffer parent_buff;
-    read_blocks(&parent_buff, parent_node.i_block[0], 1);
+    uint32_t first = offset / ext2_geo.block_size;
+    uint32_t last = (offset + count - 1) / ext2_geo.block_size;
 
-    uint32_t offset = 0;
-    struct EXT2DirectoryEntry *prev_entry = (struct EXT2DirectoryEntry *)0;
-    struct EXT2DirectoryEntry *target_entry = (struct EXT2DirectoryEntry *)0;
+    blockdev_plug(ext2_device);
 
-    while (offset < BLOCK_SIZE)
+    // File kosong atau inline tetap di i_block selama muat, byte setelah i_size di i_block selalu nol
+    bool empty = node->i_size == 0 && node->i_blocks == 0;
+    bool inline_data = (node->i_flags & EXT2_INLINE_DATA_FL) != 0;
+    if ((empty || inline_data) && offset + count <= EXT2_INLINE_DATA_MAX)
     {
-        struct EXT2DirectoryEntry *entry = (struct EXT2DirectoryEntry *)(parent_buff.buf + offset);
-
-        if (entry->rec_len == 0)
-            break;
+        node->i_flags |= EXT2_INLINE_DATA_FL;
+        memcpy((uint8_t *)node->i_block + offset, buf, count);
+        if (offset + count > node->i_size)
+            node->i_size = offset + count;
+        inode_mark_dirty(node);
+        commit_metadata();
+        journal_commit(false);
+        blockdev_unplug(ext2_device);
+        return count;
+    }
+    if (inline_data && !inline_data_expand(node, last + 1))
+    {
+        blockdev_unplug(ext2_device);
+        return 0;
+    }
 
-        if (entry->inode != 0 && entry->name_len == request->name_len)
+    struct EXT2BlockMap map;
+    block_map_init(&map, node);
+    uint32_t written = 0;
+    for (uint32_t i = first; i <= last; i++)
+    {
+        // Range byte [from, to) block yang ditimpa
+        uint32_t block_start = i * ext2_geo.block_size;
+        uint32_t from = i == first ? offset - block_start : 0;
+        uint32_t to = i == last ? offset + count - block_start : ext2_geo.block_size;
+        const uint8_t *source = buf + block_start + from - offset;
+
+        uint32_t block = block_map_get(&map, i);
+        bool fresh = block == 0;
+        if (fresh)
         {
-            char *entry_name = get_entry_name(entry);
-            if (memcmp(entry_name, request->name, request->name_len) == 0)
+            // Hole yang hanya ditimpa nol tetap hole
+            if (is_zero_range(source, to - from))
+            {
+                written += to - from;
+                continue;
+            }
+
+            uint32_t previous = i > 0 ? block_map_get(&map, i - 1) : 0;
+            block = allocate_file_block(node, file_block_goal(node, previous), last - i + 1);
+            if (block == 0 || !block_map_set(&map, i, block))
             {
-                target_entry = entry;
+                if (block != 0)
+                    free_block(block);
                 break;
             }
+            node->i_blocks += ext2_geo.block_size / 512;
         }
 
-        prev_entry = entry;
-        offset += entry->rec_len;
+        struct BufferHead *data_buff;
+        if (fresh || (from == 0 && to == ext2_geo.block_size))
+        {
+            data_buff = bcache_get_new(&ext2_cache, block);
+            if (fresh)
+                memset(data_buff->data, 0, ext2_geo.block_size);
+        }
+        else
+        {
+            data_buff = bcache_get(&ext2_cache, block);
+        }
+        memcpy(data_buff->data + from, source, to - from);
+        written += to - from;
+        bcache_mark_dirty(&ext2_cache, data_buff);
+        bcache_release(&ext2_cache, data_buff);
+    }
+    block_map_flush(&map);
+
+    if (written > 0 && offset + written > node->i_size)
+        node->i_size = offset + written;
+    inode_mark_dirty(node);
+    commit_metadata();
+    journal_commit(false);
+    blockdev_unplug(ext2_device);
+    return written;
+}
+
+/* =================== DELETE OPERATIONS ============================*/
+
+// Bebaskan block & inode file yang sudah tidak punya entry direktori
+static void release_inode(struct EXT2MemInode *node)
+{
+    free_file_blocks(node);
+    inode_mark_dirty(node);
+    set_inode_used(node->inode, false);
+    readahead_forget(node->inode);
+    node->unlinked = false;
+}
+
+int8_t delete(struct EXT2DriverRequest *request)
+{
+    // Validasi parent inode
+    struct EXT2MemInode *parent_node = iget(request->parent_inode);
+
+    if (parent_node == (struct EXT2MemInode *)0 || !(parent_node->i_mode & EXT2_S_IFDIR))
+    {
+        iput(parent_node);
+        return 3; // Parent bukan direktori
     }
 
-    if (target_entry == (struct EXT2DirectoryEntry *)0)
+    // Find entry in directory, "." dan ".." bukan entry yang bisa dihapus
+    struct EXT2DirectoryEntry *target_entry = find_entry_in_dir(request->parent_inode, request->name, request->name_len);
+    if (target_entry == (struct EXT2DirectoryEntry *)0 || is_dot_name(request->name, request->name_len))
     {
+        iput(parent_node);
         return 1; // Entry tidak ditemukan
     }
+    uint32_t target_inode = target_entry->inode;
 
     // Read target inode
-    struct EXT2Inode target_node;
-    read_inode(target_entry->inode, &target_node);
+    struct EXT2MemInode *target_node = iget(target_inode);
+    if (target_node == (struct EXT2MemInode *)0)
+    {
+        iput(parent_node);
+        return -1; // Semua slot inode cache di-pin
+    }
 
     // If directory, check if empty
-    if (target_node.i_mode & EXT2_S_IFDIR)
+    if (target_node->i_mode & EXT2_S_IFDIR)
     {
-        if (!is_directory_empty(target_entry->inode))
+        if (!is_directory_empty(target_inode))
         {
+            iput(target_node);
+            iput(parent_node);
             return 2; // Folder yang akan dihapus tidak kosong
         }
-        EXT2_BGDT.table[0].bg_used_dirs_count--;
+        EXT2_BGDT.table[inode_to_bgd(target_inode)].bg_used_dirs_count--;
+    }
+
+    blockdev_plug(ext2_device);
+
+    // Free all blocks (termasuk block indirect) & inode. File yang masih dibuka lewat file descriptor
+    // baru dibebaskan saat file_close() terakhir
+    if (target_node->refcount > 1)
+        target_node->unlinked = true;
+    else
+        release_inode(target_node);
+    iput(target_node);
+    dcache_forget_directory(target_inode);
+
+    // Remove entry from directory
+    dir_remove_entry(parent_node, request->name, request->name_len);
+    iput(parent_node);
+    dcache_store(request->parent_inode, request->name, request->name_len, 0, EXT2_FT_UNKNOWN);
+
+    // Commit metadata
+    commit_metadata();
+    journal_commit(false);
+    blockdev_unplug(ext2_device);
+
+    return 0; // Success
+}
+
+/* =================== FILE DESCRIPTOR OPERATIONS ============================*/
+
+static struct EXT2OpenFile *file_get(struct EXT2FileTable *table, int32_t fd)
+{
+    if (fd < 0 || fd >= EXT2_MAX_OPEN_FILES || table->files[fd].node == (struct EXT2MemInode *)0)
+        return (struct EXT2OpenFile *)0;
+    return &table->files[fd];
+}
+
+static void file_truncate(struct EXT2MemInode *node)
+{
+    blockdev_plug(ext2_device);
+    free_file_blocks(node);
+    node->i_size = 0;
+    inode_mark_dirty(node);
+    readahead_forget(node->inode);
+    commit_metadata();
+    journal_commit(false);
+    blockdev_unplug(ext2_device);
+}
+
+int32_t file_open(struct EXT2FileTable *table, struct EXT2DriverRequest *request, uint32_t flags)
+{
+    int32_t fd = 0;
+    while (fd < EXT2_MAX_OPEN_FILES && table->files[fd].node != (struct EXT2MemInode *)0)
+        fd++;
+    if (fd == EXT2_MAX_OPEN_FILES)
+        return -4;
+
+    struct EXT2MemInode *parent_node = iget(request->parent_inode);
+    bool is_directory = parent_node != (struct EXT2MemInode *)0 && (parent_node->i_mode & EXT2_S_IFDIR);
+    iput(parent_node);
+    if (!is_directory)
+        return -3;
+
+    // File kosong dibuat lewat write() jika diminta
+    struct EXT2DirectoryEntry *entry = find_entry_in_dir(request->parent_inode, request->name, request->name_len);
+    if (entry == (struct EXT2DirectoryEntry *)0)
+    {
+        if (!(flags & EXT2_O_CREAT))
+            return -1;
+        struct EXT2DriverRequest create_request = *request;
+        create_request.buffer_size = 0;
+        create_request.is_directory = false;
+        if (write(&create_request) != 0)
+            return -5;
+        entry = find_entry_in_dir(request->parent_inode, request->name, request->name_len);
+        if (entry == (struct EXT2DirectoryEntry *)0)
+            return -5;
     }
+    if (entry->file_type != EXT2_FT_REG_FILE)
+        return -2;
 
-    // Free all blocks
-    for (uint32_t i = 0; i < 12; i++)
+    struct EXT2MemInode *node = iget(entry->inode);
+    if (node == (struct EXT2MemInode *)0)
+        return -5; // Semua slot inode cache di-pin
+
+    if ((flags & EXT2_O_TRUNC) && (flags & EXT2_O_ACCMODE) != EXT2_O_RDONLY && node->i_size > 0)
+        file_truncate(node);
+
+    table->files[fd].node = node;
+    table->files[fd].offset = 0;
+    table->files[fd].flags = flags;
+    return fd;
+}
+
+int8_t file_close(struct EXT2FileTable *table, int32_t fd)
+{
+    struct EXT2OpenFile *file = file_get(table, fd);
+    if (file == (struct EXT2OpenFile *)0)
+        return 1;
+
+    struct EXT2MemInode *node = file->node;
+    file->node = (struct EXT2MemInode *)0;
+    if (node->refcount == 1)
     {
-        if (target_node.i_block[i] != 0)
+        // Close terakhir: sisa window append dilepas, file yang sudah dihapus akhirnya dibebaskan
+        prealloc_discard(node);
+        if (node->unlinked)
         {
-            set_block_used(target_node.i_block[i], false);
+            blockdev_plug(ext2_device);
+            release_inode(node);
+            commit_metadata();
+            journal_commit(false);
+            blockdev_unplug(ext2_device);
         }
     }
+    iput(node);
+    return 0;
+}
 
-    // Free inode
-    set_inode_used(target_entry->inode, false);
+void file_close_all(struct EXT2FileTable *table)
+{
+    for (int32_t fd = 0; fd < EXT2_MAX_OPEN_FILES; fd++)
+        file_close(table, fd);
+}
 
-    // Remove entry from directory
-    if (prev_entry != (struct EXT2DirectoryEntry *)0)
+int32_t file_pread(struct EXT2FileTable *table, int32_t fd, void *buf, uint32_t count, uint32_t offset)
+{
+    struct EXT2OpenFile *file = file_get(table, fd);
+    if (file == (struct EXT2OpenFile *)0 || (file->flags & EXT2_O_ACCMODE) == EXT2_O_WRONLY)
+        return -1;
+    if (count > 0x7FFFFFFFu)
+        count = 0x7FFFFFFFu; // Hasil harus muat di int32_t
+    return inode_read_at(file->node, (uint8_t *)buf, count, offset);
+}
+
+int32_t file_pwrite(struct EXT2FileTable *table, int32_t fd, const void *buf, uint32_t count, uint32_t offset)
+{
+    struct EXT2OpenFile *file = file_get(table, fd);
+    if (file == (struct EXT2OpenFile *)0 || (file->flags & EXT2_O_ACCMODE) == EXT2_O_RDONLY)
+        return -1;
+    if (file->flags & EXT2_O_APPEND)
+        offset = file->node->i_size;
+    if (count > 0x7FFFFFFFu)
+        count = 0x7FFFFFFFu;
+    if (count == 0)
+        return 0;
+
+    uint32_t written = inode_write_at(file->node, (const uint8_t *)buf, count, offset);
+    return written > 0 ? (int32_t)written : -1;
+}
+
+int32_t file_read(struct EXT2FileTable *table, int32_t fd, void *buf, uint32_t count)
+{
+    struct EXT2OpenFile *file = file_get(table, fd);
+    if (file == (struct EXT2OpenFile *)0)
+        return -1;
+    int32_t bytes_read = file_pread(table, fd, buf, count, file->offset);
+    if (bytes_read > 0)
+        file->offset += bytes_read;
+    return bytes_read;
+}
+
+int32_t file_write(struct EXT2FileTable *table, int32_t fd, const void *buf, uint32_t count)
+{
+    struct EXT2OpenFile *file = file_get(table, fd);
+    if (file == (struct EXT2OpenFile *)0)
+        return -1;
+    // Append: posisi ikut pindah ke akhir file yang baru
+    uint32_t offset = (file->flags & EXT2_O_APPEND) ? file->node->i_size : file->offset;
+    int32_t bytes_written = file_pwrite(table, fd, buf, count, offset);
+    if (bytes_written > 0)
+        file->offset = offset + bytes_written;
+    return bytes_written;
+}
+
+/**
+ * Cari byte pertama mulai offset yang punya block data (want_data) atau berada di hole, per block.
+ * Akhir file dihitung hole, file inline seluruhnya data
+ *
+ * @return Posisi yang ditemukan, -1 jika offset di luar file atau tidak ada data lagi setelah offset
+ */
+static int64_t inode_seek_data(struct EXT2MemInode *node, uint32_t offset, bool want_data)
+{
+    if (offset >= node->i_size)
+        return -1;
+    if (node->i_flags & EXT2_INLINE_DATA_FL)
+        return want_data ? offset : node->i_size;
+
+    struct EXT2BlockMap map;
+    block_map_init(&map, node);
+    uint32_t file_blocks = (node->i_size + ext2_geo.block_size - 1) / ext2_geo.block_size;
+    for (uint32_t i = offset / ext2_geo.block_size; i < file_blocks; i++)
+    {
+        if ((block_map_get(&map, i) != 0) == want_data)
+        {
+            uint32_t block_start = i * ext2_geo.block_size;
+            return block_start > offset ? block_start : offset;
+        }
+    }
+    if (want_data)
+        return -1;
+    return node->i_size;
+}
+
+int32_t file_lseek(struct EXT2FileTable *table, int32_t fd, int32_t offset, uint32_t whence)
+{
+    struct EXT2OpenFile *file = file_get(table, fd);
+    if (file == (struct EXT2OpenFile *)0)
+        return -1;
+
+    // Posisi data / hole langsung menjadi posisi baru, offset adalah titik awal pencarian
+    if (whence == EXT2_SEEK_DATA || whence == EXT2_SEEK_HOLE)
     {
-        prev_entry->rec_len += target_entry->rec_len;
+        if (offset < 0)
+            return -1;
+        int64_t found = inode_seek_data(file->node, (uint32_t)offset, whence == EXT2_SEEK_DATA);
+        if (found < 0 || found > 0x7FFFFFFF)
+            return -1;
+        file->offset = (uint32_t)found;
+        return (int32_t)found;
     }
+
+    int64_t position;
+    if (whence == EXT2_SEEK_SET)
+        position = 0;
+    else if (whence == EXT2_SEEK_CUR)
+        position = file->offset;
+    else if (whence == EXT2_SEEK_END)
+        position = file->node->i_size;
     else
+        return -1;
+
+    position += offset;
+    if (position < 0 || position > 0x7FFFFFFF)
+        return -1;
+    file->offset = (uint32_t)position;
+    return (int32_t)position;
+}
+
+/* =================== PATH OPERATIONS ============================*/
+
+void working_directory_init(struct EXT2WorkingDirectory *cwd)
+{
+    cwd->inode = 2;
+    cwd->path_len = 1;
+    memcpy(cwd->path, "/", 2);
+}
+
+/**
+ * Ambil komponen path berikutnya mulai *position, '/' berulang dilewati
+ * @param start Diisi offset awal komponen
+ * @return Panjang komponen, 0 jika path sudah habis
+ */
+static uint32_t path_next_component(const char *path, uint32_t path_len, uint32_t *position, uint32_t *start)
+{
+    while (*position < path_len && path[*position] == '/')
+        (*position)++;
+    *start = *position;
+    while (*position < path_len && path[*position] != '/')
+        (*position)++;
+    return *position - *start;
+}
+
+int8_t namei(struct EXT2WorkingDirectory *cwd, struct EXT2PathRequest *request)
+{
+    if (request->path_len == 0)
+        return 3;
+
+    uint32_t inode = (request->path[0] == '/' || cwd == (struct EXT2WorkingDirectory *)0) ? 2 : cwd->inode;
+    uint8_t file_type = EXT2_FT_DIR;
+    uint32_t position = 0;
+    uint32_t start;
+    uint32_t name_len;
+    while ((name_len = path_next_component(request->path, request->path_len, &position, &start)) > 0)
     {
-        // First entry, just mark as deleted
-        target_entry->inode = 0;
+        if (name_len > 255)
+            return 3;
+        if (file_type != EXT2_FT_DIR)
+            return 2;
+        // "." tidak perlu lookup, ".." tetap lewat entry di disk (".." milik root menunjuk root sendiri)
+        if (name_len == 1 && request->path[start] == '.')
+            continue;
+
+        struct EXT2DirectoryEntry *entry = find_entry_in_dir(inode, request->path + start, (uint8_t)name_len);
+        if (entry == (struct EXT2DirectoryEntry *)0)
+            return 1;
+        inode = entry->inode;
+        file_type = entry->file_type;
     }
 
-    // Write parent directory back
-    write_blocks(&parent_buff, parent_node.i_block[0], 1);
+    struct EXT2MemInode *node = iget(inode);
+    if (node == (struct EXT2MemInode *)0)
+        return -1;
+    request->stat.inode = inode;
+    request->stat.size = node->i_size;
+    request->stat.mode = node->i_mode;
+    request->stat.file_type = file_type;
+    iput(node);
+    return 0;
+}
 
-    // Commit metadata
-    commit_metadata();
+int8_t change_directory(struct EXT2WorkingDirectory *cwd, struct EXT2PathRequest *request)
+{
+    int8_t retcode = namei(cwd, request);
+    if (retcode != 0)
+        return retcode;
+    if (request->stat.file_type != EXT2_FT_DIR)
+        return 2;
+
+    // Path baru dinormalisasi secara leksikal, tanpa symlink hasilnya sama dengan yang di-resolve namei()
+    // Root ditulis sebagai string kosong selama proses, tiap komponen ditambahkan sebagai "/nama"
+    char path[EXT2_PATH_MAX];
+    uint32_t path_len = 0;
+    if (request->path[0] != '/' && cwd->path_len > 1)
+    {
+        memcpy(path, cwd->path, cwd->path_len);
+        path_len = cwd->path_len;
+    }
 
-    return 0; // Success
-}
\ No newline at end of file
+    uint32_t position = 0;
+    uint32_t start;
+    uint32_t name_len;
+    while ((name_len = path_next_component(request->path, request->path_len, &position, &start)) > 0)
+    {
+        const char *name = request->path + start;
+        if (name_len == 1 && name[0] == '.')
+            continue;
+        if (name_len == 2 && name[0] == '.' && name[1] == '.')
+        {
+            while (path_len > 0 && path[path_len - 1] != '/')
+                path_len--;
+            if (path_len > 0)
+                path_len--;
+            continue;
+        }
+        if (path_len + 1 + name_len >= EXT2_PATH_MAX)
+            return 3;
+        path[path_len++] = '/';
+        memcpy(path + path_len, name, name_len);
+        path_len += name_len;
+    }
+    if (path_len == 0)
+        path[path_len++] = '/';
+    path[path_len] = '\0';
+
+    cwd->inode = request->stat.inode;
+    cwd->path_len = path_len;
+    memcpy(cwd->path, path, path_len + 1);
+    return 0;
+}
+
+int8_t get_working_directory(struct EXT2WorkingDirectory *cwd, char *buf, uint32_t size)
+{
+    if (size < cwd->path_len + 1)
+        return 1;
+    memcpy(buf, cwd->path, cwd->path_len + 1);
+    return 0;
+}
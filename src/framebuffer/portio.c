@@ -28,3 +28,41 @@ uint16_t in16(uint16_t port) {
     return result;
 }
 
+
+void out32(uint16_t port, uint32_t data) {
+    __asm__ volatile(
+        "outl %0, %1"
+        : // <Empty output operand>
+        : "a"(data), "Nd"(port)
+    );
+}
+
+uint32_t in32(uint16_t port) {
+    uint32_t result;
+    __asm__ volatile(
+        "inl %1, %0"
+        : "=a"(result)
+        : "Nd"(port)
+    );
+    return result;
+}
+
+// rep insw, read count words from port into buf with single string instruction
+void in16_rep(uint16_t port, void *buf, uint32_t count) {
+    __asm__ volatile(
+        "cld; rep insw"
+        : "+D"(buf), "+c"(count)
+        : "d"(port)
+        : "memory"
+    );
+}
+
+// rep outsw, write count words from buf into port with single string instruction
+void out16_rep(uint16_t port, const void *buf, uint32_t count) {
+    __asm__ volatile(
+        "cld; rep outsw"
+        : "+S"(buf), "+c"(count)
+        : "d"(port)
+        : "memory"
+    );
+}
@@ -0,0 +1,206 @@
+#ifndef _AHCI_H
+#define _AHCI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "header/disk.h"
+
+// AHCI base address (ABAR) is memory BAR5 of SATA controller
+#define AHCI_ABAR_INDEX       5
+#define AHCI_MAX_PORTS        32
+#define AHCI_MAX_SLOTS        32
+
+/* -- HBA generic registers bits -- */
+#define AHCI_CAP_NCS_SHIFT    8           // Number of command slots - 1, bit 8-12
+#define AHCI_CAP_NCS_MASK     0x1F
+#define AHCI_CAP_SNCQ         (1u << 30)  // HBA supports native command queuing
+#define AHCI_GHC_IE           (1u << 1)   // Interrupt enable
+#define AHCI_GHC_AE           (1u << 31)  // AHCI enable
+
+/* -- Port registers bits -- */
+#define AHCI_PORT_CMD_ST      0x0001      // Start processing command list
+#define AHCI_PORT_CMD_FRE     0x0010      // FIS receive enable
+#define AHCI_PORT_CMD_FR      0x4000      // FIS receive running
+#define AHCI_PORT_CMD_CR      0x8000      // Command list running
+
+#define AHCI_PORT_IS_DHRS     (1u << 0)   // Device to host register FIS received
+#define AHCI_PORT_IS_PSS      (1u << 1)   // PIO setup FIS received
+#define AHCI_PORT_IS_DSS      (1u << 2)   // DMA setup FIS received
+#define AHCI_PORT_IS_SDBS     (1u << 3)   // Set device bits FIS received, NCQ completion
+#define AHCI_PORT_IS_IFS      (1u << 27)  // Interface fatal error
+#define AHCI_PORT_IS_HBDS     (1u << 28)  // Host bus data error
+#define AHCI_PORT_IS_HBFS     (1u << 29)  // Host bus fatal error
+#define AHCI_PORT_IS_TFES     (1u << 30)  // Task file error
+#define AHCI_PORT_IS_ERROR    (AHCI_PORT_IS_IFS | AHCI_PORT_IS_HBDS | AHCI_PORT_IS_HBFS | AHCI_PORT_IS_TFES)
+
+#define AHCI_PORT_SSTS_DET_MASK    0xF
+#define AHCI_PORT_SSTS_DET_PRESENT 0x3    // Device present and PHY communication established
+#define AHCI_PORT_SIG_ATA          0x00000101
+
+/* -- Command list & table -- */
+#define AHCI_FIS_TYPE_REG_H2D      0x27
+#define AHCI_FIS_H2D_COMMAND       0x80   // C bit, FIS update command register
+#define AHCI_FIS_DEVICE_LBA        0x40
+
+#define AHCI_CMD_HEADER_WRITE      (1u << 6)  // Direction host to device
+#define AHCI_PRDT_ENTRY            8
+// Single PRD entry byte count is 22 bit, and entry must not cross physically discontiguous page frame
+#define AHCI_PRD_MAX_BYTES         0x400000
+// Largest command that always fit PRDT, whatever buffer alignment is
+#define AHCI_COMMAND_MAX_BLOCKS    ((AHCI_PRDT_ENTRY - 1) * AHCI_PRD_MAX_BYTES / BLOCK_SIZE)
+// Bounce buffer used when caller buffer is not DMA-able (not word aligned / unmapped)
+#define AHCI_BOUNCE_SIZE           0x10000
+
+/**
+ * AHCIPortRegisters, per-port register set at ABAR + 0x100 + port * 0x80
+ *
+ * @param command_list_base Physical address of command list (1 KiB aligned)
+ * @param fis_base          Physical address of received FIS area (256 byte aligned)
+ * @param interrupt_status  Write 1 to clear
+ * @param interrupt_enable  Same bit layout as interrupt_status
+ * @param command           ST / FRE / FR / CR
+ * @param task_file_data    Copy of device status (low byte) & error register
+ * @param sata_active       NCQ tag outstanding, set by software before command_issue, cleared by device
+ * @param command_issue     Slot issued, cleared by HBA once command is accepted (NCQ) or done (non NCQ)
+ */
+struct AHCIPortRegisters {
+    uint32_t command_list_base;
+    uint32_t command_list_base_upper;
+    uint32_t fis_base;
+    uint32_t fis_base_upper;
+    uint32_t interrupt_status;
+    uint32_t interrupt_enable;
+    uint32_t command;
+    uint32_t reserved_0;
+    uint32_t task_file_data;
+    uint32_t signature;
+    uint32_t sata_status;
+    uint32_t sata_control;
+    uint32_t sata_error;
+    uint32_t sata_active;
+    uint32_t command_issue;
+    uint32_t sata_notification;
+    uint32_t fis_switching_control;
+    uint32_t reserved_1[11];
+    uint32_t vendor[4];
+} __attribute__((packed));
+
+/**
+ * AHCIHBARegisters, HBA memory registers pointed by ABAR
+ *
+ * @param capability         Number of slots, NCQ support, ...
+ * @param global_control     AHCI enable & interrupt enable
+ * @param interrupt_status   Bit per port with pending interrupt, write 1 to clear
+ * @param port_implemented   Bit per implemented port
+ * @param ports              Port register sets
+ */
+struct AHCIHBARegisters {
+    uint32_t capability;
+    uint32_t global_control;
+    uint32_t interrupt_status;
+    uint32_t port_implemented;
+    uint32_t version;
+    uint32_t ccc_control;
+    uint32_t ccc_ports;
+    uint32_t em_location;
+    uint32_t em_control;
+    uint32_t capability_extended;
+    uint32_t bios_handoff;
+    uint32_t reserved[29];
+    uint32_t vendor[24];
+    struct AHCIPortRegisters ports[AHCI_MAX_PORTS];
+} __attribute__((packed));
+
+/**
+ * AHCICommandHeader, one command list entry, index is command slot
+ *
+ * @param flags                 Bit 0-4 command FIS length in dword, bit 6 write, others 0
+ * @param prdt_length           Number of PRDT entry in command table
+ * @param prd_byte_count        Bytes transferred, updated by HBA
+ * @param command_table_base    Physical address of command table (128 byte aligned)
+ */
+struct AHCICommandHeader {
+    uint16_t flags;
+    uint16_t prdt_length;
+    uint32_t prd_byte_count;
+    uint32_t command_table_base;
+    uint32_t command_table_base_upper;
+    uint32_t reserved[4];
+} __attribute__((packed));
+
+/**
+ * AHCIPRDEntry, physical region descriptor of AHCI command table
+ *
+ * @param data_base  Physical address, word aligned
+ * @param byte_count Bit 0-21 byte count - 1 (must be odd, i.e. even byte count), bit 31 interrupt on completion
+ */
+struct AHCIPRDEntry {
+    uint32_t data_base;
+    uint32_t data_base_upper;
+    uint32_t reserved;
+    uint32_t byte_count;
+} __attribute__((packed));
+
+// Command table, 128 byte aligned. Size is multiple of 128 so array of table keep alignment
+struct AHCICommandTable {
+    uint8_t             command_fis[64];
+    uint8_t             atapi_command[16];
+    uint8_t             reserved[48];
+    struct AHCIPRDEntry prdt[AHCI_PRDT_ENTRY];
+} __attribute__((packed));
+
+// Register host to device FIS, placed in AHCICommandTable.command_fis
+struct AHCIFISRegisterH2D {
+    uint8_t fis_type;
+    uint8_t flags;
+    uint8_t command;
+    uint8_t feature_low;
+    uint8_t lba0;
+    uint8_t lba1;
+    uint8_t lba2;
+    uint8_t device;
+    uint8_t lba3;
+    uint8_t lba4;
+    uint8_t lba5;
+    uint8_t feature_high;
+    uint8_t count_low;
+    uint8_t count_high;
+    uint8_t icc;
+    uint8_t control;
+    uint8_t reserved[4];
+} __attribute__((packed));
+
+// FIS receive area, written by HBA
+struct AHCIReceivedFIS {
+    uint8_t buf[256];
+} __attribute__((packed));
+
+
+
+/**
+ * Find AHCI SATA controller on PCI, start first port with ATA disk attached and IDENTIFY it.
+ * NCQ (READ/WRITE FPDMA QUEUED) is used when both HBA and device support it,
+ * otherwise up to the same number of slots is issued with READ/WRITE DMA (EXT), served in order by HBA.
+ *
+ * @param irq      Output PIC IRQ line of controller, interrupt is enabled on HBA
+ * @param capacity Output disk size in sectors
+ * @return         True if AHCI disk is ready
+ */
+bool ahci_init(uint8_t *irq, uint32_t *capacity);
+
+/**
+ * Issue request into free command slot, or queue it until a slot is free.
+ * Must be called with interrupt disabled. Large request is split, one slot at a time.
+ *
+ * @param request Request to submit, must stay valid until request->done
+ */
+void ahci_submit(struct DiskRequest *request);
+
+/**
+ * Complete finished slots and issue waiting requests. Called from PCI interrupt line,
+ * or polled from disk_wait if line is not dispatched. Must be called with interrupt disabled.
+ */
+void ahci_isr(void);
+
+#endif
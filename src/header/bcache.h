@@ -0,0 +1,155 @@
+#ifndef _BCACHE_H
+#define _BCACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "header/disk.h"
+#include "header/blockdev.h"
+
+/* -- Buffer cache limits -- */
+#define BCACHE_MAX_BUFFERS      256  // Buffer heads, upper bound of cache size
+#define BCACHE_MIN_BUFFERS      64   // Enough for every buffer a filesystem operation pin at once, read-ahead window included
+#define BCACHE_DEFAULT_BUFFERS  128
+#define BCACHE_HASH_BUCKETS     64   // Power of two
+#define BCACHE_MAX_BLOCK_SIZE   4096 // Largest cache block, multiple of device sector size
+#define BCACHE_POOL_SIZE        (BCACHE_MIN_BUFFERS * BCACHE_MAX_BLOCK_SIZE) // Data of all buffers, size is clamped to fit
+
+/**
+ * BufferHead, one cached block
+ *
+ * @param block     Block number on device
+ * @param refcount  Pin count, pinned buffer is never evicted
+ * @param valid     Buffer is holding block and is linked in hash chain, false after failed read (data is zeroed)
+ * @param dirty     Data is newer than device, written back on sync / eviction
+ * @param journaled Dirty data is already safe in a journal, bcache_sync_data() leaves it for the checkpoint
+ * @param status    Result of device read filling data, -1 if it failed (read is retried by next bcache_get())
+ * @param hash_next Next buffer in the same hash bucket
+ * @param lru_prev  More recently used buffer
+ * @param lru_next  Less recently used buffer
+ * @param data      Block content, block_size bytes inside BufferCache.pool
+ */
+struct BufferHead {
+    uint32_t           block;
+    uint32_t           refcount;
+    bool               valid;
+    bool               dirty;
+    bool               journaled;
+    int8_t             status;
+    struct BufferHead *hash_next;
+    struct BufferHead *lru_prev;
+    struct BufferHead *lru_next;
+    uint8_t           *data;
+};
+
+/**
+ * BufferCache, hashed LRU write-back cache of one block device. Cache block is block_size bytes,
+ * made of block_size / sector_size consecutive device sectors, block n start at sector n * sectors_per_block
+ *
+ * @param device            Cached device
+ * @param block_size        Bytes per cache block
+ * @param sectors_per_block Device sectors per cache block
+ * @param size              Buffers in use, BCACHE_MIN_BUFFERS to BCACHE_MAX_BUFFERS and at most BCACHE_POOL_SIZE / block_size
+ * @param buffers           Buffer heads, only first size entries are used
+ * @param hash              Bucket heads, indexed by block & (BCACHE_HASH_BUCKETS - 1)
+ * @param lru_head          Most recently used buffer
+ * @param lru_tail          Least recently used buffer, first eviction candidate
+ * @param pinned            Buffers with refcount > 0, a new block can be pinned only while pinned < size
+ * @param hits              Lookups served from cache
+ * @param misses            Lookups that needed device read (or new buffer)
+ * @param writebacks        Dirty blocks written to device
+ * @param read_errors       Device reads that failed, failed block is dropped from cache
+ * @param pool              Data of every buffer
+ */
+struct BufferCache {
+    struct BlockDevice *device;
+    uint32_t            block_size;
+    uint32_t            sectors_per_block;
+    uint32_t            size;
+    struct BufferHead   buffers[BCACHE_MAX_BUFFERS];
+    struct BufferHead  *hash[BCACHE_HASH_BUCKETS];
+    struct BufferHead  *lru_head;
+    struct BufferHead  *lru_tail;
+    uint32_t            pinned;
+    uint32_t            hits;
+    uint32_t            misses;
+    uint32_t            writebacks;
+    uint32_t            read_errors;
+    uint8_t             pool[BCACHE_POOL_SIZE];
+};
+
+/**
+ * Reset cache to empty state, without writing back dirty buffers
+ *
+ * @param cache      Target cache
+ * @param device     Cached device
+ * @param block_size Bytes per cache block, multiple of device sector size up to BCACHE_MAX_BLOCK_SIZE
+ * @param size       Number of buffers, clamped to BCACHE_MIN_BUFFERS - BCACHE_MAX_BUFFERS and to the pool
+ */
+void bcache_init(struct BufferCache *cache, struct BlockDevice *device, uint32_t block_size, uint32_t size);
+
+/**
+ * Change number of buffers. Dirty buffers are written back and cache is emptied
+ *
+ * @param cache Target cache
+ * @param size  New number of buffers, clamped like bcache_init()
+ * @return      False if some buffer is pinned, cache is left unchanged
+ */
+bool bcache_set_size(struct BufferCache *cache, uint32_t size);
+
+/**
+ * Pin buffer of block, read from device on miss. A failed read leaves the buffer invalid: data is zeroed,
+ * buffer is out of hash chain and never written back, next bcache_get() of the block read the device again
+ *
+ * @param cache Target cache
+ * @param block Block number
+ * @return      Pinned buffer holding block data, release with bcache_release(). NULL if every buffer is pinned,
+ *              users keep their pins under size with bcache_unpinned() instead of checking every call.
+ *              buffer->valid is false if device read failed
+ */
+struct BufferHead *bcache_get(struct BufferCache *cache, uint32_t block);
+
+/**
+ * Same as bcache_get(), but miss is queued with blockdev_read_async(). Caller must plug the device
+ * before and must not touch buffer data until the device is unplugged. Failure is stored in buffer->status,
+ * bcache_get() of the block retry the read and the last bcache_release() drop the block from cache.
+ */
+struct BufferHead *bcache_get_async(struct BufferCache *cache, uint32_t block);
+
+// Pin buffer of block that will be fully overwritten, no device read. Data is zeroed on miss
+struct BufferHead *bcache_get_new(struct BufferCache *cache, uint32_t block);
+
+// Buffers that are not pinned, a caller that pins many buffers at once (ex: read-ahead, journal) stops before running out
+uint32_t bcache_unpinned(struct BufferCache *cache);
+
+// True if block is in cache, lookup does not pin and does not count as hit / miss
+bool bcache_cached(struct BufferCache *cache, uint32_t block);
+
+// Mark pinned buffer as modified
+void bcache_mark_dirty(struct BufferCache *cache, struct BufferHead *buffer);
+
+// Drop modified state of pinned buffer without writing it, owner (ex: journal) write it back later with bcache_mark_journaled()
+void bcache_mark_clean(struct BufferCache *cache, struct BufferHead *buffer);
+
+// Mark pinned buffer as modified and committed to journal, written back on eviction or bcache_sync() only
+void bcache_mark_journaled(struct BufferCache *cache, struct BufferHead *buffer);
+
+// Unpin buffer, buffer may be evicted after its last release
+void bcache_release(struct BufferCache *cache, struct BufferHead *buffer);
+
+// Copy one block out of cache into ptr (block_size bytes), return -1 (ptr is zeroed) if device read failed
+int8_t bcache_read(struct BufferCache *cache, void *ptr, uint32_t block);
+
+// Replace one block in cache with ptr (block_size bytes), written back later
+void bcache_write(struct BufferCache *cache, const void *ptr, uint32_t block);
+
+// Drop cached block without writing it back, ex: block freed by filesystem
+void bcache_invalidate(struct BufferCache *cache, uint32_t block);
+
+// Write back every dirty buffer in one plugged batch, adjacent blocks are merged by I/O scheduler
+void bcache_sync(struct BufferCache *cache);
+
+// Same as bcache_sync(), but journaled buffers stay dirty. Ordered mode: data reach device before the metadata pointing to it is committed
+void bcache_sync_data(struct BufferCache *cache);
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef _BLOCKDEV_H
+#define _BLOCKDEV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "header/disk.h"
+
+#define BLOCKDEV_MAX_DEVICES     4
+#define BLOCKDEV_NAME_LENGTH     8
+// Latency histogram bucket i count request taking [2^i, 2^(i+1)) TSC cycles, last bucket take the rest
+#define BLOCKDEV_LATENCY_BUCKETS 40
+
+struct BlockDevice;
+struct IOQueue;
+
+/**
+ * BlockDeviceStats, I/O counters of one device since boot
+ *
+ * @param read_ops       Completed read commands
+ * @param read_sectors   Sectors read
+ * @param read_merges    Read requests merged into neighbour command by I/O scheduler
+ * @param write_ops      Completed write commands
+ * @param write_sectors  Sectors written
+ * @param write_merges   Write requests merged into neighbour command by I/O scheduler
+ * @param errors         Commands completed with error
+ * @param in_flight      Commands submitted to driver and not yet completed (queue depth)
+ * @param max_in_flight  Highest in_flight seen
+ * @param read_latency   log2 histogram of read latency, submit to driver completion
+ * @param write_latency  log2 histogram of write latency
+ */
+struct BlockDeviceStats {
+    uint32_t read_ops;
+    uint32_t read_sectors;
+    uint32_t read_merges;
+    uint32_t write_ops;
+    uint32_t write_sectors;
+    uint32_t write_merges;
+    uint32_t errors;
+    uint32_t in_flight;
+    uint32_t max_in_flight;
+    uint32_t read_latency[BLOCKDEV_LATENCY_BUCKETS];
+    uint32_t write_latency[BLOCKDEV_LATENCY_BUCKETS];
+};
+
+/**
+ * BlockDeviceInfo, snapshot of registered device returned to user program
+ *
+ * @param name        Device name, null terminated
+ * @param sector_size Bytes per sector
+ * @param capacity    Device size in sectors
+ * @param stats       Counters at snapshot time
+ */
+struct BlockDeviceInfo {
+    char                    name[BLOCKDEV_NAME_LENGTH];
+    uint32_t                sector_size;
+    uint32_t                capacity;
+    struct BlockDeviceStats stats;
+};
+
+/**
+ * BlockDeviceOps, driver entry points of block device
+ *
+ * @param submit Start or queue request and return, driver set request->done on completion
+ * @param kick   Start every request submitted since last kick, NULL if submit already start it
+ * @param wait   Block until request->done
+ * @param flush  Write back device volatile write cache, return 0 once completed writes are on stable media. NULL if
+ *               device has no write cache
+ */
+struct BlockDeviceOps {
+    void   (*submit)(struct BlockDevice *device, struct DiskRequest *request);
+    void   (*kick)(struct BlockDevice *device);
+    void   (*wait)(struct BlockDevice *device, struct DiskRequest *request);
+    int8_t (*flush)(struct BlockDevice *device);
+};
+
+/**
+ * BlockDevice, sector addressed storage that filesystem is mounted on
+ *
+ * @param name        Device name, ex: "disk", "ram0"
+ * @param ops         Driver entry points
+ * @param sector_size Bytes per sector, all current backend use BLOCK_SIZE
+ * @param capacity    Device size in sectors
+ * @param queue       I/O scheduler queue in front of driver, NULL to submit directly (ex: RAM disk)
+ * @param driver_data Backend private data
+ * @param stats       I/O counters, maintained by block layer
+ */
+struct BlockDevice {
+    const char                  *name;
+    const struct BlockDeviceOps *ops;
+    uint32_t                     sector_size;
+    uint32_t                     capacity;
+    struct IOQueue              *queue;
+    void                        *driver_data;
+    struct BlockDeviceStats      stats;
+};
+
+// Make device visible to blockdev_info(), stats are reset. Ignored when registry is full
+void blockdev_register(struct BlockDevice *device);
+
+/**
+ * Snapshot of registered device
+ *
+ * @param index Registration order, starting at 0
+ * @param info  Output snapshot
+ * @return      False if no device at index
+ */
+bool blockdev_info(uint32_t index, struct BlockDeviceInfo *info);
+
+/* -- Driver level, used by I/O scheduler. Submit & wait maintain device stats -- */
+void blockdev_submit(struct BlockDevice *device, struct DiskRequest *request);
+void blockdev_kick(struct BlockDevice *device);
+void blockdev_wait(struct BlockDevice *device, struct DiskRequest *request);
+
+// Count requests folded into another command by I/O scheduler
+void blockdev_account_merge(struct BlockDevice *device, bool is_write, uint32_t count);
+
+/**
+ * Blocking read through device queue, pending queued writes are honored
+ *
+ * @param device                Target device
+ * @param ptr                   Buffer, size block_count * sector_size
+ * @param logical_block_address First sector
+ * @param block_count           Sector count
+ * @return                      0, or -1 if device reported error
+ */
+int8_t blockdev_read(struct BlockDevice *device, void *ptr, uint32_t logical_block_address, uint32_t block_count);
+
+// Queued read, see iosched_read_async(). Blocking read if device has no queue
+int8_t blockdev_read_async(struct BlockDevice *device, void *ptr, uint32_t logical_block_address, uint32_t block_count, int8_t *status);
+
+// Write through device queue, see iosched_write(). Blocking write if device has no queue
+int8_t blockdev_write(struct BlockDevice *device, const void *ptr, uint32_t logical_block_address, uint32_t block_count);
+
+// Batch requests until matching blockdev_unplug(), no-op if device has no queue. Unplug return blockdev_flush() status
+void blockdev_plug(struct BlockDevice *device);
+int8_t blockdev_unplug(struct BlockDevice *device);
+
+// Write barrier, every queued request is completed and device write cache is written back on return.
+// Return -1 if a queued write or the cache flush failed
+int8_t blockdev_flush(struct BlockDevice *device);
+
+#endif
@@ -12,9 +12,95 @@
 #define ATA_STATUS_DF    0x20
 #define ATA_STATUS_ERR   0x01
 
+/* -- ATA primary channel ports -- */
+#define ATA_PRIMARY_IO_BASE   0x1F0
+#define ATA_PRIMARY_DATA      (ATA_PRIMARY_IO_BASE + 0)
+#define ATA_PRIMARY_SECCOUNT  (ATA_PRIMARY_IO_BASE + 2)
+#define ATA_PRIMARY_LBA_LOW   (ATA_PRIMARY_IO_BASE + 3)
+#define ATA_PRIMARY_LBA_MID   (ATA_PRIMARY_IO_BASE + 4)
+#define ATA_PRIMARY_LBA_HIGH  (ATA_PRIMARY_IO_BASE + 5)
+#define ATA_PRIMARY_DRIVE     (ATA_PRIMARY_IO_BASE + 6)
+#define ATA_PRIMARY_STATUS    (ATA_PRIMARY_IO_BASE + 7)
+#define ATA_PRIMARY_COMMAND   (ATA_PRIMARY_IO_BASE + 7)
+#define ATA_PRIMARY_CONTROL   0x3F6
+
+/* -- ATA commands -- */
+#define ATA_CMD_READ_PIO           0x20
+#define ATA_CMD_READ_PIO_EXT       0x24
+#define ATA_CMD_READ_DMA_EXT       0x25
+#define ATA_CMD_READ_MULTIPLE_EXT  0x29
+#define ATA_CMD_WRITE_PIO          0x30
+#define ATA_CMD_WRITE_PIO_EXT      0x34
+#define ATA_CMD_WRITE_DMA_EXT      0x35
+#define ATA_CMD_WRITE_MULTIPLE_EXT 0x39
+#define ATA_CMD_READ_FPDMA_QUEUED  0x60 // NCQ, count in feature register, tag in count register
+#define ATA_CMD_WRITE_FPDMA_QUEUED 0x61
+#define ATA_CMD_READ_MULTIPLE      0xC4
+#define ATA_CMD_WRITE_MULTIPLE     0xC5
+#define ATA_CMD_SET_MULTIPLE       0xC6
+#define ATA_CMD_READ_DMA           0xC8
+#define ATA_CMD_WRITE_DMA          0xCA
+#define ATA_CMD_FLUSH_CACHE        0xE7
+#define ATA_CMD_FLUSH_CACHE_EXT    0xEA
+#define ATA_CMD_IDENTIFY           0xEC
+
+/* -- ATA addressing limits, per command -- */
+#define ATA_LBA28_MAX_BLOCKS  256
+#define ATA_LBA48_MAX_BLOCKS  65536
+#define ATA_LBA28_MAX_ADDRESS 0x10000000
+
+/* -- Bus master IDE registers, offset from PCI BAR4 (primary channel) -- */
+#define ATA_BM_COMMAND        0x0
+#define ATA_BM_STATUS         0x2
+#define ATA_BM_PRDT           0x4
+
+#define ATA_BM_COMMAND_START  0x01
+#define ATA_BM_COMMAND_READ   0x08 // Bus master writes into memory, i.e. disk read
+#define ATA_BM_STATUS_ACTIVE  0x01
+#define ATA_BM_STATUS_ERR     0x02
+#define ATA_BM_STATUS_IRQ     0x04
+
+// Physical region descriptor flag marking last entry of the table
+#define ATA_PRD_END_OF_TABLE  0x8000
+// Single PRD entry cannot cross 64 KiB physical boundary
+#define ATA_PRD_BOUNDARY      0x10000
+#define ATA_PRD_MAX_ENTRY     8
+// Largest DMA command that always fit PRD table, whatever buffer alignment is
+#define ATA_DMA_MAX_BLOCKS    ((ATA_PRD_MAX_ENTRY - 1) * ATA_PRD_BOUNDARY / BLOCK_SIZE)
+// Bounce buffer used when caller buffer is not DMA-able (ex: user memory)
+#define ATA_DMA_BOUNCE_SIZE   0x10000
+
+// IDENTIFY word 47 bit 0-7, maximum blocks per DRQ data block for READ/WRITE MULTIPLE
+#define ATA_IDENTIFY_MAX_MULTIPLE 47
+// IDENTIFY word 49 bit 8, device supports DMA
+#define ATA_IDENTIFY_CAPABILITIES 49
+#define ATA_IDENTIFY_CAP_DMA      0x0100
+// IDENTIFY word 82 bit 5, device has volatile write cache that FLUSH CACHE write back
+#define ATA_IDENTIFY_FEATURE_SET  82
+#define ATA_IDENTIFY_CMD_WCACHE   0x0020
+// IDENTIFY word 83 bit 10, device supports 48-bit LBA
+#define ATA_IDENTIFY_COMMAND_SET  83
+#define ATA_IDENTIFY_CMD_LBA48    0x0400
+// IDENTIFY word 75 bit 0-4, NCQ queue depth - 1
+#define ATA_IDENTIFY_QUEUE_DEPTH  75
+// IDENTIFY word 76 bit 8, device supports native command queuing
+#define ATA_IDENTIFY_SATA_CAP     76
+#define ATA_IDENTIFY_SATA_CAP_NCQ 0x0100
+// IDENTIFY word 60-61 28-bit addressable sectors, word 100-103 48-bit addressable sectors
+#define ATA_IDENTIFY_LBA28_SECTORS 60
+#define ATA_IDENTIFY_LBA48_SECTORS 100
+
 #define BLOCK_SIZE      512
 #define HALF_BLOCK_SIZE (BLOCK_SIZE/2)
 
+/* -- Disk controller, selected at boot with kernel command line disk=ata|ahci|virtio -- */
+#define DISK_CONTROLLER_AUTO   0 // First found of virtio-blk, AHCI, ATA primary channel
+#define DISK_CONTROLLER_ATA    1
+#define DISK_CONTROLLER_AHCI   2
+#define DISK_CONTROLLER_VIRTIO 3
+// Controller interrupt is not routed to dispatched PIC line, completion is polled in disk_wait()
+#define DISK_IRQ_NONE          0xFF
+
 
 
 // Block buffer data type - @param buf Byte buffer with size of BLOCK_SIZE
@@ -22,29 +108,154 @@ struct BlockBuffer {
     uint8_t buf[BLOCK_SIZE];
 } __attribute__((packed));
 
+/**
+ * Physical Region Descriptor, one entry of bus master IDE scatter-gather table
+ *
+ * @param physical_address Physical address of memory region, must be word aligned
+ * @param byte_count       Region size in bytes, 0 means 64 KiB
+ * @param flags            ATA_PRD_END_OF_TABLE for last entry
+ */
+struct ATAPRDEntry {
+    uint32_t physical_address;
+    uint16_t byte_count;
+    uint16_t flags;
+} __attribute__((packed));
+
+/**
+ * DiskRequest, one transfer queued to disk driver. Caller own the memory until done is set.
+ *
+ * @param buf                   Data buffer, size block_count * BLOCK_SIZE
+ * @param logical_block_address First block to transfer
+ * @param block_count           How many block to transfer
+ * @param is_write              True for write, false for read
+ * @param is_flush              Write back device volatile write cache instead of transfer, block_count is 0
+ * @param transferred           Blocks already moved, maintained by driver
+ * @param status                0 on success, -1 if device reported error. Valid after done is set
+ * @param done                  Set by driver (from interrupt handler) when request is completed
+ * @param next                  Driver queue link
+ * @param submitted_at          TSC at block layer submit, 0 once completion is accounted
+ * @param completed_at          TSC when driver completed the request, see disk_request_complete()
+ */
+struct DiskRequest {
+    void               *buf;
+    uint32_t            logical_block_address;
+    uint32_t            block_count;
+    bool                is_write;
+    bool                is_flush;
+    uint32_t            transferred;
+    volatile int8_t     status;
+    volatile bool       done;
+    struct DiskRequest *next;
+    uint64_t            submitted_at;
+    uint64_t            completed_at;
+};
+
+// CPU time stamp counter, unit of block layer latency
+static inline uint64_t disk_timestamp(void) {
+    uint32_t low, high;
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t) high << 32) | low;
+}
+
+// Driver completion of request, done is set last so waiter see status & timestamp
+static inline void disk_request_complete(struct DiskRequest *request, int8_t status) {
+    request->status       = status;
+    request->completed_at = disk_timestamp();
+    request->done         = true;
+}
+
+struct BlockDevice;
+
+// Block device of the system disk, I/O is scheduled through its queue. Valid after disk_init()
+extern struct BlockDevice disk_block_device;
+
+
+
+/**
+ * Probe disk controller. virtio-blk and AHCI are found through PCI (pci_init() must be called before).
+ * For ATA primary channel, bus master DMA is used when PCI IDE controller is available, otherwise fallback to PIO.
+ * Call after IDT & PIC is initialized and IRQ_PRIMARY_ATA is unmasked.
+ *
+ * @param controller DISK_CONTROLLER_*, AUTO try virtio-blk, AHCI then ATA
+ */
+void disk_init(uint8_t controller);
+
+/**
+ * Addressable sector count from IDENTIFY data, 48-bit count is clamped to 32-bit LBA
+ *
+ * @param identify IDENTIFY DEVICE data, 256 words
+ * @return         Device capacity in sectors
+ */
+uint32_t ata_identify_capacity(const uint16_t *identify);
+
+/**
+ * Primary ATA channel interrupt service routine (IRQ_PRIMARY_ATA).
+ * Acknowledge device & bus master interrupt, move PIO data, complete current request
+ * and issue next queued request to device.
+ */
+void ata_isr(void);
+
+/**
+ * PCI interrupt line service routine, forwarded to PCI disk controller using that line.
+ * Line is shared, handler check controller own interrupt status.
+ *
+ * @param irq PIC IRQ number of the line
+ */
+void disk_pci_isr(uint8_t irq);
+
+/**
+ * Queue request to disk driver and return immediately. Request is issued to device
+ * right away if driver is idle, otherwise after all previously submitted requests.
+ * Before disk_init(), request is done synchronously with polling PIO.
+ *
+ * @param request Request to submit, must stay valid until request->done
+ */
+void disk_submit(struct DiskRequest *request);
+
+/**
+ * Start every request submitted since last kick. Controller that batch submissions (virtio-blk)
+ * notify device once here, others start request in disk_submit() already. disk_wait() also kick.
+ */
+void disk_kick(void);
 
+/**
+ * Sleep with hlt until request is completed by interrupt handler
+ *
+ * @param request Previously submitted request
+ */
+void disk_wait(struct DiskRequest *request);
+
+/**
+ * Write back volatile write cache of disk, blocking. Every write completed before the call is on stable media
+ * on return. No-op for device without write cache (or virtio-blk without VIRTIO_BLK_F_FLUSH)
+ *
+ * @return 0, or -1 if device reported error
+ */
+int8_t disk_flush(void);
 
 /**
- * ATA PIO logical block address read blocks. Will blocking until read is completed.
- * Note: ATA PIO will use 2-bytes per read/write operation.
+ * ATA logical block address read blocks. Will blocking until read is completed, CPU is halted while waiting.
+ * Note: Using bus master DMA if available, otherwise ATA PIO with READ MULTIPLE and rep insw.
+ * Large transfer is split into as few commands as possible, 48-bit LBA allow 65536 blocks per command.
  * Recommended to use struct BlockBuffer
- * 
+ *
  * @param ptr                   Pointer for storing reading data, this pointer should point to already allocated memory location.
  *                              With allocated size positive integer multiple of BLOCK_SIZE, ex: buf[1024]
  * @param logical_block_address Block address to read data from. Use LBA addressing
  * @param block_count           How many block to read, starting from block logical_block_address to lba-1
  */
-void read_blocks(void *ptr, uint32_t logical_block_address, uint8_t block_count);
+void read_blocks(void *ptr, uint32_t logical_block_address, uint32_t block_count);
 
 /**
- * ATA PIO logical block address write blocks. Will blocking until write is completed.
- * Note: ATA PIO will use 2-bytes per read/write operation.
+ * ATA logical block address write blocks. Will blocking until write is completed, CPU is halted while waiting.
+ * Note: Using bus master DMA if available, otherwise ATA PIO with WRITE MULTIPLE and rep outsw.
+ * Large transfer is split into as few commands as possible, 48-bit LBA allow 65536 blocks per command.
  * Recommended to use struct BlockBuffer
  *
  * @param ptr                   Pointer to data that to be written into disk. Memory pointed should be positive integer multiple of BLOCK_SIZE
  * @param logical_block_address Block address to write data into. Use LBA addressing
  * @param block_count           How many block to write, starting from block logical_block_address to lba-1
  */
-void write_blocks(const void *ptr, uint32_t logical_block_address, uint8_t block_count);
+void write_blocks(const void *ptr, uint32_t logical_block_address, uint32_t block_count);
 
-#endif
\ No newline at end of file
+#endif
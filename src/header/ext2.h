@@ -2,6 +2,7 @@
 #define _EXT2_H
 
 #include "disk.h"
+#include "blockdev.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -13,11 +14,21 @@
 #define DISK_SPACE 4194304u                                                      // 4MB disk space (because our disk or storage.bin is 4MB)
 #define EXT2_SUPER_MAGIC 0xEF53                                                  // this indicating that the filesystem used by OS is ext2
 #define INODE_SIZE sizeof(struct EXT2Inode)                                      // size of inode
-#define INODES_PER_TABLE (BLOCK_SIZE / INODE_SIZE)                               // number of inode per block (512 / )
-#define GROUPS_COUNT (BLOCK_SIZE / sizeof(struct EXT2BlockGroupDescriptor)) / 2u // number of groups in the filesystem
-#define BLOCKS_PER_GROUP (DISK_SPACE / BLOCK_SIZE / GROUPS_COUNT)                // number of blocks per group
-#define INODES_TABLE_BLOCK_COUNT 16u
-#define INODES_PER_GROUP (INODES_PER_TABLE * INODES_TABLE_BLOCK_COUNT) // number of inodes per group
+#define GROUPS_COUNT ((BLOCK_SIZE / sizeof(struct EXT2BlockGroupDescriptor)) / 2u) // number of groups in the filesystem
+
+/**
+ * Filesystem block size is 1024 << s_log_block_size, independent of the 512 byte disk sector (BLOCK_SIZE).
+ * Blocks per group, inodes per group and every block sized structure are derived from it at mount
+ */
+#define EXT2_MIN_LOG_BLOCK_SIZE 0u                                                // 1 KiB
+#define EXT2_MAX_LOG_BLOCK_SIZE 2u                                                // 4 KiB
+#define EXT2_DEFAULT_LOG_BLOCK_SIZE 0u                                            // used by initialize_filesystem_ext2() on empty storage, 1 KiB like mke2fs for small disk
+#define EXT2_MIN_BLOCK_SIZE (1024u << EXT2_MIN_LOG_BLOCK_SIZE)
+#define EXT2_MAX_BLOCK_SIZE (1024u << EXT2_MAX_LOG_BLOCK_SIZE)
+#define EXT2_SUPERBLOCK_OFFSET 1024u                                              // byte offset of superblock on disk, for every block size
+#define EXT2_INODE_TABLE_SIZE 8192u                                               // bytes of inode table per group
+#define EXT2_MAX_BLOCKS_PER_GROUP (DISK_SPACE / EXT2_MIN_BLOCK_SIZE / GROUPS_COUNT) // blocks per group with smallest block size
+#define EXT2_MAX_INODES_PER_GROUP (EXT2_INODE_TABLE_SIZE / INODE_SIZE)            // inodes per group if no inode table block has slack
 
 /**
  * inodes constant
@@ -26,6 +37,17 @@
 #define EXT2_S_IFREG 0x8000 // regular file
 #define EXT2_S_IFDIR 0x4000 // directory
 
+/* -- i_block layout -- */
+#define EXT2_NDIR_BLOCKS 12                                       // i_block[0..11] point to data blocks
+#define EXT2_IND_BLOCK 12                                         // i_block[12] points to a block of data block pointers
+#define EXT2_DIND_BLOCK 13                                        // i_block[13] points to a block of single indirect pointers
+#define EXT2_POINTERS_PER_BLOCK(block_size) ((block_size) / sizeof(uint32_t)) // block pointers in one indirect block
+
+/* -- Inode flags (i_flags) -- */
+#define EXT2_INDEX_FL 0x00001000       // directory is hash indexed, block 0 is EXT2DxRoot
+#define EXT2_INLINE_DATA_FL 0x10000000 // regular file content is stored in i_block itself, file has no data block (ext4 value)
+#define EXT2_INLINE_DATA_MAX 60u       // sizeof(i_block), largest file kept inline
+
 /* FILE TYPE CONSTANT*/
 /**
  * reference:
@@ -53,6 +75,62 @@ struct EXT2DriverRequest
     bool is_directory;
 } __attribute__((packed));
 
+/**
+ * File descriptor, open flags are Linux values
+ */
+#define EXT2_MAX_OPEN_FILES 16 // file descriptor per process
+#define EXT2_O_RDONLY 0x0000
+#define EXT2_O_WRONLY 0x0001
+#define EXT2_O_RDWR 0x0002
+#define EXT2_O_ACCMODE 0x0003
+#define EXT2_O_CREAT 0x0040  // create empty file if name does not exist
+#define EXT2_O_TRUNC 0x0200  // free every block of file opened for writing
+#define EXT2_O_APPEND 0x0400 // every write starts at end of file
+#define EXT2_SEEK_SET 0
+#define EXT2_SEEK_CUR 1
+#define EXT2_SEEK_END 2
+#define EXT2_SEEK_DATA 3 // offset is where the search starts, moves to next byte backed by a data block
+#define EXT2_SEEK_HOLE 4 // moves to next byte of a hole, end of file counts as a hole
+
+/**
+ * EXT2FileRequest
+ * Argument of file descriptor syscalls that do not fit in three registers
+ */
+struct EXT2FileRequest
+{
+    int32_t fd;
+    void *buf;
+    uint32_t count;  // bytes to transfer
+    uint32_t offset; // file position of pread / pwrite, signed displacement for lseek
+    uint32_t whence; // EXT2_SEEK_* for lseek
+} __attribute__((packed));
+
+#define EXT2_PATH_MAX 256 // bytes of working directory path, terminating NUL included
+
+/**
+ * EXT2Stat
+ * Attributes of the inode found by path lookup
+ */
+struct EXT2Stat
+{
+    uint32_t inode;
+    uint32_t size;
+    uint16_t mode;     // i_mode
+    uint8_t file_type; // EXT2_FT_* of the directory entry
+} __attribute__((packed));
+
+/**
+ * EXT2PathRequest
+ * Path starting with '/' is resolved from root, any other path from working directory of the caller.
+ * Empty components and "." are skipped, ".." follows the on-disk entry
+ */
+struct EXT2PathRequest
+{
+    char *path;       // not NUL terminated, path_len bytes are used
+    uint32_t path_len;
+    struct EXT2Stat stat; // filled on success
+} __attribute__((packed));
+
 /**
  * EXT2Superblock:
  * - https://www.nongnu.org/ext2-doc/ext2.html#superblock
@@ -66,6 +144,7 @@ struct EXT2Superblock
     uint32_t s_free_blocks_count; // 32bit value indicating the total number of free blocks, including the number of reserved blocks
     uint32_t s_free_inodes_count; // 32bit value indicating the total number of free inodes. This is a sum of all free inodes of all the block groups.
     uint32_t s_first_data_block;  // 32bit value identifying the first data block, in other word the id of the block containing the superblock structure.
+    uint32_t s_log_block_size;    // block size = 1024 << s_log_block_size, 0 (1 KiB) to EXT2_MAX_LOG_BLOCK_SIZE (4 KiB)
     uint32_t s_first_ino;         // 32bit value indicating the first inode that can be used. Set this to 1, indicating root inode (maybe)
 
     uint32_t s_blocks_per_group;
@@ -90,8 +169,19 @@ struct EXT2Superblock
     uint8_t s_prealloc_blocks;     // 8bit value indicating the number of blocks to preallocate for files.
     uint8_t s_prealloc_dir_blocks; // 8bit value indicating the number of blocks to preallocate for directories.
 
+    uint32_t s_journal_block;  // first block of metadata journal, holding EXT2JournalSuperblock. In place of ext3 s_journal_inum
+    uint32_t s_journal_blocks; // journal length in blocks, 0 if filesystem has no journal
+
 } __attribute__((packed));
 
+/**
+ * Block group flags (bg_flags), same values as ext4. Only group 0 is written by create_ext2(),
+ * other groups are initialized on first allocation
+ */
+#define EXT2_BG_INODE_UNINIT 0x0001 // inode bitmap never written, every inode of group is free
+#define EXT2_BG_BLOCK_UNINIT 0x0002 // block bitmap never written, only bitmaps & inode table of group are used
+#define EXT2_BG_INODE_ZEROED 0x0004 // inode table is zeroed on disk
+
 /**
  * reference:
  * - https://www.nongnu.org/ext2-doc/ext2.html#block-group-descriptor-table
@@ -127,9 +217,9 @@ struct EXT2BlockGroupDescriptor
     uint16_t bg_used_dirs_count;
 
     /**
-     * 16bit value used for padding the structure on a 32bit boundary.
+     * 16bit EXT2_BG_* flags, lazy initialization state of the group. Padding (0) in images of older versions
      */
-    uint16_t bg_pad;
+    uint16_t bg_flags;
 
     /**
      * 12 bytes of reserved space for future revisions.
@@ -156,6 +246,7 @@ struct EXT2Inode
     uint16_t i_mode;   // 16bit value indicating the file type and the access rights.
     uint32_t i_size;   // 32bit value indicating the size of the file in bytes.
     uint32_t i_blocks; // 32bit value indicating the number of blocks used by the file.
+    uint32_t i_flags;  // 32bit value indicating how the filesystem should treat this inode, ex: EXT2_INDEX_FL
 
     /**
      * 15 x 32bit block numbers pointing to the blocks containing the data for this inode
@@ -174,9 +265,61 @@ struct EXT2Inode
 
 } __attribute__((packed));
 
+/**
+ * EXT2MemInode
+ * Aligned in-memory form of EXT2Inode held by the inode cache, only touched through iget() / iput()
+ */
+struct EXT2MemInode
+{
+    uint32_t inode;                  // inode number, 0 if cache slot is free
+    uint32_t refcount;               // pin count, pinned inode is never evicted
+    uint32_t last_used;              // cache clock of last iget(), least recently used slot is reused
+    bool dirty;                      // newer than inode table, written back on commit / eviction
+    struct EXT2MemInode *hash_next;  // next inode in the same hash bucket
+    uint16_t i_mode;                 // same meaning as EXT2Inode fields
+    uint32_t i_size;
+    uint32_t i_blocks;
+    uint32_t i_flags;
+    uint32_t i_block[15];
+    uint32_t prealloc_block;         // first block of preallocation window, reserved in memory only
+    uint32_t prealloc_count;         // blocks left in preallocation window, 0 if inode has no window
+    bool unlinked;                   // deleted while open, blocks & inode are freed on last file_close()
+};
+
+/**
+ * EXT2OpenFile
+ * One file descriptor, inode stays pinned in inode cache while open
+ */
+struct EXT2OpenFile
+{
+    struct EXT2MemInode *node; // NULL if descriptor is free
+    uint32_t offset;           // position of file_read() / file_write()
+    uint32_t flags;            // EXT2_O_* given to file_open()
+};
+
+/**
+ * EXT2FileTable
+ * File descriptor table of one process, descriptor is index in files. Zero filled table has every descriptor free
+ */
+struct EXT2FileTable
+{
+    struct EXT2OpenFile files[EXT2_MAX_OPEN_FILES];
+};
+
+/**
+ * EXT2WorkingDirectory
+ * Per process working directory, path is kept normalized so getcwd does not walk ".." up to root
+ */
+struct EXT2WorkingDirectory
+{
+    uint32_t inode;
+    uint32_t path_len;        // strlen(path)
+    char path[EXT2_PATH_MAX]; // absolute, no trailing '/' except root "/"
+};
+
 struct EXT2InodeTable
 {
-    struct EXT2Inode table[INODES_PER_GROUP]; // can be change with fixed size array
+    struct EXT2Inode table[EXT2_MAX_INODES_PER_GROUP]; // can be change with fixed size array
 };
 
 /**
@@ -209,6 +352,125 @@ struct EXT2DirectoryEntry
 
 } __attribute__((packed));
 
+/**
+ * EXT2Dirent
+ * Directory entry returned by get_dirents() together with attributes of its inode.
+ * NUL terminated name follows the struct, rec_len is the distance to the next EXT2Dirent
+ */
+struct EXT2Dirent
+{
+    uint32_t inode;
+    uint32_t size;     // i_size
+    uint16_t mode;     // i_mode
+    uint16_t rec_len;  // EXT2_DIRENT_LEN(name_len)
+    uint8_t name_len;
+    uint8_t file_type; // EXT2_FT_*
+} __attribute__((packed));
+
+#define EXT2_DIRENT_LEN(name_len) ((sizeof(struct EXT2Dirent) + (name_len) + 1 + 3) & ~3u) // 4 byte aligned
+
+/**
+ * EXT2DirentRequest
+ * cookie is the directory position to continue from, 0 for the first call. Listing is finished when
+ * a call returns buffer_size 0
+ */
+struct EXT2DirentRequest
+{
+    void *buf;
+    uint32_t dir_inode;
+    uint32_t buffer_size; // in: size of buf, out: bytes of EXT2Dirent written
+    uint32_t cookie;      // in: position to start from, out: position after the last returned entry
+} __attribute__((packed));
+
+/**
+ * Hash indexed directory (htree), single level
+ * reference:
+ * - https://www.kernel.org/doc/html/latest/filesystems/ext4/directory.html#hash-tree-directories
+ */
+#define EXT2_DX_HASH_FNV1A 0x10 // hash_version of this driver, FNV-1a of the name with bit 0 cleared
+#define EXT2_DX_ROOT_LIMIT(block_size) (((block_size) - 32) / sizeof(struct EXT2DxEntry))
+
+/**
+ * EXT2DxEntry
+ * Leaf block of hash range [hash, next entry hash). Bit 0 of hash set means the leaf continues
+ * a run of equal hashes from the previous leaf.
+ */
+struct EXT2DxEntry
+{
+    uint32_t hash;
+    uint32_t block; // leaf block index inside the directory, not disk block
+} __attribute__((packed));
+
+/**
+ * EXT2DxRoot
+ * Block 0 of indexed directory. "." and ".." are ordinary entries and ".." rec_len covers the rest of the
+ * block, so linear readers see the index as unused space. entries[0] has no hash, its hash field hold
+ * limit (low 16 bit) and count (high 16 bit) of entries instead.
+ */
+struct EXT2DxRoot
+{
+    struct EXT2DirectoryEntry dot;
+    char dot_name[4];
+    struct EXT2DirectoryEntry dotdot;
+    char dotdot_name[4];
+    uint32_t reserved_zero;
+    uint8_t hash_version;
+    uint8_t info_length;     // 8
+    uint8_t indirect_levels; // 0, leaves are referenced directly from root
+    uint8_t unused_flags;
+    struct EXT2DxEntry entries[EXT2_DX_ROOT_LIMIT(EXT2_MAX_BLOCK_SIZE)]; // only EXT2_DX_ROOT_LIMIT(block size) fit in the block
+} __attribute__((packed));
+
+/**
+ * Metadata journal, JBD style
+ * Contiguous area in group 0. Block 0 is EXT2JournalSuperblock, the rest is the log: each transaction is
+ * descriptor block(s) followed by a copy of each tagged block, closed by a commit block
+ * reference:
+ * - https://www.kernel.org/doc/html/latest/filesystems/ext4/journal.html
+ */
+#define EXT2_JOURNAL_SIZE 262144u           // bytes of journal area, s_journal_blocks = EXT2_JOURNAL_SIZE / block size
+#define EXT2_JOURNAL_MAGIC 0xC03B3998u      // h_magic of every journal block
+#define EXT2_JOURNAL_DESCRIPTOR_BLOCK 1
+#define EXT2_JOURNAL_COMMIT_BLOCK 2
+#define EXT2_JOURNAL_SUPERBLOCK 3
+#define EXT2_JOURNAL_FLAG_ESCAPE 1          // first word of the logged block equals EXT2_JOURNAL_MAGIC, zeroed in log
+#define EXT2_JOURNAL_FLAG_LAST_TAG 8        // last tag of descriptor block
+#define EXT2_JOURNAL_FLAG_REVOKE 16         // no logged copy, block is not replayed from older transactions
+
+struct EXT2JournalHeader
+{
+    uint32_t h_magic;
+    uint32_t h_blocktype; // EXT2_JOURNAL_DESCRIPTOR_BLOCK, EXT2_JOURNAL_COMMIT_BLOCK or EXT2_JOURNAL_SUPERBLOCK
+    uint32_t h_sequence;  // transaction id, 0 for journal superblock
+} __attribute__((packed));
+
+/**
+ * EXT2JournalSuperblock
+ * s_start 0 means every committed transaction is already written in place (checkpointed), nothing to replay
+ */
+struct EXT2JournalSuperblock
+{
+    struct EXT2JournalHeader s_header;
+    uint32_t s_blocksize; // filesystem block size
+    uint32_t s_maxlen;    // journal length in blocks, superblock included
+    uint32_t s_first;     // first log block, relative to journal start
+    uint32_t s_sequence;  // id of transaction at s_start
+    uint32_t s_start;     // log block of oldest transaction not yet checkpointed, 0 if clean
+} __attribute__((packed));
+
+// Tag in descriptor block, data copies follow the descriptor in tag order (revoke tags have no copy)
+struct EXT2JournalBlockTag
+{
+    uint32_t t_blocknr; // home location of the block
+    uint32_t t_flags;   // EXT2_JOURNAL_FLAG_*
+} __attribute__((packed));
+
+struct EXT2JournalCommit
+{
+    struct EXT2JournalHeader c_header;
+    uint32_t c_checksum; // FNV-1a of every descriptor & logged block of the transaction, detect torn log write
+} __attribute__((packed));
+
 /**
  *  REGULAR function
  */
@@ -220,6 +482,9 @@ struct EXT2DirectoryEntry
  */
 char *get_entry_name(void *entry);
 
+// Name of EXT2Dirent, right after the struct
+char *get_dirent_name(struct EXT2Dirent *dirent);
+
 /**
  * get the directory entry from the buffer
  * @param ptr the buffer that contains the directory table
@@ -253,18 +518,45 @@ uint32_t get_dir_first_child_offset(void *ptr);
 
 /**
  * @brief get bgd index from inode, inode will starts at index 1
- * @param inode 1 to INODES_PER_GROUP * GROUP_COUNT
+ * @param inode 1 to s_inodes_per_group * GROUP_COUNT
  * @return bgd index (0 to GROUP_COUNT - 1)
  */
 uint32_t inode_to_bgd(uint32_t inode);
 
 /**
  * @brief get inode local index in the corrresponding bgd
- * @param inode 1 to INODES_PER_GROUP * GROUP_COUNT
+ * @param inode 1 to s_inodes_per_group * GROUP_COUNT
  * @return local index
  */
 uint32_t inode_to_local(uint32_t inode);
 
+/**
+ * @brief map file block index to disk block through direct, single and doubly indirect pointers
+ * @param node inode of the file
+ * @param index block index inside the file, starts at 0
+ * @return disk block number, 0 if index is not allocated or file has EXT2_INLINE_DATA_FL
+ */
+uint32_t get_file_block(struct EXT2MemInode *node, uint32_t index);
+
+/**
+ * @brief pin inode in inode cache, inode table is only read on cache miss
+ * @param inode 1 to s_inodes_per_group * GROUP_COUNT
+ * @return pinned inode, release with iput(). NULL if inode is out of range or every cache slot is pinned
+ */
+struct EXT2MemInode *iget(uint32_t inode);
+
+/**
+ * @brief unpin inode from iget(), NULL is ignored
+ * @param node pinned inode
+ */
+void iput(struct EXT2MemInode *node);
+
+/**
+ * @brief mark pinned inode as modified, all dirty inodes of the same inode table sector are written together on commit
+ * @param node pinned inode
+ */
+void inode_mark_dirty(struct EXT2MemInode *node);
+
 /**
  * @brief create a new directory using given node
  * first item of directory table is its node location (name will be .)
@@ -273,7 +565,7 @@ uint32_t inode_to_local(uint32_t inode);
  * @param inode inode that already allocated
  * @param parent_inode inode of parent directory (if root directory, the parent is itself)
  */
-void init_directory_table(struct EXT2Inode *node, uint32_t inode, uint32_t parent_inode);
+void init_directory_table(struct EXT2MemInode *node, uint32_t inode, uint32_t parent_inode);
 /**
  * @brief check whether filesystem signature is missing or not in boot sector
  *
@@ -284,14 +576,34 @@ bool is_empty_storage(void);
 /**
  * @brief create a new EXT2 filesystem. Will write fs_signature into boot sector,
  * initialize super block, bgd table, block and inode bitmap, and create root directory
+ * @param log_block_size block size is 1024 << log_block_size, clamped to EXT2_MAX_LOG_BLOCK_SIZE
+ */
+void create_ext2(uint32_t log_block_size);
+
+/**
+ * @brief Mount file system on block device and initialize driver state, if is_empty_storage() then
+ * create_ext2(EXT2_DEFAULT_LOG_BLOCK_SIZE)
+ * Else, replay committed journal transactions that were not checkpointed yet, then read and cache super block
+ * (located at byte 1024) and bgd table (located at the block after it) into state
+ * @param device block device holding the file system, all file system I/O go through it
+ * @return 0 if mounted, -1 if superblock cannot be read or does not describe this disk (damaged, other geometry,
+ * old layout). Disk is left untouched, caller may format it explicitly with create_ext2()
  */
-void create_ext2(void);
+int8_t initialize_filesystem_ext2(struct BlockDevice *device);
 
 /**
- * @brief Initialize file system driver state, if is_empty_storage() then create_ext2()
- * Else, read and cache super block (located at block 1) and bgd table (located at block 2) into state
+ * @brief Commit running journal transaction. Every operation ends by calling this without force, metadata
+ * change is grouped and committed once the transaction is large or old enough
+ * @param force commit even if the transaction is small and young, ex: before shutdown
  */
-void initialize_filesystem_ext2(void);
+void journal_commit(bool force);
+
+/**
+ * @brief Zero the inode table of one group still marked EXT2_BG_INODE_UNINIT, background part of lazy create_ext2().
+ * Called while idle, a group is also zeroed on its first inode allocation
+ * @return true if a group was zeroed, false if every inode table is already initialized
+ */
+bool inode_table_lazy_init(void);
 
 /**
  * @brief check whether a directory table has children or not
@@ -310,19 +622,46 @@ bool is_directory_empty(uint32_t inode);
 int8_t read_directory(struct EXT2DriverRequest *request);
 
 /**
- * @brief EXT2 read, read a file from file system
+ * @brief EXT2 getdents, list a folder in batches with size and mode of every entry, resumable through cookie.
+ * Inode table block is pinned once for every run of entries in it, not once per entry
+ * @param request buf is filled with as many EXT2Dirent as fit, empty entries are skipped
+ * @return Error code: 0 success (buffer_size 0 at end of folder) - 1 not a folder - 2 buffer too small for the next entry - 3 folder invalid
+ */
+int8_t get_dirents(struct EXT2DirentRequest *request);
+
+/**
+ * @brief EXT2 read, read a file from file system. File of at most EXT2_INLINE_DATA_MAX bytes is copied
+ * from its inode without reading any data block, hole (block pointer 0) is read as zeros without disk I/O
  * @param request All attribute will be used except is_dir for read, buffer_size will limit reading count
  * @return Error code: 0 success - 1 not a file - 2 not enough buffer - 3 not found - 4 parent folder invalid - -1 unknown
  */
 int8_t read(struct EXT2DriverRequest *request);
 
 /**
- * @brief EXT2 write, write a file or a folder to file system
+ * @brief EXT2 lookup, find one name in directory through directory entry cache
+ * @param request name, name_len and parent_inode are used. If buffer_size is large enough,
+ * the matching struct EXT2DirectoryEntry (without name) is copied into buf
+ * @return Error code: 0 found - 1 not found - 2 parent folder invalid
+ */
+int8_t lookup(struct EXT2DriverRequest *request);
+
+/**
+ * @brief EXT2 write, write a file or a folder to file system. File of at most EXT2_INLINE_DATA_MAX bytes
+ * is stored in i_block of its inode with EXT2_INLINE_DATA_FL, without any data block. Block of a larger file
+ * that is all zeros is left as a hole
  *
  * @param All attribute will be used for write except is_dir, buffer_size == 0 then create a folder / directory. It is possible that exist file with name same as a folder
  * @return Error code: 0 success - 1 file/folder already exist - 2 invalid parent folder - -1 unknown
  */
 int8_t write(struct EXT2DriverRequest *request);
+
+/**
+ * @brief EXT2 fallocate, reserve blocks of a file up front as one contiguous extent when possible
+ * Missing file is created empty first. New blocks are zero filled, file size is extended to buffer_size if smaller
+ * @param request name, name_len and parent_inode select the file, buffer_size is the size to allocate for, buf is unused
+ * @return Error code: 0 success - 1 not a file - 2 invalid parent folder - -1 no space
+ */
+int8_t fallocate(struct EXT2DriverRequest *request);
 /**
  * @brief EXT2 delete, delete a file or empty directory in file system
  *  @param request buf and buffer_size is unused, is_dir == true means delete folder (possible file with name same as folder)
@@ -330,6 +669,79 @@ int8_t write(struct EXT2DriverRequest *request);
  */
 int8_t delete (struct EXT2DriverRequest *request);
 
+/* =============================== FILE DESCRIPTOR ======================================== */
+
+/**
+ * @brief open a regular file and pin its inode, following operations do not look up the name again
+ * @param table file descriptor table of the calling process
+ * @param request name, name_len and parent_inode select the file, buf and buffer_size are unused
+ * @param flags EXT2_O_* access mode with EXT2_O_CREAT, EXT2_O_TRUNC and EXT2_O_APPEND
+ * @return lowest free descriptor, or error code: -1 not found - -2 not a file - -3 invalid parent folder - -4 too many open files - -5 unknown
+ */
+int32_t file_open(struct EXT2FileTable *table, struct EXT2DriverRequest *request, uint32_t flags);
+
+/**
+ * @brief close descriptor, preallocation window of the file is discarded on its last close
+ * @return Error code: 0 success - 1 bad descriptor
+ */
+int8_t file_close(struct EXT2FileTable *table, int32_t fd);
+
+// Close every descriptor of table, ex: process exit
+void file_close_all(struct EXT2FileTable *table);
+
+/**
+ * @brief read up to count bytes at offset without moving descriptor position, only blocks under the range are touched
+ * @return bytes read, 0 at end of file, -1 bad descriptor or not opened for reading
+ */
+int32_t file_pread(struct EXT2FileTable *table, int32_t fd, void *buf, uint32_t count, uint32_t offset);
+
+/**
+ * @brief write count bytes at offset without moving descriptor position. Existing blocks are overwritten in place,
+ * file grows as needed, gap between old end of file and offset and new blocks that would only hold zeros are left
+ * as holes. EXT2_O_APPEND ignores offset.
+ * Empty or inline file stays inline while it fits EXT2_INLINE_DATA_MAX, then moves to its first data block
+ * @return bytes written (short if disk is full), -1 bad descriptor, not opened for writing or no space
+ */
+int32_t file_pwrite(struct EXT2FileTable *table, int32_t fd, const void *buf, uint32_t count, uint32_t offset);
+
+// Same as file_pread() / file_pwrite() at descriptor position, position is advanced by the transferred bytes
+int32_t file_read(struct EXT2FileTable *table, int32_t fd, void *buf, uint32_t count);
+int32_t file_write(struct EXT2FileTable *table, int32_t fd, const void *buf, uint32_t count);
+
+/**
+ * @brief move descriptor position, position may be past end of file. EXT2_SEEK_DATA / EXT2_SEEK_HOLE
+ * search at block granularity, unallocated block pointer (0) inside the file is a hole
+ * @param whence EXT2_SEEK_SET, EXT2_SEEK_CUR, EXT2_SEEK_END, EXT2_SEEK_DATA or EXT2_SEEK_HOLE
+ * @return new position, -1 bad descriptor, bad whence, position out of range or no data after offset
+ */
+int32_t file_lseek(struct EXT2FileTable *table, int32_t fd, int32_t offset, uint32_t whence);
+
+/* =============================== PATH ======================================== */
+
+// Set working directory to root
+void working_directory_init(struct EXT2WorkingDirectory *cwd);
+
+/**
+ * @brief EXT2 namei, resolve a whole path in one call. Every component goes through directory entry cache,
+ * no directory is copied out
+ * @param cwd working directory for relative path, NULL resolves relative path from root
+ * @param request path and path_len are used, stat is filled when found
+ * @return Error code: 0 found - 1 not found - 2 a component before the last is not a folder - 3 invalid path (empty or name longer than 255) - -1 unknown
+ */
+int8_t namei(struct EXT2WorkingDirectory *cwd, struct EXT2PathRequest *request);
+
+/**
+ * @brief change working directory, stat of the new working directory is filled
+ * @return Error code: same as namei() - 2 also if the last component is not a folder - 3 also if the new path is longer than EXT2_PATH_MAX
+ */
+int8_t change_directory(struct EXT2WorkingDirectory *cwd, struct EXT2PathRequest *request);
+
+/**
+ * @brief copy working directory path with terminating NUL into buf
+ * @return Error code: 0 success - 1 buffer too small
+ */
+int8_t get_working_directory(struct EXT2WorkingDirectory *cwd, char *buf, uint32_t size);
+
 /* =============================== MEMORY ==========================================*/
 
 /**
@@ -366,16 +778,18 @@ void deallocate_blocks(void *loc, uint32_t blocks);
 uint32_t deallocate_block(uint32_t *locations, uint32_t blocks, struct BlockBuffer *bitmap, uint32_t depth, uint32_t *last_bgd, bool bgd_loaded);
 
 /**
- * @brief write node->block in the given node, will allocate
- * at least node->blocks number of blocks, if first 12 item of node-> block
- * is not enough, will use indirect blocks
+ * @brief write ptr into node->i_block of an empty node, will allocate
+ * size / BLOCK_SIZE blocks (rounded up), if first 12 item of node->i_block
+ * is not enough, will use single and doubly indirect blocks. Each indirect block is filled in memory and written once.
+ * Block whose bytes in ptr are all zero is not allocated (hole)
  * @param ptr the buffer that needs to be written
- * @param node pointer of the node
- * @param preffered_bgd it is located at the node inode bgd
+ * @param node pinned node, i_block and i_blocks (indirect blocks included) are updated
+ * @param size number of bytes of ptr, tail of the last block is zero filled
+ * @return false if disk is full, blocks allocated so far stay in node->i_block
  *
  * @attention only implement until doubly indirect block, if you want to implement triply indirect block please increase the storage size to at least 256MB
  */
-void allocate_node_blocks(void *ptr, struct EXT2Inode *node, uint32_t prefered_bgd);
+bool allocate_node_blocks(void *ptr, struct EXT2MemInode *node, uint32_t size);
 
 /**
  * @brief update the node to the disk
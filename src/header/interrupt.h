@@ -134,6 +134,12 @@ struct InterruptFrame
 // Activate PIC mask for keyboard only
 void activate_keyboard_interrupt(void);
 
+// Activate PIC mask for primary ATA channel, including slave PIC cascade line
+void activate_ata_interrupt(void);
+
+// Activate PIC mask for PCI interrupt line, return false if irq is not IRQ_PERIPHERAL_1-3 (driver should poll)
+bool activate_pci_interrupt(uint8_t irq);
+
 // I/O port wait, around 1-4 microsecond, for I/O synchronization purpose
 void io_wait(void);
 
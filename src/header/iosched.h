@@ -0,0 +1,158 @@
+#ifndef _IOSCHED_H
+#define _IOSCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "header/disk.h"
+
+struct BlockDevice;
+
+/* -- I/O scheduler limits -- */
+#define IOSCHED_MAX_PENDING       64  // Queue slots, queue is dispatched when all slots are used
+#define IOSCHED_MAX_MERGE_BLOCKS  64  // Upper bound of merge window, size of merge staging buffer
+
+/* -- Default tunables -- */
+#define IOSCHED_DEFAULT_MERGE_WINDOW   IOSCHED_MAX_MERGE_BLOCKS
+#define IOSCHED_DEFAULT_READ_EXPIRE    4   // Dispatched commands a read may be passed over by C-LOOK
+#define IOSCHED_DEFAULT_WRITE_EXPIRE   16  // Dispatched commands a write may be passed over by C-LOOK
+#define IOSCHED_DEFAULT_MAX_PENDING    IOSCHED_MAX_PENDING
+
+/**
+ * IOQueueTunables, per-queue scheduler knobs
+ *
+ * @param merge_window Maximum blocks of one merged command, 1 disable merging (1 to IOSCHED_MAX_MERGE_BLOCKS)
+ * @param read_expire  Deadline of read, in dispatched commands since the read is queued
+ * @param write_expire Deadline of write, in dispatched commands since the write is queued
+ * @param max_pending  Queue is dispatched once this many requests are pending (1 to IOSCHED_MAX_PENDING)
+ */
+struct IOQueueTunables {
+    uint32_t merge_window;
+    uint32_t read_expire;
+    uint32_t write_expire;
+    uint32_t max_pending;
+};
+
+/**
+ * IORequest, one pending request inside I/O queue
+ *
+ * @param in_use                Slot is holding pending request
+ * @param staged                Request is part of merged command using IOQueue.staging
+ * @param is_write              True for write
+ * @param logical_block_address First block
+ * @param block_count           Block count, write is always queued per block
+ * @param buf                   Caller buffer for read, IOQueue.write_data slot for write
+ * @param deadline              Dispatch clock value when this request must be served
+ * @param status                Read: where completion status is stored, NULL if caller does not need it
+ */
+struct IORequest {
+    bool     in_use;
+    bool     staged;
+    bool     is_write;
+    uint32_t logical_block_address;
+    uint32_t block_count;
+    void    *buf;
+    uint32_t deadline;
+    int8_t  *status;
+};
+
+/**
+ * IOQueue, elevator (C-LOOK with deadline) between filesystem and disk driver.
+ * Requests queued while plugged are sorted by LBA and adjacent requests of same direction are merged
+ * into one disk command when the queue is unplugged. Queued write data is copied, caller buffer can be reused.
+ * All commands of one flush are submitted before waiting, so controller with command queuing serve them concurrently.
+ *
+ * @param device         Block device requests are dispatched to
+ * @param tunables       Scheduler knobs
+ * @param requests       Pending request slots
+ * @param write_data     Copy of pending write data, one block per slot
+ * @param pending        Number of pending requests
+ * @param plug_depth     Nested plug count, requests are dispatched when it drop to 0
+ * @param head_position  Block next to last dispatched command, C-LOOK sweep position
+ * @param dispatch_clock Number of dispatched commands, used for deadline
+ * @param staging        Contiguous buffer for merged command
+ * @param staged_command In-flight command using staging, NULL if staging is free
+ * @param inflight       Commands submitted by current flush
+ * @param inflight_count Number of used inflight entry
+ * @param read_status    IORequest.status of inflight entry, NULL for write
+ * @param write_error    -1 once a queued write failed, reported & cleared by iosched_flush()
+ */
+struct IOQueue {
+    struct BlockDevice    *device;
+    struct IOQueueTunables tunables;
+    struct IORequest       requests[IOSCHED_MAX_PENDING];
+    struct BlockBuffer     write_data[IOSCHED_MAX_PENDING];
+    uint32_t               pending;
+    uint32_t               plug_depth;
+    uint32_t               head_position;
+    uint32_t               dispatch_clock;
+    struct BlockBuffer     staging[IOSCHED_MAX_MERGE_BLOCKS];
+    struct DiskRequest    *staged_command;
+    struct DiskRequest     inflight[IOSCHED_MAX_PENDING];
+    uint32_t               inflight_count;
+    int8_t                *read_status[IOSCHED_MAX_PENDING];
+    int8_t                 write_error;
+};
+
+// Reset queue to empty state with default tunables, requests are dispatched to device
+void iosched_init(struct IOQueue *queue, struct BlockDevice *device);
+
+/**
+ * Replace queue tunables, value is clamped to valid range
+ *
+ * @param queue    Target queue
+ * @param tunables New tunables
+ */
+void iosched_set_tunables(struct IOQueue *queue, const struct IOQueueTunables *tunables);
+
+// Start batching, requests are held until matching iosched_unplug(). Can be nested
+void iosched_plug(struct IOQueue *queue);
+
+// End batching, dispatch all pending requests when outermost plug is released. Return iosched_flush() status, 0 if still plugged
+int8_t iosched_unplug(struct IOQueue *queue);
+
+/**
+ * Dispatch all pending requests regardless of plug, return after all of them are completed
+ *
+ * @param queue Target queue
+ * @return      0, or -1 if a write queued since last flush failed (including write dispatched by full queue)
+ */
+int8_t iosched_flush(struct IOQueue *queue);
+
+/**
+ * Blocking read, pending writes to the same blocks are honored
+ *
+ * @param queue                 Target queue
+ * @param ptr                   Buffer, size block_count * BLOCK_SIZE
+ * @param logical_block_address First block
+ * @param block_count           Block count
+ * @return                      0, or -1 if device reported error
+ */
+int8_t iosched_read(struct IOQueue *queue, void *ptr, uint32_t logical_block_address, uint32_t block_count);
+
+/**
+ * Queued read, buffer is filled at latest when queue is unplugged / flushed.
+ * Caller must not touch the buffer before that. Served immediately if queue is not plugged.
+ *
+ * @param queue                 Target queue
+ * @param ptr                   Buffer, size block_count * BLOCK_SIZE
+ * @param logical_block_address First block
+ * @param block_count           Block count
+ * @param status                Optional, completion status is stored here once buffer is filled (0 or -1)
+ * @return                      Status of read served immediately, 0 if queued
+ */
+int8_t iosched_read_async(struct IOQueue *queue, void *ptr, uint32_t logical_block_address, uint32_t block_count, int8_t *status);
+
+/**
+ * Queued write, data is copied into queue so buffer can be reused right away.
+ * Later write to the same pending block replace the queued data. Written immediately if queue is not plugged.
+ *
+ * @param queue                 Target queue
+ * @param ptr                   Data, size block_count * BLOCK_SIZE
+ * @param logical_block_address First block
+ * @param block_count           Block count
+ * @return                      Status of write served immediately, 0 if queued (see iosched_flush())
+ */
+int8_t iosched_write(struct IOQueue *queue, const void *ptr, uint32_t logical_block_address, uint32_t block_count);
+
+#endif
@@ -3,6 +3,28 @@
 
 #include "header/cpu/gdt.h"
 
+// Multiboot info flags bit 2, cmdline field is valid
+#define MULTIBOOT_INFO_CMDLINE 0x4
+
+/**
+ * Start of multiboot information structure, physical address is passed by GRUB in ebx
+ * and forwarded to kernel_setup() by kernel-entrypoint.s
+ *
+ * @param flags       Which field below is valid
+ * @param mem_lower   Lower memory size in KiB
+ * @param mem_upper   Upper memory size in KiB
+ * @param boot_device BIOS boot device
+ * @param cmdline     Physical address of kernel command line (null terminated), ex: "/boot/kernel disk=virtio"
+ */
+struct MultibootInfo
+{
+    uint32_t flags;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+    uint32_t boot_device;
+    uint32_t cmdline;
+} __attribute__((packed));
+
 /**
  * Load GDT from gdtr and complete init for protected mode. This procedure implemented in asm.
  * Note: This procedure will not activate CPU interrupt flag
@@ -14,6 +14,9 @@
 // Maximum usable page frame. Default count: 128 / 4 = 32 page frame
 #define PAGE_FRAME_MAX_COUNT ((SYSTEM_MEMORY_MB << 20) / PAGE_FRAME_SIZE)
 
+// Higher half base, physical frame 0 (kernel image) is mapped here by kernel-entrypoint.s
+#define KERNEL_VIRTUAL_BASE 0xC0000000
+
 // Operating system page directory, using page size PAGE_FRAME_SIZE (4 MiB)
 extern struct PageDirectory _paging_kernel_page_directory;
 
@@ -125,6 +128,15 @@ bool paging_allocate_check(uint32_t amount);
  */
 bool paging_allocate_user_page_frame(struct PageDirectory *page_dir, void *virtual_addr);
 
+/**
+ * Allocate single supervisor-only page frame in page directory, ex: RAM disk storage
+ *
+ * @param page_dir     Page directory to update
+ * @param virtual_addr Virtual address to be allocated
+ * @return             Will return true if success, false if no free frame
+ */
+bool paging_allocate_kernel_page_frame(struct PageDirectory *page_dir, void *virtual_addr);
+
 /**
  * Deallocate single user page frame in page directory
  *
@@ -134,4 +146,22 @@ bool paging_allocate_user_page_frame(struct PageDirectory *page_dir, void *virtu
  */
 bool paging_free_user_page_frame(struct PageDirectory *page_dir, void *virtual_addr);
 
+/**
+ * Translate virtual address with page directory, used for device DMA address
+ *
+ * @param page_dir      Page directory to walk
+ * @param virtual_addr  Virtual address to translate
+ * @param physical_addr Output physical address
+ * @return              False if virtual address is not mapped
+ */
+bool paging_virtual_to_physical(struct PageDirectory *page_dir, const void *virtual_addr, uint32_t *physical_addr);
+
+/**
+ * Identity map 4 MiB frame containing device register (MMIO) with cache disabled in kernel page directory
+ *
+ * @param physical_addr Physical address of device register
+ * @return              Virtual address of physical_addr, NULL if frame collide with kernel or user frame
+ */
+void *paging_map_mmio(uint32_t physical_addr);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,129 @@
+#ifndef _PCI_H
+#define _PCI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* -- PCI configuration mechanism #1 ports -- */
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+
+#define PCI_MAX_BUS        256
+#define PCI_MAX_SLOT       32
+#define PCI_MAX_FUNCTION   8
+#define PCI_MAX_DEVICES    32  // Functions recorded by pci_init(), the rest is ignored
+
+/* -- PCI configuration space register offsets (header type 0x00) -- */
+#define PCI_VENDOR_ID      0x00
+#define PCI_DEVICE_ID      0x02
+#define PCI_COMMAND        0x04
+#define PCI_STATUS         0x06
+#define PCI_REVISION_ID    0x08
+#define PCI_PROG_IF        0x09
+#define PCI_SUBCLASS       0x0A
+#define PCI_CLASS_CODE     0x0B
+#define PCI_HEADER_TYPE    0x0E
+#define PCI_BAR0           0x10
+#define PCI_SUBSYSTEM_ID   0x2E
+#define PCI_INTERRUPT_LINE 0x3C
+
+#define PCI_VENDOR_NONE    0xFFFF
+#define PCI_HEADER_MULTIFUNCTION 0x80
+
+/* -- PCI command register bits -- */
+#define PCI_COMMAND_IO           0x0001
+#define PCI_COMMAND_MEMORY       0x0002
+#define PCI_COMMAND_BUS_MASTER   0x0004
+
+/* -- PCI BAR bits -- */
+#define PCI_BAR_IO               0x1
+#define PCI_BAR_IO_MASK          0xFFFFFFFC
+#define PCI_BAR_MEMORY_MASK      0xFFFFFFF0
+
+/* -- Class codes used by kernel drivers -- */
+#define PCI_CLASS_MASS_STORAGE   0x01
+#define PCI_SUBCLASS_IDE         0x01
+#define PCI_PROG_IF_IDE_BUS_MASTER 0x80
+#define PCI_SUBCLASS_SATA        0x06
+#define PCI_PROG_IF_AHCI         0x01
+
+/**
+ * PCIDevice, location and identification of one PCI function
+ *
+ * @param bus            Bus number
+ * @param slot           Device number on the bus
+ * @param function       Function number on the device
+ * @param vendor_id      Vendor identifier
+ * @param device_id      Device identifier
+ * @param class_code     Base class code
+ * @param subclass       Subclass code
+ * @param prog_if        Programming interface
+ * @param subsystem_id   Subsystem identifier, ex: virtio device type for legacy virtio
+ * @param interrupt_line Legacy PIC IRQ line routed by firmware
+ */
+struct PCIDevice {
+    uint8_t  bus;
+    uint8_t  slot;
+    uint8_t  function;
+    uint16_t vendor_id;
+    uint16_t device_id;
+    uint8_t  class_code;
+    uint8_t  subclass;
+    uint8_t  prog_if;
+    uint16_t subsystem_id;
+    uint8_t  interrupt_line;
+};
+
+// Every function found by pci_init()
+extern struct PCIDevice pci_devices[PCI_MAX_DEVICES];
+extern uint32_t         pci_device_count;
+
+// Read 32-bit register from PCI configuration space, offset will be aligned to 4 bytes
+uint32_t pci_config_read32(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset);
+
+// Read 16-bit register from PCI configuration space, offset will be aligned to 2 bytes
+uint16_t pci_config_read16(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset);
+
+// Write 32-bit register into PCI configuration space, offset will be aligned to 4 bytes
+void pci_config_write32(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset, uint32_t value);
+
+// Write 16-bit register into PCI configuration space, offset will be aligned to 2 bytes
+void pci_config_write16(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset, uint16_t value);
+
+// Enumerate every bus, slot and function into pci_devices. Call once before any driver probe
+void pci_init(void);
+
+/**
+ * Find first enumerated device with matching class
+ *
+ * @param class_code Base class code to search
+ * @param subclass   Subclass code to search
+ * @param device     Output, filled with the matching device when found
+ * @return           True if a matching device is found
+ */
+bool pci_find_class(uint8_t class_code, uint8_t subclass, struct PCIDevice *device);
+
+/**
+ * Find first enumerated device with matching vendor & device identifier
+ *
+ * @param vendor_id Vendor identifier to search
+ * @param device_id Device identifier to search
+ * @param device    Output, filled with the matching device when found
+ * @return          True if a matching device is found
+ */
+bool pci_find_device(uint16_t vendor_id, uint16_t device_id, struct PCIDevice *device);
+
+/**
+ * Read base address register of device, flag bits are kept as-is
+ *
+ * @param device PCI device
+ * @param index  BAR index, 0 to 5
+ * @return       Raw BAR value
+ */
+uint32_t pci_read_bar(const struct PCIDevice *device, uint8_t index);
+
+// Set IO space, memory space and bus master enable bit in device command register
+void pci_enable_bus_master(const struct PCIDevice *device);
+
+#endif
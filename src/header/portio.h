@@ -7,5 +7,9 @@ void out(uint16_t port, uint8_t val);
 uint8_t in(uint16_t port);
 void out16(uint16_t port, uint16_t data);
 uint16_t in16(uint16_t port);
+void out32(uint16_t port, uint32_t data);
+uint32_t in32(uint16_t port);
+void in16_rep(uint16_t port, void *buf, uint32_t count);
+void out16_rep(uint16_t port, const void *buf, uint32_t count);
 
 #endif
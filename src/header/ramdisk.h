@@ -0,0 +1,20 @@
+#ifndef _RAMDISK_H
+#define _RAMDISK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "header/blockdev.h"
+
+/**
+ * Make block device backed by memory. Request is completed synchronously inside submit,
+ * no I/O queue is attached (device->queue is NULL). Device is registered to block layer.
+ *
+ * @param device  Device to initialize
+ * @param name    Device name
+ * @param storage Backing memory, contents is kept as-is
+ * @param size    Backing memory size in bytes, rounded down to BLOCK_SIZE
+ */
+void ramdisk_init(struct BlockDevice *device, const char *name, void *storage, uint32_t size);
+
+#endif
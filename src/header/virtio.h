@@ -0,0 +1,130 @@
+#ifndef _VIRTIO_H
+#define _VIRTIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "header/disk.h"
+
+/* -- Legacy (transitional) virtio PCI identification -- */
+#define VIRTIO_PCI_VENDOR_ID          0x1AF4
+#define VIRTIO_PCI_DEVICE_BLK_LEGACY  0x1001
+#define VIRTIO_SUBSYSTEM_BLK          2
+
+/* -- Legacy virtio PCI registers, offset from I/O BAR0 -- */
+#define VIRTIO_PCI_DEVICE_FEATURES    0x00
+#define VIRTIO_PCI_GUEST_FEATURES     0x04
+#define VIRTIO_PCI_QUEUE_ADDRESS      0x08  // Physical page number of virtqueue
+#define VIRTIO_PCI_QUEUE_SIZE         0x0C
+#define VIRTIO_PCI_QUEUE_SELECT       0x0E
+#define VIRTIO_PCI_QUEUE_NOTIFY       0x10
+#define VIRTIO_PCI_DEVICE_STATUS      0x12
+#define VIRTIO_PCI_ISR_STATUS         0x13  // Read acknowledge the interrupt
+#define VIRTIO_PCI_DEVICE_CONFIG      0x14
+#define VIRTIO_BLK_CONFIG_CAPACITY    (VIRTIO_PCI_DEVICE_CONFIG + 0x00)  // 64-bit device size in 512 byte sectors
+
+#define VIRTIO_STATUS_ACKNOWLEDGE     0x01
+#define VIRTIO_STATUS_DRIVER          0x02
+#define VIRTIO_STATUS_DRIVER_OK       0x04
+#define VIRTIO_STATUS_FAILED          0x80
+
+/* -- Split virtqueue -- */
+#define VIRTQ_DESC_F_NEXT             0x1
+#define VIRTQ_DESC_F_WRITE            0x2   // Buffer is written by device
+#define VIRTQ_USED_F_NO_NOTIFY        0x1   // Device ask driver not to notify
+#define VIRTQ_ALIGN                   0x1000
+// Legacy device dictate queue size, larger queue is refused
+#define VIRTQ_MAX_SIZE                256
+#define VIRTQ_ALIGN_UP(x)             (((x) + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1))
+// Legacy layout: descriptor table and available ring, used ring on next VIRTQ_ALIGN boundary
+#define VIRTQ_MEMORY_SIZE(size)       (VIRTQ_ALIGN_UP(16 * (size) + 6 + 2 * (size)) + VIRTQ_ALIGN_UP(6 + 8 * (size)))
+
+/* -- virtio-blk -- */
+#define VIRTIO_BLK_T_IN               0
+#define VIRTIO_BLK_T_OUT              1
+#define VIRTIO_BLK_T_FLUSH            4
+#define VIRTIO_BLK_F_FLUSH            (1u << 9)  // Device has write cache, VIRTIO_BLK_T_FLUSH write it back
+#define VIRTIO_BLK_S_OK               0
+// Data descriptors per request, data is split at 4 MiB page frame boundary
+#define VIRTIO_BLK_MAX_SEGMENTS       8
+#define VIRTIO_BLK_SEGMENT_MAX_BYTES  0x400000
+// Largest request chain that always fit segment limit, whatever buffer alignment is
+#define VIRTIO_BLK_MAX_BLOCKS         ((VIRTIO_BLK_MAX_SEGMENTS - 1) * VIRTIO_BLK_SEGMENT_MAX_BYTES / BLOCK_SIZE)
+
+/**
+ * VirtqDescriptor, one buffer of descriptor chain
+ *
+ * @param address Physical address of buffer
+ * @param length  Buffer size in bytes
+ * @param flags   VIRTQ_DESC_F_NEXT / VIRTQ_DESC_F_WRITE
+ * @param next    Next descriptor index if VIRTQ_DESC_F_NEXT
+ */
+struct VirtqDescriptor {
+    uint64_t address;
+    uint32_t length;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed));
+
+// Available ring, written by driver. ring has queue size entries
+struct VirtqAvailable {
+    uint16_t flags;
+    uint16_t index;
+    uint16_t ring[];
+} __attribute__((packed));
+
+// Used ring element, id is head descriptor of completed chain
+struct VirtqUsedElement {
+    uint32_t id;
+    uint32_t length;
+} __attribute__((packed));
+
+// Used ring, written by device. ring has queue size entries
+struct VirtqUsed {
+    uint16_t flags;
+    uint16_t index;
+    struct VirtqUsedElement ring[];
+} __attribute__((packed));
+
+/**
+ * VirtioBlkRequestHeader, first (device readable) descriptor of virtio-blk request
+ *
+ * @param type     VIRTIO_BLK_T_IN (read), VIRTIO_BLK_T_OUT (write) or VIRTIO_BLK_T_FLUSH
+ * @param reserved Zero
+ * @param sector   First 512 byte sector, 0 for flush
+ */
+struct VirtioBlkRequestHeader {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed));
+
+
+
+/**
+ * Find legacy virtio-blk PCI device, negotiate VIRTIO_BLK_F_FLUSH only and set up request queue 0
+ *
+ * @param irq      Output PIC IRQ line of device
+ * @param capacity Output device size in sectors
+ * @return         True if device is ready
+ */
+bool virtio_blk_init(uint8_t *irq, uint32_t *capacity);
+
+/**
+ * Put request into available ring, or queue it until enough descriptor is free.
+ * Device is not notified, see virtio_blk_kick(). Must be called with interrupt disabled.
+ *
+ * @param request Request to submit, must stay valid until request->done
+ */
+void virtio_blk_submit(struct DiskRequest *request);
+
+// Notify device once for every request made available since last kick. Must be called with interrupt disabled
+void virtio_blk_kick(void);
+
+/**
+ * Acknowledge interrupt, complete used chains and make waiting requests available.
+ * Called from PCI interrupt line or polled from disk_wait. Must be called with interrupt disabled.
+ */
+void virtio_blk_isr(void);
+
+#endif
@@ -3,6 +3,7 @@
 #include "header/framebuffer.h"
 #include "header/keyboard.h"
 #include "header/ext2.h"
+#include "header/blockdev.h"
 #include "header/stdlib/string.h"
 
 // Variabel global TSS
@@ -11,6 +12,10 @@ struct TSSEntry _interrupt_tss_entry = {
     .esp0 = 0,
 };
 
+// Tabel file descriptor proses user. Baru ada satu proses (shell), tabel pindah ke PCB jika ada scheduler
+static struct EXT2FileTable process_files;
+static struct EXT2WorkingDirectory process_cwd = {.inode = 2, .path_len = 1, .path = "/"};
+
 void set_tss_kernel_current_stack(void)
 {
     uint32_t stack_ptr;
@@ -50,6 +55,19 @@ void activate_keyboard_interrupt(void)
 {
     out(PIC1_DATA, in(PIC1_DATA) & ~(1 << IRQ_KEYBOARD));
 }
+void activate_ata_interrupt(void)
+{
+    out(PIC1_DATA, in(PIC1_DATA) & ~(1 << IRQ_CASCADE));
+    out(PIC2_DATA, in(PIC2_DATA) & ~(1 << (IRQ_PRIMARY_ATA - 8)));
+}
+bool activate_pci_interrupt(uint8_t irq)
+{
+    if (irq < IRQ_PERIPHERAL_1 || irq > IRQ_PERIPHERAL_3)
+        return false;
+    out(PIC1_DATA, in(PIC1_DATA) & ~(1 << IRQ_CASCADE));
+    out(PIC2_DATA, in(PIC2_DATA) & ~(1 << (irq - 8)));
+    return true;
+}
 
 void syscall_handler(struct InterruptFrame frame)
 {
@@ -81,6 +99,13 @@ void syscall_handler(struct InterruptFrame frame)
 
     case 4: // getchar()
         get_keyboard_buffer((char *)arg1);
+        // Shell idle menunggu keyboard: inode table group uninit dikosongkan satu group per panggilan,
+        // transaksi journal yang sudah cukup tua di-commit di sini
+        if (*(char *)arg1 == 0)
+        {
+            inode_table_lazy_init();
+            journal_commit(false);
+        }
         break;
 
     case 5: // putchar()
@@ -100,11 +125,84 @@ void syscall_handler(struct InterruptFrame frame)
         break;
 
     case 10: // exit
+        file_close_all(&process_files);
+        journal_commit(true);
         framebuffer_write_string(24, 0, "Program terminated.", 0xF, 0);
         while (1)
             __asm__("hlt");
         break;
 
+    case 11: // block_device_info()
+        *((int8_t *)arg3) = blockdev_info(arg1, (struct BlockDeviceInfo *)arg2) ? 0 : 1;
+        break;
+
+    case 12: // lookup()
+        *((int8_t *)arg2) = lookup((struct EXT2DriverRequest *)arg1);
+        break;
+
+    case 13: // fallocate()
+        *((int8_t *)arg2) = fallocate((struct EXT2DriverRequest *)arg1);
+        break;
+
+    case 14: // open()
+        *((int32_t *)arg3) = file_open(&process_files, (struct EXT2DriverRequest *)arg1, arg2);
+        break;
+
+    case 15: // close()
+        *((int8_t *)arg2) = file_close(&process_files, (int32_t)arg1);
+        break;
+
+    case 16: // read(fd)
+    {
+        struct EXT2FileRequest *request = (struct EXT2FileRequest *)arg1;
+        *((int32_t *)arg2) = file_read(&process_files, request->fd, request->buf, request->count);
+        break;
+    }
+
+    case 17: // write(fd)
+    {
+        struct EXT2FileRequest *request = (struct EXT2FileRequest *)arg1;
+        *((int32_t *)arg2) = file_write(&process_files, request->fd, request->buf, request->count);
+        break;
+    }
+
+    case 18: // pread()
+    {
+        struct EXT2FileRequest *request = (struct EXT2FileRequest *)arg1;
+        *((int32_t *)arg2) = file_pread(&process_files, request->fd, request->buf, request->count, request->offset);
+        break;
+    }
+
+    case 19: // pwrite()
+    {
+        struct EXT2FileRequest *request = (struct EXT2FileRequest *)arg1;
+        *((int32_t *)arg2) = file_pwrite(&process_files, request->fd, request->buf, request->count, request->offset);
+        break;
+    }
+
+    case 20: // lseek()
+    {
+        struct EXT2FileRequest *request = (struct EXT2FileRequest *)arg1;
+        *((int32_t *)arg2) = file_lseek(&process_files, request->fd, (int32_t)request->offset, request->whence);
+        break;
+    }
+
+    case 21: // namei()
+        *((int8_t *)arg2) = namei(&process_cwd, (struct EXT2PathRequest *)arg1);
+        break;
+
+    case 22: // chdir()
+        *((int8_t *)arg2) = change_directory(&process_cwd, (struct EXT2PathRequest *)arg1);
+        break;
+
+    case 23: // getcwd()
+        *((int8_t *)arg3) = get_working_directory(&process_cwd, (char *)arg1, arg2);
+        break;
+
+    case 24: // getdents()
+        *((int8_t *)arg2) = get_dirents((struct EXT2DirentRequest *)arg1);
+        break;
+
     default:
         break;
     }
@@ -125,6 +223,14 @@ void main_interrupt_handler(struct InterruptFrame frame)
     case PIC1_OFFSET + IRQ_KEYBOARD: // 0x21
         keyboard_isr();
         break;
+    case PIC1_OFFSET + IRQ_PRIMARY_ATA: // 0x2E
+        ata_isr();
+        break;
+    case PIC1_OFFSET + IRQ_PERIPHERAL_1: // 0x29
+    case PIC1_OFFSET + IRQ_PERIPHERAL_2: // 0x2A
+    case PIC1_OFFSET + IRQ_PERIPHERAL_3: // 0x2B
+        disk_pci_isr(frame.int_number - PIC1_OFFSET);
+        break;
     case 0x30:                  // Syscall
         syscall_handler(frame); // Panggil handler syscall
         break;
@@ -57,7 +57,8 @@ loader_virtual:
     ; Setup stack register (ESP) ke alamat virtualnya
     mov esp, kernel_stack + KERNEL_STACK_SIZE 
     
-    ; Panggil C kernel
+    ; Panggil C kernel, argumen: alamat fisik multiboot info dari GRUB (ebx)
+    push ebx
     call kernel_setup
 .loop:
     jmp .loop                                 ; loop forever
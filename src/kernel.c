@@ -6,18 +6,96 @@
 #include "header/kernel-entrypoint.h"
 #include "header/idt.h"
 #include "header/disk.h"
+#include "header/pci.h"
 #include "header/ext2.h"
+#include "header/ramdisk.h"
 #include "header/memory/paging.h" // Diperlukan untuk Paging
 #include <stdint.h>
 #include "header/stdlib/string.h" // Diperlukan untuk memset
 
+// RAM disk root (root=ram) menempati frame kernel tepat setelah higher half kernel
+#define KERNEL_RAMDISK_VIRTUAL_ADDR (KERNEL_VIRTUAL_BASE + PAGE_FRAME_SIZE)
+
+static struct BlockDevice kernel_ramdisk;
+
+/**
+ * Cari opsi "key=value" pada kernel command line
+ *
+ * @param multiboot_info Alamat fisik multiboot info dari GRUB
+ * @param key            Nama opsi termasuk '=', ex: "disk="
+ * @return               Pointer ke value, NULL jika opsi tidak ada
+ */
+static const char *kernel_cmdline_option(uint32_t multiboot_info, const char *key)
+{
+    // Multiboot info & cmdline berada di bawah 4 MiB, diakses lewat higher half mapping
+    if (multiboot_info == 0 || multiboot_info >= PAGE_FRAME_SIZE)
+        return NULL;
+    struct MultibootInfo *info = (struct MultibootInfo *)(multiboot_info + KERNEL_VIRTUAL_BASE);
+    if (!(info->flags & MULTIBOOT_INFO_CMDLINE) || info->cmdline >= PAGE_FRAME_SIZE)
+        return NULL;
+
+    uint32_t key_len = strlen(key);
+    const char *cmdline = (const char *)(info->cmdline + KERNEL_VIRTUAL_BASE);
+    for (uint32_t i = 0; cmdline[i] != '\0'; i++)
+    {
+        if ((i == 0 || cmdline[i - 1] == ' ') && memcmp(&cmdline[i], key, key_len) == 0)
+            return &cmdline[i + key_len];
+    }
+    return NULL;
+}
+
+/**
+ * Pilih disk controller dari kernel command line "disk=ata|ahci|virtio", default AUTO
+ *
+ * @param multiboot_info Alamat fisik multiboot info dari GRUB
+ */
+static uint8_t kernel_disk_controller(uint32_t multiboot_info)
+{
+    const char *value = kernel_cmdline_option(multiboot_info, "disk=");
+    if (value == NULL)
+        return DISK_CONTROLLER_AUTO;
+    if (memcmp(value, "ata", 3) == 0)
+        return DISK_CONTROLLER_ATA;
+    if (memcmp(value, "ahci", 4) == 0)
+        return DISK_CONTROLLER_AHCI;
+    if (memcmp(value, "virtio", 6) == 0)
+        return DISK_CONTROLLER_VIRTIO;
+    return DISK_CONTROLLER_AUTO;
+}
+
+/**
+ * Pilih block device untuk root filesystem. Dengan "root=ram", isi disk (maksimal 4 MiB) disalin
+ * ke RAM disk dan filesystem di-mount di sana, perubahan hilang saat reboot. Default: disk_block_device
+ *
+ * @param multiboot_info Alamat fisik multiboot info dari GRUB
+ */
+static struct BlockDevice *kernel_root_device(uint32_t multiboot_info)
+{
+    const char *value = kernel_cmdline_option(multiboot_info, "root=");
+    if (value == NULL || memcmp(value, "ram", 3) != 0)
+        return &disk_block_device;
+    if (!paging_allocate_kernel_page_frame(&_paging_kernel_page_directory, (void *)KERNEL_RAMDISK_VIRTUAL_ADDR))
+        return &disk_block_device;
+
+    void *storage = (void *)KERNEL_RAMDISK_VIRTUAL_ADDR;
+    uint32_t sector_count = PAGE_FRAME_SIZE / BLOCK_SIZE;
+    if (disk_block_device.capacity != 0 && disk_block_device.capacity < sector_count)
+        sector_count = disk_block_device.capacity;
+    memset(storage, 0, PAGE_FRAME_SIZE);
+    blockdev_read(&disk_block_device, storage, 0, sector_count);
+    ramdisk_init(&kernel_ramdisk, "ram0", storage, sector_count * BLOCK_SIZE);
+    return &kernel_ramdisk;
+}
+
 /**
  * kernel_setup
  * Ini adalah entry point C kernel.
  * Paging sudah diaktifkan oleh kernel-entrypoint.s sebelum fungsi ini dipanggil.
  * Fungsi ini sekarang bertugas untuk meluncurkan program 'shell' di User Mode.
+ *
+ * @param multiboot_info Alamat fisik multiboot info, diteruskan dari ebx oleh kernel-entrypoint.s
  */
-void kernel_setup(void)
+void kernel_setup(uint32_t multiboot_info)
 {
     framebuffer_clear();
     framebuffer_set_cursor(0, 0);
@@ -27,10 +105,23 @@ void kernel_setup(void)
     initialize_idt();
     pic_remap();
     activate_keyboard_interrupt();
+    activate_ata_interrupt();
     __asm__ volatile("sti");
 
     /* =================== FILESYSTEM =================== */
-    initialize_filesystem_ext2();
+    pci_init();
+    disk_init(kernel_disk_controller(multiboot_info));
+    if (initialize_filesystem_ext2(kernel_root_device(multiboot_info)) != 0)
+    {
+        // Disk berisi data lain (superblock rusak, format lama), hanya diformat jika diminta dengan "mkfs=1"
+        const char *mkfs = kernel_cmdline_option(multiboot_info, "mkfs=");
+        if (mkfs == NULL || mkfs[0] != '1')
+        {
+            framebuffer_write_string(0, 0, "Disk bukan filesystem EXT2, boot dengan mkfs=1 untuk memformat", 0xC, 0x0);
+            __asm__ volatile("cli; hlt");
+        }
+        create_ext2(EXT2_DEFAULT_LOG_BLOCK_SIZE);
+    }
 
     /* =================== LAUNCHING USER MODE =================== */
     gdt_install_tss();
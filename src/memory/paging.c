@@ -51,7 +51,8 @@ bool paging_allocate_check(uint32_t amount)
     return frames_needed <= page_manager_state.free_page_frame_count;
 }
 
-bool paging_allocate_user_page_frame(struct PageDirectory *page_dir, void *virtual_addr)
+// Ambil frame fisik bebas pertama dan petakan ke virtual_addr dengan privilege sesuai user_bit
+static bool paging_allocate_page_frame(struct PageDirectory *page_dir, void *virtual_addr, bool user)
 {
     for (uint32_t i = 1; i < PAGE_FRAME_MAX_COUNT; i++)
     {
@@ -62,14 +63,14 @@ bool paging_allocate_user_page_frame(struct PageDirectory *page_dir, void *virtu
 
             void *physical_addr = (void *)(i * PAGE_FRAME_SIZE);
 
-            struct PageDirectoryEntryFlag user_flag;
-            memset(&user_flag, 0, sizeof(user_flag));
-            user_flag.present_bit = 1;
-            user_flag.write_bit = 1;
-            user_flag.user_bit = 1;
-            user_flag.use_pagesize_4_mb = 1;
+            struct PageDirectoryEntryFlag frame_flag;
+            memset(&frame_flag, 0, sizeof(frame_flag));
+            frame_flag.present_bit = 1;
+            frame_flag.write_bit = 1;
+            frame_flag.user_bit = user;
+            frame_flag.use_pagesize_4_mb = 1;
 
-            update_page_directory_entry(page_dir, physical_addr, virtual_addr, user_flag);
+            update_page_directory_entry(page_dir, physical_addr, virtual_addr, frame_flag);
 
             return true;
         }
@@ -78,6 +79,16 @@ bool paging_allocate_user_page_frame(struct PageDirectory *page_dir, void *virtu
     return false;
 }
 
+bool paging_allocate_user_page_frame(struct PageDirectory *page_dir, void *virtual_addr)
+{
+    return paging_allocate_page_frame(page_dir, virtual_addr, true);
+}
+
+bool paging_allocate_kernel_page_frame(struct PageDirectory *page_dir, void *virtual_addr)
+{
+    return paging_allocate_page_frame(page_dir, virtual_addr, false);
+}
+
 bool paging_free_user_page_frame(struct PageDirectory *page_dir, void *virtual_addr)
 {
     /*
@@ -110,3 +121,40 @@ bool paging_free_user_page_frame(struct PageDirectory *page_dir, void *virtual_a
     flush_single_tlb(virtual_addr);
     return true;
 }
+
+bool paging_virtual_to_physical(struct PageDirectory *page_dir, const void *virtual_addr, uint32_t *physical_addr)
+{
+    uint32_t page_index = ((uint32_t)virtual_addr >> 22) & 0x3FF;
+    struct PageDirectoryEntry *entry = &page_dir->table[page_index];
+
+    if (!entry->flag.present_bit)
+    {
+        return false;
+    }
+
+    *physical_addr = ((uint32_t)entry->lower_address << 22) | ((uint32_t)virtual_addr & (PAGE_FRAME_SIZE - 1));
+    return true;
+}
+
+void *paging_map_mmio(uint32_t physical_addr)
+{
+    uint32_t frame_addr = physical_addr & ~(PAGE_FRAME_SIZE - 1);
+    uint32_t frame_index = frame_addr / PAGE_FRAME_SIZE;
+
+    // MMIO frame tidak boleh menimpa frame RAM (kernel / user) maupun higher half kernel
+    if (frame_index < PAGE_FRAME_MAX_COUNT || frame_addr == KERNEL_VIRTUAL_BASE)
+    {
+        return NULL;
+    }
+
+    struct PageDirectoryEntryFlag mmio_flag;
+    memset(&mmio_flag, 0, sizeof(mmio_flag));
+    mmio_flag.present_bit = 1;
+    mmio_flag.write_bit = 1;
+    mmio_flag.write_through_bit = 1;
+    mmio_flag.cache_disable_bit = 1;
+    mmio_flag.use_pagesize_4_mb = 1;
+
+    update_page_directory_entry(&_paging_kernel_page_directory, (void *)frame_addr, (void *)frame_addr, mmio_flag);
+    return (void *)physical_addr;
+}
@@ -0,0 +1,100 @@
+#include "header/pci.h"
+#include "header/portio.h"
+
+static uint32_t pci_config_address(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
+    return 0x80000000u
+        | ((uint32_t) bus << 16)
+        | ((uint32_t) (slot & 0x1F) << 11)
+        | ((uint32_t) (function & 0x7) << 8)
+        | (offset & 0xFC);
+}
+
+uint32_t pci_config_read32(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
+    out32(PCI_CONFIG_ADDRESS, pci_config_address(bus, slot, function, offset));
+    return in32(PCI_CONFIG_DATA);
+}
+
+uint16_t pci_config_read16(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
+    uint32_t value = pci_config_read32(bus, slot, function, offset);
+    return (uint16_t) (value >> ((offset & 2) * 8));
+}
+
+void pci_config_write32(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset, uint32_t value) {
+    out32(PCI_CONFIG_ADDRESS, pci_config_address(bus, slot, function, offset));
+    out32(PCI_CONFIG_DATA, value);
+}
+
+void pci_config_write16(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset, uint16_t value) {
+    uint32_t old   = pci_config_read32(bus, slot, function, offset);
+    uint32_t shift = (offset & 2) * 8;
+    old &= ~(0xFFFFu << shift);
+    pci_config_write32(bus, slot, function, offset, old | ((uint32_t) value << shift));
+}
+
+static void pci_fill_device(uint8_t bus, uint8_t slot, uint8_t function, struct PCIDevice *device) {
+    uint32_t id         = pci_config_read32(bus, slot, function, PCI_VENDOR_ID);
+    uint32_t class_rev  = pci_config_read32(bus, slot, function, PCI_REVISION_ID);
+    device->bus            = bus;
+    device->slot           = slot;
+    device->function       = function;
+    device->vendor_id      = (uint16_t) id;
+    device->device_id      = (uint16_t) (id >> 16);
+    device->prog_if        = (uint8_t) (class_rev >> 8);
+    device->subclass       = (uint8_t) (class_rev >> 16);
+    device->class_code     = (uint8_t) (class_rev >> 24);
+    device->subsystem_id   = pci_config_read16(bus, slot, function, PCI_SUBSYSTEM_ID);
+    device->interrupt_line = (uint8_t) pci_config_read32(bus, slot, function, PCI_INTERRUPT_LINE);
+}
+
+struct PCIDevice pci_devices[PCI_MAX_DEVICES];
+uint32_t         pci_device_count;
+
+void pci_init(void) {
+    pci_device_count = 0;
+    for (uint32_t bus = 0; bus < PCI_MAX_BUS; bus++) {
+        for (uint8_t slot = 0; slot < PCI_MAX_SLOT; slot++) {
+            if (pci_config_read16(bus, slot, 0, PCI_VENDOR_ID) == PCI_VENDOR_NONE)
+                continue;
+
+            uint8_t header    = (uint8_t) (pci_config_read32(bus, slot, 0, PCI_HEADER_TYPE) >> 16);
+            uint8_t functions = (header & PCI_HEADER_MULTIFUNCTION) ? PCI_MAX_FUNCTION : 1;
+            for (uint8_t function = 0; function < functions; function++) {
+                if (pci_config_read16(bus, slot, function, PCI_VENDOR_ID) == PCI_VENDOR_NONE)
+                    continue;
+                if (pci_device_count == PCI_MAX_DEVICES)
+                    return;
+                pci_fill_device(bus, slot, function, &pci_devices[pci_device_count++]);
+            }
+        }
+    }
+}
+
+bool pci_find_class(uint8_t class_code, uint8_t subclass, struct PCIDevice *device) {
+    for (uint32_t i = 0; i < pci_device_count; i++) {
+        if (pci_devices[i].class_code == class_code && pci_devices[i].subclass == subclass) {
+            *device = pci_devices[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool pci_find_device(uint16_t vendor_id, uint16_t device_id, struct PCIDevice *device) {
+    for (uint32_t i = 0; i < pci_device_count; i++) {
+        if (pci_devices[i].vendor_id == vendor_id && pci_devices[i].device_id == device_id) {
+            *device = pci_devices[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t pci_read_bar(const struct PCIDevice *device, uint8_t index) {
+    return pci_config_read32(device->bus, device->slot, device->function, PCI_BAR0 + 4*index);
+}
+
+void pci_enable_bus_master(const struct PCIDevice *device) {
+    uint16_t command = pci_config_read16(device->bus, device->slot, device->function, PCI_COMMAND);
+    command |= PCI_COMMAND_IO | PCI_COMMAND_MEMORY | PCI_COMMAND_BUS_MASTER;
+    pci_config_write16(device->bus, device->slot, device->function, PCI_COMMAND, command);
+}
@@ -1,11 +1,11 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "header/ext2.h"
+#include "header/blockdev.h"
 #include "header/stdlib/string.h"
 
 #define MAX_BUFFER 256 // Kurangi buffer untuk avoid overflow
 #define MAX_ARGS 8
-#define MAX_PATH_LEN 128
 
 #define FG_WHITE 0xF
 #define FG_GREEN 0xA
@@ -17,10 +17,8 @@ char read_buf[BLOCK_SIZE * 2]; // Kurangi ukuran buffer
 char input_buffer[MAX_BUFFER];
 char *argv[MAX_ARGS];
 int argc = 0;
-uint32_t current_inode = 2;
-uint32_t parent_inode = 2; // Track parent for cd .. support
-char current_path[MAX_PATH_LEN] = "/";
-struct EXT2DirectoryEntry cached_entry; // Cache entry to avoid buffer overwrite issues
+uint32_t current_inode = 2; // Sama dengan working directory di kernel, dipakai sebagai parent nama tanpa '/'
+char current_path[EXT2_PATH_MAX] = "/";
 
 void syscall(uint32_t eax, uint32_t ebx, uint32_t ecx, uint32_t edx)
 {
@@ -75,6 +73,13 @@ int8_t read_dir(struct EXT2DriverRequest *req)
     return retcode;
 }
 
+int8_t read_dirents(struct EXT2DirentRequest *req)
+{
+    int8_t retcode;
+    syscall(24, (uint32_t)req, (uint32_t)&retcode, 0);
+    return retcode;
+}
+
 int8_t write_file(struct EXT2DriverRequest *req)
 {
     int8_t retcode;
@@ -89,6 +94,152 @@ int8_t delete_file(struct EXT2DriverRequest *req)
     return retcode;
 }
 
+int32_t open_file(struct EXT2DriverRequest *req, uint32_t flags)
+{
+    int32_t fd;
+    syscall(14, (uint32_t)req, flags, (uint32_t)&fd);
+    return fd;
+}
+
+int8_t close_file(int32_t fd)
+{
+    int8_t retcode;
+    syscall(15, (uint32_t)fd, (uint32_t)&retcode, 0);
+    return retcode;
+}
+
+int32_t pread_file(int32_t fd, void *buf, uint32_t count, uint32_t offset)
+{
+    struct EXT2FileRequest req = {
+        .fd = fd,
+        .buf = buf,
+        .count = count,
+        .offset = offset};
+    int32_t retcode;
+    syscall(18, (uint32_t)&req, (uint32_t)&retcode, 0);
+    return retcode;
+}
+
+int8_t lookup_path(struct EXT2PathRequest *req)
+{
+    int8_t retcode;
+    syscall(21, (uint32_t)req, (uint32_t)&retcode, 0);
+    return retcode;
+}
+
+int8_t change_dir(struct EXT2PathRequest *req)
+{
+    int8_t retcode;
+    syscall(22, (uint32_t)req, (uint32_t)&retcode, 0);
+    return retcode;
+}
+
+int8_t get_cwd(char *buf, uint32_t size)
+{
+    int8_t retcode;
+    syscall(23, (uint32_t)buf, size, (uint32_t)&retcode);
+    return retcode;
+}
+
+int8_t block_device_info(uint32_t index, struct BlockDeviceInfo *info)
+{
+    int8_t retcode;
+    syscall(11, index, (uint32_t)info, (uint32_t)&retcode);
+    return retcode;
+}
+
+// Cetak bilangan unsigned rata kanan sepanjang width karakter
+void put_uint(uint32_t value, uint32_t width, uint8_t color)
+{
+    char digits[12];
+    uint32_t len = 0;
+    do
+    {
+        digits[len++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    char text[32];
+    uint32_t pos = 0;
+    while (pos + len < width && pos < sizeof(text) - sizeof(digits))
+        text[pos++] = ' ';
+    while (len > 0)
+        text[pos++] = digits[--len];
+    text[pos] = '\0';
+    puts(text, color);
+}
+
+void print_iostat_row(struct BlockDeviceInfo *info)
+{
+    puts(info->name, FG_CYAN);
+    for (uint32_t i = strlen(info->name); i < BLOCKDEV_NAME_LENGTH; i++)
+        putchar(' ', FG_WHITE);
+    put_uint(info->stats.read_ops, 8, FG_WHITE);
+    put_uint(info->stats.read_sectors, 9, FG_WHITE);
+    put_uint(info->stats.read_merges, 8, FG_WHITE);
+    put_uint(info->stats.write_ops, 8, FG_WHITE);
+    put_uint(info->stats.write_sectors, 9, FG_WHITE);
+    put_uint(info->stats.write_merges, 8, FG_WHITE);
+    put_uint(info->stats.errors, 6, info->stats.errors ? FG_RED : FG_WHITE);
+    put_uint(info->stats.in_flight, 4, FG_WHITE);
+    put_uint(info->stats.max_in_flight, 5, FG_WHITE);
+    puts("\n", FG_WHITE);
+}
+
+// Histogram latency log2, bucket kosong tidak dicetak
+void print_latency_histogram(const char *title, uint32_t *buckets)
+{
+    puts(title, FG_YELLOW);
+    uint32_t max = 0;
+    for (uint32_t i = 0; i < BLOCKDEV_LATENCY_BUCKETS; i++)
+        if (buckets[i] > max)
+            max = buckets[i];
+    if (max == 0)
+    {
+        puts("  (belum ada request)\n", FG_WHITE);
+        return;
+    }
+
+    for (uint32_t i = 0; i < BLOCKDEV_LATENCY_BUCKETS; i++)
+    {
+        if (buckets[i] == 0)
+            continue;
+        puts("  2^", FG_WHITE);
+        put_uint(i, 2, FG_WHITE);
+        puts(i == BLOCKDEV_LATENCY_BUCKETS - 1 ? "+ cycles " : "  cycles ", FG_WHITE);
+        put_uint(buckets[i], 8, FG_WHITE);
+        putchar(' ', FG_WHITE);
+
+        // Panjang bar relatif terhadap bucket terbesar, maksimal 40 karakter
+        uint32_t bar = max <= 40 ? buckets[i] : buckets[i] / (max / 40);
+        if (bar > 40)
+            bar = 40;
+        if (bar == 0)
+            bar = 1;
+        char text[41];
+        memset(text, '#', bar);
+        text[bar] = '\0';
+        puts(text, FG_GREEN);
+        puts("\n", FG_WHITE);
+    }
+}
+
+// Satu entry ls, format panjang menambah tipe, inode dan ukuran dengan satu entry per baris
+void print_dirent(struct EXT2Dirent *entry, bool long_format)
+{
+    if (long_format)
+    {
+        putchar(entry->file_type == EXT2_FT_DIR ? 'd' : '-', FG_WHITE);
+        put_uint(entry->inode, 6, FG_WHITE);
+        put_uint(entry->size, 10, FG_WHITE);
+        putchar(' ', FG_WHITE);
+    }
+    puts((char *)(entry + 1), FG_WHITE);
+    if (entry->file_type == EXT2_FT_DIR)
+        puts("/", FG_CYAN);
+    puts(long_format ? "\n" : "  ", FG_WHITE);
+}
+
 void read_line()
 {
     memset(input_buffer, 0, MAX_BUFFER);
@@ -153,64 +304,26 @@ void parse_command()
     }
 }
 
-int8_t find_entry_in_dir(uint32_t dir_inode, const char *name)
+// Pisah path menjadi folder parent dan nama terakhir, folder parent di-resolve kernel dalam satu syscall
+bool resolve_parent(char *path, uint32_t *parent, char **name)
 {
-    struct EXT2DriverRequest req = {
-        .buf = read_buf,
-        .parent_inode = dir_inode,
-        .buffer_size = sizeof(read_buf) // Gunakan sizeof() agar aman
-    };
-
-    int8_t ret = read_dir(&req);
-    if (ret != 0)
+    int32_t slash = strlen(path) - 1;
+    while (slash >= 0 && path[slash] != '/')
+        slash--;
+    *name = path + slash + 1;
+    if (slash < 0)
     {
-        // Tidak perlu cetak error di sini, biarkan pemanggil yang menangani
-        return 0;
+        *parent = current_inode;
+        return true;
     }
 
-    struct EXT2DirectoryEntry *entry = (struct EXT2DirectoryEntry *)read_buf;
-    uint32_t offset = 0;
-    uint8_t name_len = strlen(name);
-
-    // PERBAIKI INI: Loop harus beriterasi di seluruh buffer yang dikembalikan
-    while (offset < req.buffer_size)
-    {
-        entry = (struct EXT2DirectoryEntry *)((uint8_t *)read_buf + offset);
-
-        if (entry->rec_len == 0)
-            break;
-
-        if (entry->inode != 0)
-        {
-            char *entry_name = (char *)entry + 8;
-
-            // Try to match
-            bool match = (entry->name_len == name_len);
-            if (match)
-            {
-                for (uint8_t i = 0; i < name_len; i++)
-                {
-                    if (entry_name[i] != name[i])
-                    {
-                        match = false;
-                        break;
-                    }
-                }
-            }
-
-            if (match)
-            {
-                cached_entry.inode = entry->inode;
-                cached_entry.rec_len = entry->rec_len;
-                cached_entry.name_len = entry->name_len;
-                cached_entry.file_type = entry->file_type;
-                return 1;
-            }
-        }
-
-        offset += entry->rec_len;
-    }
-    return 0;
+    struct EXT2PathRequest req = {
+        .path = path,
+        .path_len = slash == 0 ? 1 : slash};
+    if (lookup_path(&req) != 0 || req.stat.file_type != EXT2_FT_DIR)
+        return false;
+    *parent = req.stat.inode;
+    return true;
 }
 
 int main(void)
@@ -220,7 +333,7 @@ int main(void)
 
     puts("================================================================\n", FG_CYAN);
     puts("  OS-ICIBOS Shell v1.0\n", FG_GREEN);
-    puts("  Commands: ls, cat, mkdir, rm, cd, clear, exit\n", FG_WHITE);
+    puts("  Commands: ls [-l], cat, mkdir, rm, cd, iostat, clear, exit\n", FG_WHITE);
     puts("================================================================\n\n", FG_CYAN);
 
     while (true)
@@ -237,7 +350,7 @@ int main(void)
         if (strcmp(argv[0], "help") == 0)
         {
             puts("Available commands:\n", FG_YELLOW);
-            puts("  ls, cd, cat, mkdir, rm, clear, exit\n", FG_WHITE);
+            puts("  ls [-l], cd, cat, mkdir, rm, iostat, clear, exit\n", FG_WHITE);
         }
         else if (strcmp(argv[0], "clear") == 0)
         {
@@ -249,103 +362,60 @@ int main(void)
         }
         else if (strcmp(argv[0], "ls") == 0)
         {
-            struct EXT2DriverRequest req = {
-                .buf = read_buf,
-                .parent_inode = current_inode,
-                .buffer_size = sizeof(read_buf)};
-
-            int8_t ret = read_dir(&req);
-            if (ret != 0)
-            {
-                puts("Error: Cannot read directory\n", FG_RED);
-            }
-            else
+            // ls [-l] [path]
+            bool long_format = argc >= 2 && strcmp(argv[1], "-l") == 0;
+            int path_arg = long_format ? 2 : 1;
+            char *path = argc > path_arg ? argv[path_arg] : ".";
+            struct EXT2PathRequest path_req = {
+                .path = path,
+                .path_len = strlen(path)};
+
+            // Entry dibaca per batch sebesar read_buf, cookie melanjutkan dari entry terakhir batch sebelumnya
+            int8_t ret = lookup_path(&path_req);
+            struct EXT2DirentRequest req = {
+                .dir_inode = path_req.stat.inode,
+                .cookie = 0};
+            while (ret == 0)
             {
-                struct EXT2DirectoryEntry *entry = (struct EXT2DirectoryEntry *)read_buf;
-                uint32_t offset = 0;
+                req.buf = read_buf;
+                req.buffer_size = sizeof(read_buf);
+                ret = read_dirents(&req);
+                if (ret != 0 || req.buffer_size == 0)
+                    break;
 
-                while (offset < req.buffer_size && entry->rec_len > 0)
+                for (uint32_t offset = 0; offset < req.buffer_size;)
                 {
-                    char *name = (char *)entry + 8;
-                    for (int i = 0; i < entry->name_len; i++)
-                        putchar(name[i], FG_WHITE);
-
-                    if (entry->file_type == EXT2_FT_DIR)
-                        puts("/", FG_CYAN);
-                    puts("  ", FG_WHITE);
-
+                    struct EXT2Dirent *entry = (struct EXT2Dirent *)(read_buf + offset);
+                    print_dirent(entry, long_format);
                     offset += entry->rec_len;
-                    entry = (struct EXT2DirectoryEntry *)((uint8_t *)read_buf + offset);
                 }
-                puts("\n", FG_WHITE);
             }
+
+            if (ret != 0)
+                puts("Error: Cannot read directory\n", FG_RED);
+            else if (!long_format)
+                puts("\n", FG_WHITE);
         }
         else if (strcmp(argv[0], "cd") == 0)
         {
-            if (argc < 2)
-            {
-                current_inode = 2;
-                parent_inode = 2;
-                strcpy(current_path, "/");
-            }
-            else if (strcmp(argv[1], "..") == 0)
-            {
-                // Go back to parent
-                if (current_inode != 2)
-                {
-                    int8_t found = find_entry_in_dir(parent_inode, "..");
-                    if (found)
-                        parent_inode = cached_entry.inode;
-                    else
-                        parent_inode = 2;
-                    current_inode = parent_inode;
+            // Seluruh path (termasuk "..") di-resolve kernel, path prompt diambil dari kernel yang sudah dinormalisasi
+            struct EXT2PathRequest req = {
+                .path = argc < 2 ? "/" : argv[1],
+                .path_len = argc < 2 ? 1 : strlen(argv[1])};
 
-                    if (strlen(current_path) > 1)
-                    {
-                        int i = strlen(current_path) - 2;
-                        while (i > 0 && current_path[i] != '/')
-                            i--;
-                        current_path[i + 1] = '\0';
-                    }
-                }
+            int8_t ret = change_dir(&req);
+            if (ret == 0)
+            {
+                current_inode = req.stat.inode;
+                get_cwd(current_path, sizeof(current_path));
             }
-            else if (strcmp(argv[1], ".") == 0)
+            else if (ret == 2)
             {
-                // Stay in current directory
+                puts("Error: Not a directory\n", FG_RED);
             }
             else
             {
-                int8_t found = find_entry_in_dir(current_inode, argv[1]);
-
-                if (found == 0)
-                {
-                    puts("Error: Directory not found\n", FG_RED);
-                }
-                else if (cached_entry.file_type != EXT2_FT_DIR)
-                {
-                    puts("Error: Not a directory (type=", FG_RED);
-                    putchar('0' + cached_entry.file_type, FG_RED);
-                    puts(")\n", FG_RED);
-                }
-                else
-                {
-                    parent_inode = current_inode;
-                    current_inode = cached_entry.inode;
-
-                    if (current_path[strlen(current_path) - 1] != '/')
-                    {
-                        current_path[strlen(current_path)] = '/';
-                        current_path[strlen(current_path) + 1] = '\0';
-                    }
-
-                    int path_len = strlen(current_path);
-                    int name_len = strlen(argv[1]);
-                    for (int i = 0; i < name_len; i++)
-                    {
-                        current_path[path_len + i] = argv[1][i];
-                    }
-                    current_path[path_len + name_len] = '\0';
-                }
+                puts("Error: Directory not found\n", FG_RED);
             }
         }
         else if (strcmp(argv[0], "cat") == 0)
@@ -356,20 +426,35 @@ int main(void)
             }
             else
             {
-                struct EXT2DriverRequest req = {
-                    .buf = read_buf,
-                    .name = argv[1],
-                    .name_len = strlen(argv[1]),
-                    .parent_inode = current_inode,
-                    .buffer_size = BLOCK_SIZE * 8};
+                uint32_t parent;
+                char *name;
+                struct EXT2DriverRequest req = {0};
+                if (resolve_parent(argv[1], &parent, &name))
+                {
+                    req.name = name;
+                    req.name_len = strlen(name);
+                    req.parent_inode = parent;
+                }
 
-                int8_t ret = read_file(&req);
-                if (ret == 0)
+                // File dibaca per potongan read_buf, ukuran file tidak perlu ditebak
+                int32_t fd = req.name != (char *)0 ? open_file(&req, EXT2_O_RDONLY) : -1;
+                if (fd >= 0)
                 {
-                    for (uint32_t i = 0; i < req.buffer_size; i++)
-                        putchar(read_buf[i], FG_WHITE);
+                    uint32_t offset = 0;
+                    int32_t bytes_read;
+                    while ((bytes_read = pread_file(fd, read_buf, sizeof(read_buf), offset)) > 0)
+                    {
+                        for (int32_t i = 0; i < bytes_read; i++)
+                            putchar(read_buf[i], FG_WHITE);
+                        offset += bytes_read;
+                    }
+                    close_file(fd);
                     puts("\n", FG_WHITE);
                 }
+                else if (fd == -2)
+                {
+                    puts("Error: Not a file\n", FG_RED);
+                }
                 else
                 {
                     puts("Error: File not found\n", FG_RED);
@@ -384,15 +469,18 @@ int main(void)
             }
             else
             {
+                uint32_t parent;
+                char *name;
+                bool parent_found = resolve_parent(argv[1], &parent, &name);
                 struct EXT2DriverRequest req = {
                     .buf = (void *)0, // mkdir tidak perlu buffer
-                    .name = argv[1],
-                    .name_len = strlen(argv[1]),
-                    .parent_inode = current_inode,
+                    .name = name,
+                    .name_len = strlen(name),
+                    .parent_inode = parent,
                     .buffer_size = 0,
                     .is_directory = true};
 
-                int8_t ret = write_file(&req);
+                int8_t ret = parent_found ? write_file(&req) : 2;
 
                 if (ret == 0)
                 {
@@ -412,6 +500,27 @@ int main(void)
                 }
             }
         }
+        else if (strcmp(argv[0], "iostat") == 0)
+        {
+            // iostat: ringkasan semua device, iostat <device>: ditambah histogram latency
+            struct BlockDeviceInfo info;
+            bool found = false;
+            puts("Device    rd_ops  rd_sect  rd_mrg  wr_ops  wr_sect  wr_mrg   err  qd  max\n", FG_YELLOW);
+            for (uint32_t index = 0; block_device_info(index, &info) == 0; index++)
+            {
+                if (argc >= 2 && strcmp(argv[1], info.name) != 0)
+                    continue;
+                found = true;
+                print_iostat_row(&info);
+                if (argc >= 2)
+                {
+                    print_latency_histogram("Read latency:\n", info.stats.read_latency);
+                    print_latency_histogram("Write latency:\n", info.stats.write_latency);
+                }
+            }
+            if (!found)
+                puts("Error: Device not found\n", FG_RED);
+        }
         else if (strcmp(argv[0], "rm") == 0)
         {
             if (argc < 2)
@@ -420,9 +529,13 @@ int main(void)
             }
             else
             {
-                int8_t found = find_entry_in_dir(current_inode, argv[1]);
+                struct EXT2PathRequest path_req = {
+                    .path = argv[1],
+                    .path_len = strlen(argv[1])};
+                uint32_t parent;
+                char *name;
 
-                if (found == 0)
+                if (lookup_path(&path_req) != 0 || !resolve_parent(argv[1], &parent, &name))
                 {
                     puts("Error: File not found\n", FG_RED);
                 }
@@ -430,11 +543,11 @@ int main(void)
                 {
                     struct EXT2DriverRequest req = {
                         .buf = (void *)0,
-                        .name = argv[1],
-                        .name_len = strlen(argv[1]),
-                        .parent_inode = current_inode,
+                        .name = name,
+                        .name_len = strlen(name),
+                        .parent_inode = parent,
                         .buffer_size = 0,
-                        .is_directory = (cached_entry.file_type == EXT2_FT_DIR)};
+                        .is_directory = (path_req.stat.file_type == EXT2_FT_DIR)};
 
                     int8_t ret = delete_file(&req);
 